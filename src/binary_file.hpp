@@ -0,0 +1,78 @@
+#pragma once
+
+#include "include.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// checksums and mappings of the binary files of gya::neural_net, pinguml::network and pinguml::dataset
+namespace util {
+
+/**
+ * word-wise fnv style hash: the 64 bit fnv offset basis and prime, but one xor and multiply per 8 bytes instead of per
+ * byte like fnv-1a, the tail that isn't a whole word is mixed in byte by byte. good enough to detect corrupt files
+ */
+inline u64 word_fnv_hash(std::span<const std::byte> data, u64 hash = 0xcbf29ce484222325ull) {
+    usize i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        u64 word;
+        std::memcpy(&word, data.data() + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (; i < data.size(); ++i)
+        hash = (hash ^ static_cast<u64>(data[i])) * 0x100000001b3ull;
+    return hash;
+}
+
+/**
+ * mapping of a whole file. read only and shared by default, the pages are shared by every process that maps the same
+ * file. a writable mapping is private, the pages are shared with the page cache until they are written
+ */
+class mapped_file {
+    std::byte *m_data = nullptr;
+    usize m_size = 0;
+    bool m_writable;
+
+public:
+    explicit mapped_file(std::string const &path, bool writable = false) : m_writable(writable) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("can't open " + path);
+        struct stat st{};
+        if (::fstat(fd, &st) < 0 || st.st_size <= 0) {
+            ::close(fd);
+            throw std::runtime_error("can't read " + path);
+        }
+        m_size = static_cast<usize>(st.st_size);
+        void *data = writable ? ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+                              : ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("can't map " + path);
+        m_data = static_cast<std::byte *>(data);
+    }
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file const &) = delete;
+
+    ~mapped_file() {
+        ::munmap(m_data, m_size);
+    }
+
+    [[nodiscard]] bool writable() const { return m_writable; }
+
+    // may only be written through if the mapping is writable
+    [[nodiscard]] std::byte *data() { return m_data; }
+
+    [[nodiscard]] std::byte const *data() const { return m_data; }
+
+    [[nodiscard]] usize size() const { return m_size; }
+
+    [[nodiscard]] std::span<const std::byte> bytes() const {
+        return {m_data, m_size};
+    }
+};
+
+} // namespace util
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../lib/lmj/src/include_all.hpp"
+#include "board.hpp"
+#include "defines.hpp"
+
+namespace gya {
+
+/**
+ * column major bitboard, every column uses BOARD_HEIGHT + 1 bits where the top bit stays empty so that shifting
+ * never carries stones between columns:
+ *  6 13 20 27 34 41 48
+ *  5 12 19 26 33 40 47
+ *  4 11 18 25 32 39 46
+ *  3 10 17 24 31 38 45
+ *  2  9 16 23 30 37 44
+ *  1  8 15 22 29 36 43
+ *  0  7 14 21 28 35 42
+ */
+struct bitboard {
+    static constexpr u64 COLUMN_STRIDE = BOARD_HEIGHT + 1;
+
+    static constexpr u64 BOTTOM_MASK = [] {
+        u64 res = 0;
+        for (u64 col = 0; col < BOARD_WIDTH; ++col)
+            res |= 1ull << (col * COLUMN_STRIDE);
+        return res;
+    }();
+
+    static constexpr u64 BOARD_MASK = BOTTOM_MASK * ((1ull << BOARD_HEIGHT) - 1);
+
+    u64 m_position{}; // stones of the player to move
+    u64 m_mask{};     // stones of both players
+    u8 m_moves{};
+
+    static constexpr u64 bottom_mask(u8 column) {
+        return 1ull << (column * COLUMN_STRIDE);
+    }
+
+    static constexpr u64 top_mask(u8 column) {
+        return 1ull << (BOARD_HEIGHT - 1 + column * COLUMN_STRIDE);
+    }
+
+    static constexpr u64 column_mask(u8 column) {
+        return ((1ull << BOARD_HEIGHT) - 1) << (column * COLUMN_STRIDE);
+    }
+
+    static constexpr u8 column_of(u64 move_bit) {
+        return static_cast<u8>(std::countr_zero(move_bit) / COLUMN_STRIDE);
+    }
+
+    static constexpr bool has_four(u64 stones) {
+        // horizontal, diagonal, anti-diagonal, vertical
+        for (u64 shift: {COLUMN_STRIDE, COLUMN_STRIDE + 1, COLUMN_STRIDE - 1, u64{1}}) {
+            const u64 m = stones & (stones >> shift);
+            if (m & (m >> (2 * shift))) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @return every empty cell that completes four in a row for the given stones, whether or not it can be played yet
+     */
+    static constexpr u64 winning_cells(u64 stones, u64 mask) {
+        // vertical, only upwards since the cells above the stones are empty
+        u64 res = (stones << 1) & (stones << 2) & (stones << 3);
+        // horizontal, diagonal, anti-diagonal, with the empty cell in any of the four positions
+        for (u64 shift: {COLUMN_STRIDE, COLUMN_STRIDE + 1, COLUMN_STRIDE - 1}) {
+            u64 p = (stones << shift) & (stones << 2 * shift);
+            res |= p & (stones << 3 * shift);
+            res |= p & (stones >> shift);
+            p = (stones >> shift) & (stones >> 2 * shift);
+            res |= p & (stones << shift);
+            res |= p & (stones >> 3 * shift);
+        }
+        return res & (BOARD_MASK ^ mask);
+    }
+
+    /**
+     * @return one bit per playable column, the bit being the cell the next stone in that column lands in
+     */
+    [[nodiscard]] constexpr u64 legal_moves() const {
+        return (m_mask + BOTTOM_MASK) & BOARD_MASK;
+    }
+
+    [[nodiscard]] constexpr bool can_play(u8 column) const {
+        return !(m_mask & top_mask(column));
+    }
+
+    [[nodiscard]] constexpr u64 move_bit(u8 column) const {
+        return (m_mask + bottom_mask(column)) & column_mask(column);
+    }
+
+    // legal moves that win immediately for the player to move
+    [[nodiscard]] constexpr u64 winning_moves() const {
+        return winning_cells(m_position, m_mask) & legal_moves();
+    }
+
+    // legal moves the opponent would win with if it was their turn, i.e. the moves that have to be blocked
+    [[nodiscard]] constexpr u64 opponent_winning_moves() const {
+        return winning_cells(m_position ^ m_mask, m_mask) & legal_moves();
+    }
+
+    [[nodiscard]] constexpr bool is_winning_move(u64 move_bit) const {
+        return has_four(m_position | move_bit);
+    }
+
+    [[nodiscard]] constexpr bool is_full() const {
+        return m_moves == BOARD_WIDTH * BOARD_HEIGHT;
+    }
+
+    // afterwards m_position holds the stones of the other player, who is now to move
+    constexpr void play_bit(u64 move_bit) {
+        m_position ^= m_mask;
+        m_mask |= move_bit;
+        ++m_moves;
+    }
+
+    constexpr void play(u8 column) {
+        play_bit(move_bit(column));
+    }
+
+    static constexpr bitboard from_board(gya::board const &b) {
+        bitboard res;
+        const i8 turn = b.turn();
+        for (u8 col = 0; col < BOARD_WIDTH; ++col) {
+            for (u8 row = 0; row < b[col].height; ++row) {
+                const u64 bit = 1ull << (col * COLUMN_STRIDE + row);
+                res.m_mask |= bit;
+                if (b[col][row] == turn) res.m_position |= bit;
+            }
+        }
+        res.m_moves = b.num_played_moves();
+        return res;
+    }
+};
+
+static_assert([] { // play random games on both representations and make sure they agree on legal moves and wins
+    constexpr auto NUM_RANDOM_GAMES = 8;
+    for (usize i = 0; i < NUM_RANDOM_GAMES; ++i) {
+        gya::random_player p(i);
+        gya::board b;
+        gya::bitboard bb;
+        while (!b.has_won().is_game_over()) {
+            const u8 move = p(b);
+            if (!bb.can_play(move))
+                return false;
+            const bool wins = bb.is_winning_move(bb.move_bit(move));
+            if (wins != static_cast<bool>(bb.winning_moves() & bb.move_bit(move)))
+                return false;
+            b.play(move);
+            bb.play(move);
+            if (wins != (b.has_won().is_game_over() && !b.has_won().is_tie()))
+                return false;
+            if (wins) break;
+        }
+        i32 num_playable = 0;
+        for (u8 col = 0; col < BOARD_WIDTH; ++col)
+            num_playable += b[col].height < BOARD_HEIGHT;
+        if (std::popcount(bb.legal_moves()) != num_playable)
+            return false;
+    }
+    return true;
+}());
+} // namespace gya
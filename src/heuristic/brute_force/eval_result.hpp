@@ -4,18 +4,21 @@
 
 namespace heuristic {
 struct eval_result {
+    // more than the 42 plies of a game, longer proofs saturate instead of wrapping around
+    static constexpr u8 MAX_DEPTH = 63;
+
     bool m_winning : 1;
     bool m_losing : 1;
-    i8 m_depth_until_over : 6 = 0;
+    u8 m_depth_until_over : 6 = 0;
 
     constexpr eval_result() : m_winning{}, m_losing{}, m_depth_until_over{} {}
 
-    constexpr eval_result(bool winning, bool losing, i8 depth = 0) : m_winning{winning}, m_losing{losing},
+    constexpr eval_result(bool winning, bool losing, u8 depth = 0) : m_winning{winning}, m_losing{losing},
                                                                      m_depth_until_over{depth} {}
 
     constexpr eval_result incremented() const {
         if (m_winning | m_losing) {
-            return eval_result{!m_winning, !m_losing, static_cast<i8>(m_depth_until_over + 1)};
+            return eval_result{!m_winning, !m_losing, std::min<u8>(m_depth_until_over + 1, MAX_DEPTH)};
         } else {
             return *this;
         }
@@ -63,4 +66,29 @@ static constexpr eval_result LOSING_MOVE{false, true};
 static constexpr eval_result NEUTRAL_MOVE{};
 static constexpr eval_result TIE_MOVE{true, true};
 static_assert(sizeof(eval_result) == sizeof(i8));
+
+// order of proven results for the player they belong to: wins, the shortest first, then ties, then losses, the longest
+// first. operator> doesn't order ties against losses
+constexpr i32 proven_rank(eval_result result) {
+    if (result.is_tied()) return 0;
+    return result.is_winning() ? 64 - result.m_depth_until_over : result.m_depth_until_over - 64;
+}
+
+/**
+ * proven result of a position from the results of its moves, result_of gives them for the player who makes the move
+ * and neutral while unproven. the position is won as soon as one move is, otherwise proven once every move is
+ */
+template<typename MOVES, typename RESULT_OF>
+constexpr eval_result best_proven(MOVES const &moves, RESULT_OF result_of) {
+    eval_result best = LOSING_MOVE;
+    bool all_proven = true;
+    for (auto const &move: moves) {
+        const eval_result result = result_of(move);
+        if (!result.is_game_over())
+            all_proven = false;
+        else if (proven_rank(result) > proven_rank(best))
+            best = result;
+    }
+    return all_proven || best.is_winning() ? best : NEUTRAL_MOVE;
+}
 } // namespace heuristic
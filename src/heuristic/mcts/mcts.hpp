@@ -3,25 +3,34 @@
 #include "../../include.hpp"
 
 #include "node.hpp"
+#include "playout.hpp"
 #include "tree.hpp"
 
 namespace mcts {
 
+// POLICY picks the moves of the rollouts, see rollout_policy.hpp
+template<class POLICY = random_policy>
 class mcts {
 public:
     u32 m_rollout_limit;
+    u32 m_playouts_per_leaf;
 
-    mcts(u32 rollout_limit) : m_rollout_limit(rollout_limit) {}
+    playout_kernel<POLICY> m_playout_kernel;
+
+    mcts(u32 rollout_limit, u32 playouts_per_leaf = 1, POLICY policy = {})
+            : m_rollout_limit(rollout_limit), m_playouts_per_leaf(std::max(playouts_per_leaf, 1u)),
+              m_playout_kernel(-1, std::move(policy)) {}
 
     f32 ucb(node *v) {
         if (!v->m_visits) return std::numeric_limits<f32>::max();
-        return v->m_score / v->m_visits + 0.1f * std::sqrt(std::log(v->m_parent->m_visits) / v->m_visits);
+        return static_cast<f32>(v->m_score) / v->m_visits + 0.1f * std::sqrt(std::log(v->m_parent->m_visits) / v->m_visits);
     }
 
     node *get_child_with_highest_ucb(node *v) {
         f32 mx_ucb = -std::numeric_limits<f32>::max();
         std::vector<node*> mx_children;
         for (auto &child: v->m_children) {
+            if (child->is_proven()) continue;
             f32 child_ucb = ucb(child.get());
             if (child_ucb > mx_ucb) {
                 mx_ucb = child_ucb;
@@ -53,61 +62,80 @@ public:
             nodes_to_update.push_back(cur_node);
         }
 
-        gya::game_result result = game.has_won();
-        if (!result.is_game_over()) {
+        if (!game.has_won().is_game_over()) {
             i32 next_player_id = game.turn();
             add_children(cur_node, game, next_player_id);
 
-            game.play(get_child_with_highest_ucb(cur_node)->m_action[1], next_player_id);
-
-            while (1) {
-                gya::game_result result2 = game.has_won();
-                if (result2.is_game_over()) break;
-                next_player_id = game.turn();
-                auto moves = game.get_actions();
-                game.play(moves[std::rand() % moves.size()], next_player_id);
-            }
+            cur_node = get_child_with_highest_ucb(cur_node);
+            game.play(cur_node->m_action[1], next_player_id);
+            nodes_to_update.push_back(cur_node);
         }
 
-        f32 score;
-        bool win;
-        result = game.has_won();
-        if (result.is_tie()) {
-            win = 0;
-            score = 0.f;
+        // sum of the playout results from player one's perspective
+        i32 score = 0;
+        gya::game_result result = game.has_won();
+        if (result.is_game_over()) {
+            // the move into cur_node ended the game, so the player to move there has lost (or tied)
+            cur_node->m_result = result.is_tie() ? heuristic::TIE_MOVE : heuristic::LOSING_MOVE;
+            if (!result.is_tie())
+                score = (result.player_1_won() ? 1 : -1) * static_cast<i32>(m_playouts_per_leaf);
         } else {
-            win = (game.turn() == player_id ? 1 : 0);
-            score = (win ? 1 : -1);
+            score = m_playout_kernel.run(game, m_playouts_per_leaf).score() * game.turn();
         }
 
         for (auto node_to_update: nodes_to_update) {
             i32 player_for_node = (node_to_update->m_action)[0];
-            i32 node_score = score;
-            if (player_for_node != player_id)
-                node_score *= -1.f;
-            (node_to_update->m_visits)++;
-            (node_to_update->m_score) += node_score;
+            (node_to_update->m_visits) += m_playouts_per_leaf;
+            (node_to_update->m_score) += score * player_for_node;
         }
-    }
 
-    u8 move(gya::board game, i32 player_id) {
-        std::unique_ptr<tree> tr = std::make_unique<tree>();
-
-        for (u32 i = 0; i < m_rollout_limit; i++) {
-            gya::board copy = game;
-            simulate_game(copy, tr.get(), player_id);
-        }
+        for (usize i = nodes_to_update.size(); i-- > 0;)
+            nodes_to_update[i]->update_proven();
+    }
 
+    node *get_best_child(node *root) {
+        // take the fastest proven win if there is one, otherwise the most visited move not proven to lose
         node *mx_child = nullptr;
+        heuristic::eval_result mx_eval = heuristic::LOSING_MOVE;
         i32 mx_visits = -1;
-        for (auto &child: tr->m_root->m_children) {
+        for (auto &child: root->m_children) {
+            const auto eval = child->parent_result();
+            if (eval.is_winning() && (!mx_eval.is_winning() || eval > mx_eval)) {
+                mx_eval = eval;
+                mx_child = child.get();
+            }
+        }
+        if (mx_child) return mx_child;
+
+        for (auto &child: root->m_children) {
+            if (child->parent_result().is_losing()) continue;
             if (mx_visits < static_cast<i32>(child->m_visits)) {
                 mx_visits = child->m_visits;
                 mx_child = child.get();
             }
         }
+        if (mx_child) return mx_child;
+
+        // every move loses, so postpone the loss for as long as possible
+        for (auto &child: root->m_children) {
+            const auto eval = child->parent_result();
+            if (!mx_child || eval > mx_eval) {
+                mx_eval = eval;
+                mx_child = child.get();
+            }
+        }
+        return mx_child;
+    }
+
+    u8 move(gya::board game, i32 player_id) {
+        std::unique_ptr<tree> tr = std::make_unique<tree>();
+
+        for (u32 i = 0; i < m_rollout_limit && !tr->m_root->is_proven(); i++) {
+            gya::board copy = game;
+            simulate_game(copy, tr.get(), player_id);
+        }
 
-        return (mx_child->m_action)[1];
+        return (get_best_child(tr->m_root.get())->m_action)[1];
     }
 };
 
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "../../include.hpp"
+#include "../brute_force/eval_result.hpp"
+#include "../brute_force/transposition_table_solver.hpp"
+#include "playout.hpp"
+
+namespace mcts {
+
+struct dag_edge {
+    u8 m_move;
+    u32 m_visits;
+    u32 m_child; // index into dag::m_nodes, resolved the first time the edge is followed
+};
+
+struct dag_node {
+    u32 m_visits{};
+    i32 m_score{}; // from the perspective of the player who moved into this position
+
+    // proven result from the perspective of the player to move in this position, neutral until proven
+    heuristic::eval_result m_result{};
+
+    bool m_expanded{};
+    lmj::static_vector<dag_edge, gya::BOARD_WIDTH> m_edges;
+
+    bool is_proven() const {
+        return m_result.is_game_over();
+    }
+
+    heuristic::eval_result parent_result() const {
+        return m_result.is_tied() ? heuristic::TIE_MOVE : m_result.incremented();
+    }
+};
+
+// nodes are shared between all paths that reach the same position, statistics of a position live in its node
+// while the number of times a specific move was taken lives in the edge
+class dag {
+public:
+    static constexpr u32 NO_CHILD = std::numeric_limits<u32>::max();
+
+    using hasher_t = heuristic::transposition_table_solver::compressed_board_hasher;
+
+    std::vector<dag_node> m_nodes;
+    lmj::hash_table<gya::compressed_board, u32, hasher_t> m_table;
+
+    u32 get_or_insert(gya::board const &b) {
+        if (auto iter = m_table.find(b); iter != m_table.end())
+            return iter->second;
+        const auto idx = static_cast<u32>(m_nodes.size());
+        m_nodes.emplace_back();
+        m_table.emplace(gya::compressed_board{b}, idx);
+        return idx;
+    }
+
+    [[nodiscard]] usize size() const {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] usize memory_usage() const {
+        using pair_t = typename decltype(m_table)::pair_type;
+        return m_nodes.capacity() * sizeof(dag_node) + m_table.capacity() * (sizeof(pair_t) + sizeof(u8));
+    }
+};
+
+class mcts_dag {
+public:
+    u32 m_rollout_limit;
+
+    // kept after move() so the size of the last search can be inspected
+    std::unique_ptr<dag> m_dag;
+
+    playout_kernel<> m_playout_kernel;
+
+    mcts_dag(u32 rollout_limit) : m_rollout_limit(rollout_limit) {}
+
+    f32 ucb(dag_node const &parent, dag_edge const &e) {
+        if (!e.m_visits) return std::numeric_limits<f32>::max();
+        dag_node const &child = m_dag->m_nodes[e.m_child];
+        return static_cast<f32>(child.m_score) / child.m_visits + 0.1f * std::sqrt(std::log(parent.m_visits) / e.m_visits);
+    }
+
+    // returns the index of the selected edge, or -1 if every move has been proven
+    i32 get_edge_with_highest_ucb(u32 v) {
+        dag_node const &parent = m_dag->m_nodes[v];
+        f32 mx_ucb = -std::numeric_limits<f32>::max();
+        lmj::static_vector<u8, gya::BOARD_WIDTH> mx_edges;
+        for (u8 i = 0; i < parent.m_edges.size(); ++i) {
+            auto const &e = parent.m_edges[i];
+            if (e.m_child != dag::NO_CHILD && m_dag->m_nodes[e.m_child].is_proven()) continue;
+            f32 edge_ucb = ucb(parent, e);
+            if (edge_ucb > mx_ucb) {
+                mx_ucb = edge_ucb;
+                mx_edges.clear();
+                mx_edges.push_back(i);
+            } else if (edge_ucb == mx_ucb) {
+                mx_edges.push_back(i);
+            }
+        }
+        if (mx_edges.empty()) return -1;
+        return mx_edges[std::rand() % mx_edges.size()];
+    }
+
+    void update_proven(u32 v) {
+        dag_node &n = m_dag->m_nodes[v];
+        if (!n.m_expanded || n.is_proven()) return;
+
+        n.m_result = heuristic::best_proven(n.m_edges, [&](dag_edge const &e) {
+            if (e.m_child == dag::NO_CHILD || !m_dag->m_nodes[e.m_child].is_proven()) return heuristic::NEUTRAL_MOVE;
+            return m_dag->m_nodes[e.m_child].parent_result();
+        });
+    }
+
+    void simulate_game(gya::board game) {
+        u32 cur_node = 0;
+        // positions on the path together with the player who moved into them
+        std::vector<std::pair<u32, i32>> nodes_to_update = {{cur_node, -game.turn()}};
+        std::vector<std::pair<u32, u8>> edges_to_update;
+
+        while (!game.has_won().is_game_over()) {
+            if (!m_dag->m_nodes[cur_node].m_expanded) {
+                for (auto m: game.get_actions())
+                    m_dag->m_nodes[cur_node].m_edges.push_back(dag_edge{m, 0, dag::NO_CHILD});
+                m_dag->m_nodes[cur_node].m_expanded = true;
+            }
+
+            // every move may already have been proven through another path
+            const i32 edge_idx = get_edge_with_highest_ucb(cur_node);
+            if (edge_idx < 0) break;
+
+            const i32 player_id = game.turn();
+            const bool is_new_edge = !m_dag->m_nodes[cur_node].m_edges[edge_idx].m_visits;
+            game.play(m_dag->m_nodes[cur_node].m_edges[edge_idx].m_move, player_id);
+
+            if (m_dag->m_nodes[cur_node].m_edges[edge_idx].m_child == dag::NO_CHILD) {
+                const u32 child = m_dag->get_or_insert(game);
+                m_dag->m_nodes[cur_node].m_edges[edge_idx].m_child = child;
+            }
+            edges_to_update.push_back({cur_node, static_cast<u8>(edge_idx)});
+            cur_node = m_dag->m_nodes[cur_node].m_edges[edge_idx].m_child;
+            nodes_to_update.push_back({cur_node, player_id});
+
+            // stop at the first untried move that leads to an unseen position, like expanding a tree leaf
+            if (is_new_edge && !m_dag->m_nodes[cur_node].m_visits) break;
+        }
+
+        update_proven(cur_node);
+
+        i32 winner = 0;
+        gya::game_result result = game.has_won();
+        if (result.is_game_over()) {
+            // the move into cur_node ended the game, so the player to move there has lost (or tied)
+            m_dag->m_nodes[cur_node].m_result = result.is_tie() ? heuristic::TIE_MOVE : heuristic::LOSING_MOVE;
+            if (!result.is_tie())
+                winner = result.player_1_won() ? gya::board::PLAYER_ONE : gya::board::PLAYER_TWO;
+        } else if (auto const proven = m_dag->m_nodes[cur_node].m_result; proven.is_game_over()) {
+            // the position was already proven through another path, so its result replaces the rollout
+            if (!proven.is_tied())
+                winner = proven.is_winning() ? game.turn() : -game.turn();
+        } else {
+            winner = m_playout_kernel.run(game, 1).score() * game.turn();
+        }
+
+        for (auto [v, player_for_node]: nodes_to_update) {
+            i32 node_score = 0;
+            if (winner)
+                node_score = player_for_node == winner ? 1 : -1;
+            ++m_dag->m_nodes[v].m_visits;
+            m_dag->m_nodes[v].m_score += node_score;
+        }
+        for (auto [v, e]: edges_to_update)
+            ++m_dag->m_nodes[v].m_edges[e].m_visits;
+
+        for (usize i = nodes_to_update.size(); i-- > 0;)
+            update_proven(nodes_to_update[i].first);
+    }
+
+    dag_edge const *get_best_edge() {
+        // same policy as mcts::get_best_child, take the fastest proven win or the most visited move not proven to lose
+        dag_node const &root = m_dag->m_nodes[0];
+        auto result_of = [&](dag_edge const &e) {
+            return e.m_child == dag::NO_CHILD ? heuristic::NEUTRAL_MOVE : m_dag->m_nodes[e.m_child].parent_result();
+        };
+
+        dag_edge const *mx_edge = nullptr;
+        heuristic::eval_result mx_eval = heuristic::LOSING_MOVE;
+        i32 mx_visits = -1;
+        for (auto const &e: root.m_edges) {
+            const auto eval = result_of(e);
+            if (eval.is_winning() && (!mx_eval.is_winning() || eval > mx_eval)) {
+                mx_eval = eval;
+                mx_edge = &e;
+            }
+        }
+        if (mx_edge) return mx_edge;
+
+        for (auto const &e: root.m_edges) {
+            if (result_of(e).is_losing()) continue;
+            if (mx_visits < static_cast<i32>(e.m_visits)) {
+                mx_visits = e.m_visits;
+                mx_edge = &e;
+            }
+        }
+        if (mx_edge) return mx_edge;
+
+        for (auto const &e: root.m_edges) {
+            const auto eval = result_of(e);
+            if (!mx_edge || eval > mx_eval) {
+                mx_eval = eval;
+                mx_edge = &e;
+            }
+        }
+        return mx_edge;
+    }
+
+    u8 move(gya::board game, [[maybe_unused]] i32 player_id) {
+        m_dag = std::make_unique<dag>();
+        m_dag->get_or_insert(game);
+
+        for (u32 i = 0; i < m_rollout_limit && !m_dag->m_nodes[0].is_proven(); i++)
+            simulate_game(game);
+
+        return get_best_edge()->m_move;
+    }
+};
+
+} // namespace mcts
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../../include.hpp"
+#include "../brute_force/eval_result.hpp"
 
 namespace mcts {
 
@@ -9,15 +10,37 @@ public:
     u32 m_visits;
     i32 m_score;
 
+    // proven result from the perspective of the player to move in this node, neutral until proven
+    heuristic::eval_result m_result;
+
     node *m_parent;
     std::vector<std::unique_ptr<node>> m_children;
     std::array<i32, 2> m_action;
 
-    node(node *parent = nullptr, std::array<i32, 2> action = {}) : m_visits(0), m_score(0), m_parent(parent), m_action(action) {}
+    node(node *parent = nullptr, std::array<i32, 2> action = {}) : m_visits(0), m_score(0), m_result(), m_parent(parent), m_action(action) {}
 
     bool is_leaf() {
         return m_children.empty();
     }
+
+    bool is_proven() const {
+        return m_result.is_game_over();
+    }
+
+    // proven result from the perspective of the player who moved into this node
+    heuristic::eval_result parent_result() const {
+        // incremented() turns ties into neutral results, so they are carried over as they are
+        return m_result.is_tied() ? heuristic::TIE_MOVE : m_result.incremented();
+    }
+
+    // a node is won if some move leads to a proven loss for the opponent, and lost/tied once every move is proven
+    void update_proven() {
+        if (is_leaf() || is_proven()) return;
+
+        m_result = heuristic::best_proven(m_children, [](auto const &child) {
+            return child->is_proven() ? child->parent_result() : heuristic::NEUTRAL_MOVE;
+        });
+    }
 };
 
 } // namespace mcts
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "../../include.hpp"
+#include "../../bitboard.hpp"
+#include "rollout_policy.hpp"
+
+namespace mcts {
+
+// counted from the perspective of the player to move in the starting position
+struct playout_result {
+    u32 m_wins{};
+    u32 m_losses{};
+    u32 m_ties{};
+
+    [[nodiscard]] constexpr u32 size() const {
+        return m_wins + m_losses + m_ties;
+    }
+
+    [[nodiscard]] constexpr i32 score() const {
+        return static_cast<i32>(m_wins) - static_cast<i32>(m_losses);
+    }
+};
+
+/**
+ * plays many games from the same position on bitboards with moves chosen by POLICY, the games are spread over
+ * NUM_LANES independent lanes that are advanced round robin so the dependency chains of different games overlap.
+ * with avx2 the random policy runs 4 lanes per register, see run_simd
+ */
+template<class POLICY = random_policy, usize NUM_LANES = 8>
+struct playout_kernel {
+    POLICY m_policy;
+
+    // one xorshift state per lane so the random number generation of different lanes doesn't serialize
+    std::array<u64, NUM_LANES> m_rng_states;
+
+    playout_kernel(u64 seed = -1, POLICY policy = {}) : m_policy(std::move(policy)) {
+        gya::random_player rng{seed};
+        for (auto &state: m_rng_states)
+            state = rng.get_num() | 1;
+    }
+
+    static u64 next_random(u64 &state) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    playout_result run(gya::bitboard const &start, u32 num_playouts) {
+        playout_result result;
+        if (!num_playouts) return result;
+        if (!start.legal_moves()) {
+            result.m_ties = num_playouts;
+            return result;
+        }
+#ifdef __AVX2__
+        if constexpr (std::is_same_v<POLICY, random_policy> && NUM_LANES % 4 == 0)
+            return run_simd(start, num_playouts);
+#endif
+
+        std::array<gya::bitboard, NUM_LANES> lanes;
+        std::array<bool, NUM_LANES> active{};
+        u32 num_remaining = num_playouts;
+        u32 num_active = 0;
+        for (usize l = 0; l < NUM_LANES && num_remaining; ++l, --num_remaining, ++num_active) {
+            lanes[l] = start;
+            active[l] = true;
+        }
+
+        while (num_active) {
+            for (usize l = 0; l < NUM_LANES; ++l) {
+                if (!active[l]) continue;
+                auto &b = lanes[l];
+
+                const u64 move = m_policy(b, b.legal_moves(), next_random(m_rng_states[l]));
+
+                bool finished = true;
+                if (b.is_winning_move(move)) {
+                    // the player to move wins, which is the starting player if an even number of moves was played
+                    if ((b.m_moves - start.m_moves) % 2 == 0)
+                        ++result.m_wins;
+                    else
+                        ++result.m_losses;
+                } else {
+                    b.play_bit(move);
+                    if (b.is_full())
+                        ++result.m_ties;
+                    else
+                        finished = false;
+                }
+
+                if (finished) {
+                    if (num_remaining) {
+                        b = start;
+                        --num_remaining;
+                    } else {
+                        active[l] = false;
+                        --num_active;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    playout_result run(gya::board const &start, u32 num_playouts) {
+        return run(gya::bitboard::from_board(start), num_playouts);
+    }
+
+#ifdef __AVX2__
+private:
+    // nonzero in the lanes whose stones have four in a row, like gya::bitboard::has_four
+    template<u64 SHIFT>
+    static __m256i four_in_direction(__m256i stones) {
+        const __m256i m = _mm256_and_si256(stones, _mm256_srli_epi64(stones, SHIFT));
+        return _mm256_and_si256(m, _mm256_srli_epi64(m, 2 * SHIFT));
+    }
+
+    /**
+     * random playouts with one game per 64 bit lane. every lane picks a random column and skips the step if that column
+     * is full, which keeps the move uniform over the legal columns without popcount and pdep, which have no avx2
+     * counterpart. lanes that have no game left to play get a full board so that they never move again, the rare
+     * finished games are counted and restarted in scalar code
+     */
+    playout_result run_simd(gya::bitboard const &start, u32 num_playouts) {
+        using gya::bitboard;
+        constexpr usize NUM_VECTORS = NUM_LANES / 4;
+        playout_result result;
+
+        alignas(32) std::array<u64, NUM_LANES> positions, masks, moves;
+        u32 num_remaining = num_playouts, num_active = 0;
+        for (usize l = 0; l < NUM_LANES; ++l) {
+            moves[l] = 0;
+            if (num_remaining) {
+                positions[l] = start.m_position;
+                masks[l] = start.m_mask;
+                --num_remaining;
+                ++num_active;
+            } else {
+                positions[l] = 0;
+                masks[l] = bitboard::BOARD_MASK;
+            }
+        }
+        auto load = [](std::array<u64, NUM_LANES> const &values, usize v) {
+            return _mm256_load_si256(reinterpret_cast<__m256i const *>(values.data() + 4 * v));
+        };
+        __m256i position[NUM_VECTORS], mask[NUM_VECTORS], num_moves[NUM_VECTORS], rng[NUM_VECTORS];
+        for (usize v = 0; v < NUM_VECTORS; ++v) {
+            position[v] = load(positions, v);
+            mask[v] = load(masks, v);
+            num_moves[v] = load(moves, v);
+            rng[v] = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(m_rng_states.data() + 4 * v));
+        }
+
+        const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi64x(1);
+        const __m256i seven = _mm256_set1_epi64x(bitboard::COLUMN_STRIDE);
+        const __m256i column_bits = _mm256_set1_epi64x((1ll << gya::BOARD_HEIGHT) - 1);
+        const __m256i moves_left = _mm256_set1_epi64x(gya::BOARD_WIDTH * gya::BOARD_HEIGHT - start.m_moves);
+        while (num_active) {
+            for (usize v = 0; v < NUM_VECTORS; ++v) {
+                __m256i r = rng[v];
+                r = _mm256_xor_si256(r, _mm256_slli_epi64(r, 13));
+                r = _mm256_xor_si256(r, _mm256_srli_epi64(r, 7));
+                r = _mm256_xor_si256(r, _mm256_slli_epi64(r, 17));
+                rng[v] = r;
+
+                // multiply-shift of the low 32 random bits onto a column in [0, 7), the column starts at bit 7 * column
+                const __m256i column = _mm256_srli_epi64(_mm256_mul_epu32(r, seven), 32);
+                const __m256i shift = _mm256_sub_epi64(_mm256_slli_epi64(column, 3), column);
+                // a full column carries into the empty top bit, which isn't part of the column
+                const __m256i move = _mm256_and_si256(_mm256_add_epi64(mask[v], _mm256_sllv_epi64(one, shift)),
+                                                      _mm256_sllv_epi64(column_bits, shift));
+                const __m256i skipped = _mm256_cmpeq_epi64(move, zero);
+
+                const __m256i stones = _mm256_or_si256(position[v], move);
+                const __m256i four = _mm256_or_si256(
+                        _mm256_or_si256(four_in_direction<bitboard::COLUMN_STRIDE>(stones),
+                                        four_in_direction<bitboard::COLUMN_STRIDE + 1>(stones)),
+                        _mm256_or_si256(four_in_direction<bitboard::COLUMN_STRIDE - 1>(stones),
+                                        four_in_direction<1>(stones)));
+                const __m256i won = _mm256_andnot_si256(_mm256_cmpeq_epi64(four, zero), _mm256_cmpeq_epi64(zero, zero));
+
+                position[v] = _mm256_xor_si256(position[v], _mm256_andnot_si256(skipped, mask[v]));
+                mask[v] = _mm256_or_si256(mask[v], move);
+                num_moves[v] = _mm256_add_epi64(num_moves[v], _mm256_andnot_si256(skipped, one));
+                const __m256i full = _mm256_andnot_si256(skipped, _mm256_cmpeq_epi64(num_moves[v], moves_left));
+
+                const i32 finished = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_or_si256(won, full)));
+                if (!finished) [[likely]] continue;
+
+                const i32 wins = _mm256_movemask_pd(_mm256_castsi256_pd(won));
+                alignas(32) std::array<u64, 4> lane_position, lane_mask, lane_moves;
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lane_position.data()), position[v]);
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lane_mask.data()), mask[v]);
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lane_moves.data()), num_moves[v]);
+                for (usize l = 0; l < 4; ++l) {
+                    if (!(finished >> l & 1)) continue;
+                    // the starting player made the winning move if it was the first, third, ... move of the game
+                    if (wins >> l & 1) {
+                        if (lane_moves[l] & 1)
+                            ++result.m_wins;
+                        else
+                            ++result.m_losses;
+                    } else {
+                        ++result.m_ties;
+                    }
+                    lane_moves[l] = 0;
+                    if (num_remaining) {
+                        lane_position[l] = start.m_position;
+                        lane_mask[l] = start.m_mask;
+                        --num_remaining;
+                    } else {
+                        lane_position[l] = 0;
+                        lane_mask[l] = bitboard::BOARD_MASK;
+                        --num_active;
+                    }
+                }
+                position[v] = _mm256_load_si256(reinterpret_cast<__m256i const *>(lane_position.data()));
+                mask[v] = _mm256_load_si256(reinterpret_cast<__m256i const *>(lane_mask.data()));
+                num_moves[v] = _mm256_load_si256(reinterpret_cast<__m256i const *>(lane_moves.data()));
+            }
+        }
+
+        for (usize v = 0; v < NUM_VECTORS; ++v)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(m_rng_states.data() + 4 * v), rng[v]);
+        return result;
+    }
+#endif
+};
+
+} // namespace mcts
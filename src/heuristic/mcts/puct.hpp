@@ -0,0 +1,349 @@
+#pragma once
+
+#include "../../include.hpp"
+#include "../../neural_net_testing/neural_net_player.hpp"
+
+namespace mcts {
+
+struct evaluation {
+    std::array<f32, gya::BOARD_WIDTH> m_priors{}; // probability of playing each column, 0 for full columns
+    f32 m_value{};                                 // expected result in [-1, 1] for the player to move
+};
+
+/**
+ * the networks in this repo output one q value per column, the priors are the softmax of the legal q values and the
+ * value is the best legal q value
+ */
+inline evaluation evaluation_from_q_values(gya::board const &b, std::span<const f32> q, f32 temperature = 1) {
+    evaluation res;
+    f32 mx = -std::numeric_limits<f32>::max();
+    for (u8 col = 0; col < gya::BOARD_WIDTH; ++col)
+        if (b[col].height < gya::BOARD_HEIGHT) mx = std::max(mx, q[col]);
+
+    f32 sum = 0;
+    for (u8 col = 0; col < gya::BOARD_WIDTH; ++col) {
+        if (b[col].height >= gya::BOARD_HEIGHT) continue;
+        res.m_priors[col] = std::exp((q[col] - mx) / temperature);
+        sum += res.m_priors[col];
+    }
+    for (auto &p: res.m_priors)
+        p /= sum;
+    res.m_value = std::clamp(mx, -1.0f, 1.0f);
+    return res;
+}
+
+// the whole batch goes through one neural_net::evaluate_batch call on the encoding of NEURAL_NET_PLAYER
+template<class NEURAL_NET_PLAYER, class NEURAL_NET>
+void evaluate_positions(NEURAL_NET const &net, std::span<gya::board const> positions, std::span<evaluation> results) {
+    constexpr usize NUM_INPUTS = gya::BOARD_WIDTH * gya::BOARD_HEIGHT;
+    thread_local std::vector<f32> inputs, outputs;
+    inputs.resize(positions.size() * NUM_INPUTS);
+    outputs.resize(positions.size() * gya::BOARD_WIDTH);
+    for (usize i = 0; i < positions.size(); ++i) {
+        const auto input = NEURAL_NET_PLAYER::encode(positions[i]);
+        std::copy(input.begin(), input.end(), inputs.begin() + static_cast<isize>(i * NUM_INPUTS));
+    }
+    net.evaluate_batch(inputs, positions.size(), outputs);
+    for (usize i = 0; i < positions.size(); ++i)
+        results[i] = evaluation_from_q_values(positions[i], std::span{outputs}.subspan(i * gya::BOARD_WIDTH,
+                                                                                       gya::BOARD_WIDTH));
+}
+
+// batch evaluator for a gya::neural_net_player
+template<class NEURAL_NET_PLAYER>
+struct neural_net_evaluator {
+    NEURAL_NET_PLAYER m_player;
+
+    void operator()(std::span<gya::board const> positions, std::span<evaluation> results) const {
+        evaluate_positions<NEURAL_NET_PLAYER>(m_player.m_net, positions, results);
+    }
+};
+
+/**
+ * batch evaluator for a gya::neural_net with 42 inputs in the encoding of gya::neural_net_player and 7 outputs, for
+ * nets that are too big to be copied around with the evaluator. batching pays off for these, the tiles of
+ * evaluate_batch load each weight once for up to 12 positions
+ */
+template<class NEURAL_NET>
+struct shared_net_evaluator {
+    std::shared_ptr<const NEURAL_NET> m_net;
+
+    void operator()(std::span<gya::board const> positions, std::span<evaluation> results) const {
+        evaluate_positions<gya::neural_net_player<>>(*m_net, positions, results);
+    }
+};
+
+/**
+ * collects leaf positions from the search threads and evaluates them on its own inference thread. BATCH_EVALUATOR is
+ * called with up to max_batch_size positions at a time:
+ *  void(std::span<gya::board const> positions, std::span<evaluation> results)
+ * a batch is run as soon as it is full, or after max_wait when the search threads have nothing more to submit
+ */
+template<class BATCH_EVALUATOR>
+class batch_queue {
+    struct request {
+        gya::board m_board;
+        evaluation *m_result;
+        std::atomic<u32> *m_pending; // decremented once m_result is written
+    };
+
+    BATCH_EVALUATOR m_evaluator;
+    usize m_max_batch_size;
+    std::chrono::microseconds m_max_wait;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<request> m_requests;
+    bool m_stop = false;
+
+    std::thread m_thread;
+
+public:
+    std::atomic<u64> m_num_batches{0};
+    std::atomic<u64> m_num_positions{0};
+
+    batch_queue(BATCH_EVALUATOR evaluator, usize max_batch_size,
+                std::chrono::microseconds max_wait = std::chrono::microseconds{100})
+            : m_evaluator(std::move(evaluator)), m_max_batch_size(std::max(max_batch_size, usize{1})),
+              m_max_wait(max_wait), m_thread([this] { run(); }) {}
+
+    batch_queue(batch_queue const &) = delete;
+
+    batch_queue &operator=(batch_queue const &) = delete;
+
+    ~batch_queue() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+    // the caller has to keep result and pending alive until pending was decremented
+    void submit(gya::board const &b, evaluation *result, std::atomic<u32> *pending) {
+        usize num_requests;
+        {
+            std::lock_guard lock(m_mutex);
+            m_requests.push_back({b, result, pending});
+            num_requests = m_requests.size();
+        }
+        // the inference thread only has to be woken up for the first request and once the batch is full
+        if (num_requests == 1 || num_requests >= m_max_batch_size)
+            m_cv.notify_one();
+    }
+
+    evaluation evaluate(gya::board const &b) {
+        evaluation res;
+        std::atomic<u32> pending{1};
+        submit(b, &res, &pending);
+        pending.wait(1);
+        return res;
+    }
+
+private:
+    void run() {
+        std::vector<request> batch;
+        std::vector<gya::board> boards;
+        std::vector<evaluation> results;
+        while (true) {
+            {
+                std::unique_lock lock(m_mutex);
+                m_cv.wait(lock, [&] { return m_stop || !m_requests.empty(); });
+                if (m_requests.empty()) return;
+                m_cv.wait_for(lock, m_max_wait, [&] { return m_stop || m_requests.size() >= m_max_batch_size; });
+
+                const usize batch_size = std::min(m_requests.size(), m_max_batch_size);
+                batch.assign(m_requests.begin(), m_requests.begin() + static_cast<isize>(batch_size));
+                m_requests.erase(m_requests.begin(), m_requests.begin() + static_cast<isize>(batch_size));
+            }
+
+            boards.clear();
+            for (auto const &r: batch)
+                boards.push_back(r.m_board);
+            results.resize(batch.size());
+            m_evaluator(std::span<gya::board const>{boards}, std::span<evaluation>{results});
+
+            for (usize i = 0; i < batch.size(); ++i) {
+                *batch[i].m_result = results[i];
+                if (batch[i].m_pending->fetch_sub(1) == 1)
+                    batch[i].m_pending->notify_one();
+            }
+            m_num_batches.fetch_add(1, std::memory_order_relaxed);
+            m_num_positions.fetch_add(batch.size(), std::memory_order_relaxed);
+        }
+    }
+};
+
+class puct_node {
+public:
+    f32 m_prior;
+    u8 m_move;
+    bool m_expanded = false;
+    bool m_pending = false; // a search thread is waiting for the evaluation of this node
+
+    u32 m_visits = 0;
+    u32 m_virtual_loss = 0;
+    f32 m_value_sum = 0; // from the perspective of the player who moved into this node
+
+    std::vector<std::unique_ptr<puct_node>> m_children;
+
+    puct_node(f32 prior = 1, u8 move = 0) : m_prior(prior), m_move(move) {}
+
+    // mean value with every pending descent counted as a loss, so that concurrent descents spread out
+    [[nodiscard]] f32 q_value() const {
+        const u32 n = m_visits + m_virtual_loss;
+        return n ? (m_value_sum - static_cast<f32>(m_virtual_loss)) / static_cast<f32>(n) : 0.0f;
+    }
+};
+
+/**
+ * alphazero style search: leaves are evaluated by a network instead of rollouts and children are selected by
+ * q + c_puct * prior * sqrt(parent visits) / (1 + visits). several search threads share the tree, each of them descends
+ * descents_per_batch times with virtual loss, hands the leaves to the batch_queue and backs up the values once the
+ * inference thread has evaluated them
+ */
+template<class BATCH_EVALUATOR>
+class puct {
+public:
+    u32 m_rollout_limit;
+    u32 m_num_threads;
+    u32 m_descents_per_batch;
+    f32 m_c_puct;
+
+    batch_queue<BATCH_EVALUATOR> m_queue;
+
+    puct(BATCH_EVALUATOR evaluator, u32 rollout_limit, u32 num_threads = 4, u32 descents_per_batch = 4,
+         f32 c_puct = 1.5f)
+            : m_rollout_limit(rollout_limit), m_num_threads(std::max(num_threads, 1u)),
+              m_descents_per_batch(std::max(descents_per_batch, 1u)), m_c_puct(c_puct),
+              m_queue(std::move(evaluator), m_num_threads * m_descents_per_batch) {}
+
+    u8 move(gya::board const &game, [[maybe_unused]] i32 player_id) {
+        m_root = std::make_unique<puct_node>();
+        m_num_simulations = 0;
+        expand(m_root.get(), game, m_queue.evaluate(game));
+
+        std::vector<std::thread> threads;
+        for (u32 i = 0; i < m_num_threads; ++i)
+            threads.emplace_back([&] { search(game); });
+        for (auto &t: threads)
+            t.join();
+
+        // an immediate win doesn't need to be visited often to be the best move
+        for (auto const &child: m_root->m_children) {
+            gya::board copy = game;
+            copy.play(child->m_move);
+            if (copy.has_won().is_game_over() && !copy.has_won().is_tie()) return child->m_move;
+        }
+        auto const &best = *std::max_element(m_root->m_children.begin(), m_root->m_children.end(),
+                                             [](auto const &a, auto const &b) { return a->m_visits < b->m_visits; });
+        return best->m_move;
+    }
+
+    [[nodiscard]] puct_node const *root() const {
+        return m_root.get();
+    }
+
+private:
+    struct leaf {
+        std::vector<puct_node *> m_path;
+        gya::board m_board;
+        evaluation m_evaluation;
+    };
+
+    std::unique_ptr<puct_node> m_root;
+    std::mutex m_tree_mutex;
+    std::atomic<u32> m_num_simulations{0};
+
+    puct_node *select_child(puct_node *v) const {
+        const f32 sqrt_visits = std::sqrt(static_cast<f32>(v->m_visits + v->m_virtual_loss));
+        puct_node *best = nullptr;
+        f32 mx_score = -std::numeric_limits<f32>::max();
+        for (auto &child: v->m_children) {
+            const f32 u = m_c_puct * child->m_prior * sqrt_visits /
+                          static_cast<f32>(1 + child->m_visits + child->m_virtual_loss);
+            const f32 score = child->q_value() + u;
+            if (score > mx_score) {
+                mx_score = score;
+                best = child.get();
+            }
+        }
+        return best;
+    }
+
+    static void expand(puct_node *v, gya::board const &b, evaluation const &e) {
+        for (u8 col = 0; col < gya::BOARD_WIDTH; ++col)
+            if (b[col].height < gya::BOARD_HEIGHT)
+                v->m_children.push_back(std::make_unique<puct_node>(e.m_priors[col], col));
+        v->m_expanded = true;
+        v->m_pending = false;
+    }
+
+    // value is from the perspective of the player to move at the end of the path
+    static void backup(std::vector<puct_node *> const &path, f32 value) {
+        for (usize i = path.size(); i-- > 0;) {
+            value = -value;
+            path[i]->m_value_sum += value;
+            ++path[i]->m_visits;
+            if (i) --path[i]->m_virtual_loss;
+        }
+    }
+
+    void search(gya::board const &game) {
+        std::vector<leaf> leaves(m_descents_per_batch);
+        std::atomic<u32> pending{0};
+        while (m_num_simulations.load(std::memory_order_relaxed) < m_rollout_limit) {
+            usize num_leaves = 0;
+            {
+                std::lock_guard lock(m_tree_mutex);
+                for (u32 d = 0; d < m_descents_per_batch; ++d) {
+                    leaf &l = leaves[num_leaves];
+                    l.m_path = {m_root.get()};
+                    l.m_board = game;
+                    puct_node *v = m_root.get();
+                    while (v->m_expanded && !v->m_children.empty()) {
+                        v = select_child(v);
+                        ++v->m_virtual_loss;
+                        l.m_board.play(v->m_move);
+                        l.m_path.push_back(v);
+                        if (l.m_board.has_won().is_game_over()) break;
+                    }
+
+                    if (auto const result = l.m_board.has_won(); result.is_game_over()) {
+                        // the player to move has lost (or tied), no evaluation needed
+                        backup(l.m_path, result.is_tie() ? 0.0f : -1.0f);
+                        m_num_simulations.fetch_add(1, std::memory_order_relaxed);
+                    } else if (v->m_pending) {
+                        // another descent is already waiting for this leaf, undo the virtual loss and try again later
+                        for (usize i = 1; i < l.m_path.size(); ++i)
+                            --l.m_path[i]->m_virtual_loss;
+                    } else {
+                        v->m_pending = true;
+                        ++num_leaves;
+                    }
+                }
+            }
+            if (!num_leaves) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            pending.store(static_cast<u32>(num_leaves));
+            for (usize i = 0; i < num_leaves; ++i)
+                m_queue.submit(leaves[i].m_board, &leaves[i].m_evaluation, &pending);
+            for (u32 p = pending.load(); p; p = pending.load())
+                pending.wait(p);
+
+            std::lock_guard lock(m_tree_mutex);
+            for (usize i = 0; i < num_leaves; ++i) {
+                leaf &l = leaves[i];
+                expand(l.m_path.back(), l.m_board, l.m_evaluation);
+                backup(l.m_path, l.m_evaluation.m_value);
+            }
+            m_num_simulations.fetch_add(static_cast<u32>(num_leaves), std::memory_order_relaxed);
+        }
+    }
+};
+
+} // namespace mcts
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../../include.hpp"
+#include "../../bitboard.hpp"
+
+namespace mcts {
+
+/**
+ * rollout policies pick the next move of a playout, they get the position, its legal moves and 64 random bits and
+ * return the bit of the chosen move. they are template parameters of the playout kernel so that the tactical
+ * checks get inlined into the playout loop
+ */
+
+// n-th (zero-indexed) set bit of x
+inline u64 select_bit(u64 x, u32 n) {
+#ifdef __BMI2__
+    return _pdep_u64(1ull << n, x);
+#else
+    for (; n; --n) x &= x - 1;
+    return x & -x;
+#endif
+}
+
+inline u64 random_move(u64 moves, u64 random) {
+    // multiply-shift maps 32 random bits onto [0, popcount) without a division
+    const auto idx = static_cast<u32>(((random >> 32) * std::popcount(moves)) >> 32);
+    return select_bit(moves, idx);
+}
+
+struct random_policy {
+    u64 operator()([[maybe_unused]] gya::bitboard const &b, u64 legal, u64 random) const {
+        return random_move(legal, random);
+    }
+};
+
+// same as heuristic::one_move_solver
+struct win_policy {
+    u64 operator()(gya::bitboard const &b, u64 legal, u64 random) const {
+        if (const u64 wins = b.winning_moves())
+            return wins & -wins;
+        return random_move(legal, random);
+    }
+};
+
+// wins if possible, otherwise blocks an immediate win of the opponent, like the first part of heuristic::two_move_solver
+struct win_block_policy {
+    u64 operator()(gya::bitboard const &b, u64 legal, u64 random) const {
+        if (const u64 wins = b.winning_moves())
+            return wins & -wins;
+        if (const u64 threats = b.opponent_winning_moves())
+            return threats & -threats;
+        return random_move(legal, random);
+    }
+};
+
+// plays the move a neural_net_player would play, the player is copied into the policy
+template<class NEURAL_NET_PLAYER>
+struct neural_net_policy {
+    NEURAL_NET_PLAYER m_player;
+
+    u64 operator()(gya::bitboard const &b, u64 legal, [[maybe_unused]] u64 random) const {
+        // the bitboard uses the same column major layout with a stride of 7 as neural_net_player's input, +1 for
+        // stones of the player to move and -1 for the opponent's
+        std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT> input{};
+        for (usize i = 0; i < input.size(); ++i) {
+            if (b.m_position >> i & 1) input[i] = 1;
+            else if (b.m_mask >> i & 1) input[i] = -1;
+        }
+        const auto net_output = m_player.m_net.evaluate_const(input);
+
+        u64 best = 0;
+        f32 best_value = -std::numeric_limits<f32>::max();
+        for (u8 col = 0; col < gya::BOARD_WIDTH; ++col) {
+            const u64 move = legal & gya::bitboard::column_mask(col);
+            if (move && net_output[col] > best_value) {
+                best_value = net_output[col];
+                best = move;
+            }
+        }
+        return best;
+    }
+};
+
+} // namespace mcts
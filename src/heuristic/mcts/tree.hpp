@@ -11,6 +11,29 @@ public:
     std::unique_ptr<node> m_root;
 
     tree() : m_root(std::make_unique<node>()) {}
+
+    [[nodiscard]] usize size() const {
+        return size(m_root.get());
+    }
+
+    [[nodiscard]] usize memory_usage() const {
+        return memory_usage(m_root.get());
+    }
+
+private:
+    static usize size(node const *v) {
+        usize result = 1;
+        for (auto &child: v->m_children)
+            result += size(child.get());
+        return result;
+    }
+
+    static usize memory_usage(node const *v) {
+        usize result = sizeof(node) + v->m_children.capacity() * sizeof(std::unique_ptr<node>);
+        for (auto &child: v->m_children)
+            result += memory_usage(child.get());
+        return result;
+    }
 };
 
 } // namespace mcts
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../../include.hpp"
+#include "../../neural_net_testing/accumulator.hpp"
+#include "../../neural_net_testing/neural_net_player.hpp"
+
+namespace heuristic {
+/**
+ * fixed depth negamax with alpha-beta pruning that scores the leaves with the net of a gya::neural_net_player. the
+ * first layer is kept in a gya::first_layer_accumulator that is updated by play / undo along the search, so a leaf only
+ * runs the layers after the first one. like mcts::evaluation_from_q_values the value of a leaf is the best legal q
+ * value clamped to [-1, 1], won and lost positions are worth more than any leaf and are preferred the earlier they are
+ * reached. the quantized first layer is built once, the searcher has to be rebuilt whenever the net changes
+ */
+template<class NEURAL_NET_PLAYER = gya::neural_net_player<>>
+struct nn_alpha_beta {
+    using accumulator_t = gya::first_layer_accumulator<typename NEURAL_NET_PLAYER::neural_net_t>;
+
+    static constexpr f32 WIN = 2;
+    // center columns first, they are the most likely to cut
+    static constexpr std::array<u8, gya::BOARD_WIDTH> MOVE_ORDER{3, 2, 4, 1, 5, 0, 6};
+
+    NEURAL_NET_PLAYER m_player;
+    typename accumulator_t::weights m_weights;
+    u32 m_depth;
+
+    nn_alpha_beta(NEURAL_NET_PLAYER const &player, u32 depth)
+        : m_player(player), m_weights(player.m_net), m_depth(depth) {}
+
+    // value of b for the player to move, searched m_depth moves deep
+    [[nodiscard]] f32 evaluate_board(gya::board const &b) const {
+        accumulator_t acc;
+        acc.refresh(m_weights, b);
+        return search(b, acc, m_depth, 0, -WIN - 1, WIN + 1);
+    }
+
+    [[nodiscard]] u8 operator()(gya::board const &b) const {
+        if (b.get_actions().empty())
+            throw std::runtime_error("board is full");
+        accumulator_t acc;
+        acc.refresh(m_weights, b);
+        f32 alpha = -WIN - 1;
+        u8 best_move = b.get_actions()[0];
+        for (u8 move: MOVE_ORDER) {
+            if (b[move].height >= gya::BOARD_HEIGHT) continue;
+            const gya::board next = b.play_copy(move);
+            acc.play(m_weights, next, move);
+            const f32 evaluation = -search(next, acc, std::max(m_depth, 1u) - 1, 1, -WIN - 1, -alpha);
+            acc.undo(m_weights, next, move);
+            if (evaluation > alpha) {
+                alpha = evaluation;
+                best_move = move;
+            }
+        }
+        return best_move;
+    }
+
+private:
+    [[nodiscard]] f32 leaf_value(gya::board const &b, accumulator_t const &acc) const {
+        const auto q = acc.evaluate(m_weights, m_player.m_net, b.turn());
+        f32 mx = -std::numeric_limits<f32>::max();
+        for (u8 col = 0; col < gya::BOARD_WIDTH; ++col)
+            if (b[col].height < gya::BOARD_HEIGHT) mx = std::max(mx, static_cast<f32>(q[col]));
+        return std::clamp(mx, -1.0f, 1.0f);
+    }
+
+    f32 search(gya::board const &b, accumulator_t &acc, u32 depth, u32 ply, f32 alpha, f32 beta) const {
+        // only the player that just moved can have won
+        if (const gya::game_result result = b.has_won(); result.is_game_over())
+            return result.is_tie() ? 0 : -(WIN - static_cast<f32>(ply) * 1e-3f);
+        if (!depth) return leaf_value(b, acc);
+
+        f32 best_eval = -WIN - 1;
+        for (u8 move: MOVE_ORDER) {
+            if (b[move].height >= gya::BOARD_HEIGHT) continue;
+            const gya::board next = b.play_copy(move);
+            acc.play(m_weights, next, move);
+            const f32 evaluation = -search(next, acc, depth - 1, ply + 1, -beta, -alpha);
+            acc.undo(m_weights, next, move);
+            best_eval = std::max(best_eval, evaluation);
+            alpha = std::max(alpha, evaluation);
+            if (alpha >= beta) break;
+        }
+        return best_eval;
+    }
+};
+} // namespace heuristic
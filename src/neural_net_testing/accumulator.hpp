@@ -0,0 +1,119 @@
+#pragma once
+
+#include "../board.hpp"
+#include "../include.hpp"
+#include "neural_net.hpp"
+
+namespace gya {
+
+template<class NEURAL_NET>
+class first_layer_accumulator;
+
+/**
+ * efficiently updatable first layer (like the accumulator of nnue) for nets that get the board as input in the
+ * layout of neural_net_player::encode, stone * turn for column i and row j at input i * BOARD_WIDTH + j.
+ * one move only changes one input, so instead of recomputing the first layer the accumulator keeps
+ *  sum = sum over all stones of (PLAYER_ONE ? 1 : -1) * weights[0][input]
+ * in int16 and adds or subtracts a single quantized weight row per move. the pre-activation for the player to move is
+ * bias + turn * sum, only the layers after the first one are run per evaluation
+ */
+template<bool USE_BACKPROP, bool LABELED_DATA, class T, class F1, class F2, usize... sizes>
+class first_layer_accumulator<neural_net<USE_BACKPROP, LABELED_DATA, T, F1, F2, sizes...>> {
+public:
+    using neural_net_t = neural_net<USE_BACKPROP, LABELED_DATA, T, F1, F2, sizes...>;
+
+    static constexpr usize NUM_INPUTS = std::array{sizes...}[0];
+    static constexpr usize NUM_HIDDEN = std::array{sizes...}[1];
+    static constexpr usize NUM_OUTPUTS = std::array{sizes...}.back();
+    // 16 int16 per avx2 register
+    static constexpr usize PADDED_HIDDEN = (NUM_HIDDEN + 15) / 16 * 16;
+
+    // the quantized first layer of a net, has to be rebuilt whenever the net changes
+    struct weights {
+        alignas(64) std::array<i16, NUM_INPUTS * PADDED_HIDDEN> m_rows{};
+        f32 m_scale = 1;
+
+        explicit weights(neural_net_t const &net) {
+            // the scale is chosen so that no sum of rounded weight rows can overflow int16
+            f32 mx_sum = 0;
+            for (usize node = 0; node < NUM_HIDDEN; ++node) {
+                f32 sum = 0;
+                for (usize input = 0; input < NUM_INPUTS; ++input)
+                    sum += std::abs(static_cast<f32>(net.m_weights[0][input][node]));
+                mx_sum = std::max(mx_sum, sum);
+            }
+            constexpr auto MAX_SUM = static_cast<f32>(std::numeric_limits<i16>::max() - NUM_INPUTS);
+            m_scale = mx_sum > 0 ? MAX_SUM / mx_sum : 1.0f;
+            for (usize input = 0; input < NUM_INPUTS; ++input)
+                for (usize node = 0; node < NUM_HIDDEN; ++node)
+                    m_rows[input * PADDED_HIDDEN + node] =
+                            static_cast<i16>(std::lround(static_cast<f32>(net.m_weights[0][input][node]) * m_scale));
+        }
+    };
+
+    alignas(32) std::array<i16, PADDED_HIDDEN> m_sum{};
+
+    static constexpr i32 input_index(u8 column, u8 row) {
+        return column * BOARD_WIDTH + row;
+    }
+
+    void refresh(weights const &w, gya::board const &b) {
+        m_sum.fill(0);
+        for (u8 col = 0; col < BOARD_WIDTH; ++col)
+            for (u8 row = 0; row < b[col].height; ++row)
+                add(w, col, row, b[col][row]);
+    }
+
+    // the stone of player is placed on (column, row), does nothing for cells the net doesn't see
+    void add(weights const &w, u8 column, u8 row, i8 player) {
+        update(w, column, row, player == board::PLAYER_ONE);
+    }
+
+    void remove(weights const &w, u8 column, u8 row, i8 player) {
+        update(w, column, row, player != board::PLAYER_ONE);
+    }
+
+    // the stone that was just played into column
+    void play(weights const &w, gya::board const &after_move, u8 column) {
+        const u8 row = after_move[column].height - 1;
+        add(w, column, row, after_move[column][row]);
+    }
+
+    void undo(weights const &w, gya::board const &after_move, u8 column) {
+        const u8 row = after_move[column].height - 1;
+        remove(w, column, row, after_move[column][row]);
+    }
+
+    /**
+     * @param turn player to move, the net sees the board from their perspective
+     */
+    [[nodiscard]] std::array<T, NUM_OUTPUTS> evaluate(weights const &w, neural_net_t const &net, i8 turn) const {
+        std::array<T, NUM_HIDDEN> hidden;
+        const f32 factor = static_cast<f32>(turn) / w.m_scale;
+        for (usize node = 0; node < NUM_HIDDEN; ++node)
+            hidden[node] = net.m_activation_function(net.m_biases[1][node] + static_cast<T>(m_sum[node] * factor));
+        std::array<T, NUM_OUTPUTS> out;
+        net.evaluate_from_first_hidden(hidden, out);
+        return out;
+    }
+
+private:
+    void update(weights const &w, u8 column, u8 row, bool add_row) {
+        const i32 input = input_index(column, row);
+        if (input >= static_cast<i32>(NUM_INPUTS)) return;
+        i16 const *src = w.m_rows.data() + input * PADDED_HIDDEN;
+#ifdef __AVX2__
+        for (usize i = 0; i < PADDED_HIDDEN; i += 16) {
+            const __m256i acc = _mm256_load_si256(reinterpret_cast<__m256i const *>(m_sum.data() + i));
+            const __m256i row_weights = _mm256_load_si256(reinterpret_cast<__m256i const *>(src + i));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(m_sum.data() + i),
+                               add_row ? _mm256_add_epi16(acc, row_weights) : _mm256_sub_epi16(acc, row_weights));
+        }
+#else
+        for (usize i = 0; i < PADDED_HIDDEN; ++i)
+            m_sum[i] = static_cast<i16>(add_row ? m_sum[i] + src[i] : m_sum[i] - src[i]);
+#endif
+    }
+};
+
+} // namespace gya
@@ -3,16 +3,33 @@
 #include "../board.hpp"
 #include "../include.hpp"
 #include "layer_array.hpp"
+#include "neural_net_file.hpp"
 #include "optional_structures.hpp"
+#include "packed_weights.hpp"
 #include "weight_array.hpp"
 
 namespace gya {
+
+#ifdef __AVX__
+// activation functions that also have an overload for 8 floats at a time are applied inside the simd forward pass
+template<class F>
+concept simd_activation = requires(F const &f, __m256 x) {
+    _mm256_movemask_ps(f(x)); // __m256 can't be a template argument without losing its attributes
+};
+#endif
+
 template<bool USE_BACKPROP, bool LABELED_DATA, class T, class F1, class F2, usize... sizes>
 struct neural_net {
     layer_array<T, sizes...> m_values;
     layer_array<T, sizes...> m_biases;
     weight_array<T, sizes...> m_weights;
 
+    // has to be refreshed with pack() after m_weights or m_biases was changed from outside of this class
+    packed_weights<T, sizes...> m_packed;
+    // packed weights inside a mapped file from load, used instead of m_packed until the next pack(). m_weights and
+    // m_biases are never mapped, load copies them
+    std::shared_ptr<const packed_weights<T, sizes...>> m_mapped_packed;
+
     [[no_unique_address]] optional_layer_array<USE_BACKPROP, T, sizes...> m_bias_derivatives_acc;
     [[no_unique_address]] optional_weight_array<USE_BACKPROP, T, sizes...> m_weight_derivatives_acc;
 
@@ -25,6 +42,13 @@ struct neural_net {
     // for passing around derivatives
     using derivative_pair_t = std::pair<std::unique_ptr<weight_array<T, sizes...>>, std::unique_ptr<layer_array<T, sizes...>>>;
 
+    // scratch space of backward_propagate, keep one per thread and reuse it so that training doesn't allocate
+    struct gradient_workspace {
+        layer_array<T, sizes...> m_deltas;
+        weight_array<T, sizes...> m_weight_gradients;
+        layer_array<T, sizes...> m_bias_gradients;
+    };
+
     F1 m_activation_function;
     F2 m_activation_derivative;
 
@@ -36,6 +60,8 @@ struct neural_net {
         m_weights.m_data = other.m_weights.m_data;
         m_values.m_data = other.m_values.m_data;
         m_biases.m_data = other.m_biases.m_data;
+        m_packed = other.m_packed;
+        m_mapped_packed = other.m_mapped_packed;
         return *this;
     }
 
@@ -56,6 +82,16 @@ struct neural_net {
             v += dist(rng);
         for (auto &v: m_biases.m_data)
             v += dist(rng);
+        pack();
+    }
+
+    void pack() {
+        m_packed.pack(m_weights, m_biases);
+        m_mapped_packed.reset();
+    }
+
+    [[nodiscard]] packed_weights<T, sizes...> const &packed() const {
+        return m_mapped_packed ? *m_mapped_packed : m_packed;
     }
 
     static auto compute_cost(std::span<T> output, std::span<T> correct_output) {
@@ -197,6 +233,7 @@ struct neural_net {
                 }
             }
         }
+        pack();
         clear_derivatives();
     }
 
@@ -209,6 +246,255 @@ struct neural_net {
     }
 
     [[nodiscard]] std::span<T> forward_propagate(std::span<T> input, layer_array<T, sizes...> &values) const {
+#if defined(__AVX2__) && defined(__FMA__)
+        if constexpr (std::is_same_v<T, f32>)
+            return forward_propagate_simd(input, values);
+        else
+#endif
+            return forward_propagate_scalar(input, values);
+    }
+
+#if defined(__AVX2__) && defined(__FMA__)
+    [[nodiscard]] std::span<T> forward_propagate_simd(std::span<T> input, layer_array<T, sizes...> &values) const {
+        using packed_t = packed_weights<T, sizes...>;
+        alignas(64) std::array<f32, packed_t::MAX_PADDED_SIZE> buffers[2];
+        std::copy(input.begin(), input.end(), values.front().begin());
+
+        std::array<u16, packed_t::layer_sizes[0]> indices;
+        usize num_plus, num_minus;
+        if (sparse_input(input, indices, num_plus, num_minus)) {
+            forward_sparse_simd(indices.data(), num_plus, indices.data() + indices.size() - num_minus, num_minus,
+                                buffers[1].data());
+        } else {
+            std::copy(input.begin(), input.end(), buffers[0].begin());
+            forward_tile_simd<0, 1>(buffers[0].data(), buffers[1].data());
+        }
+        std::copy_n(buffers[1].begin(), packed_t::layer_sizes[1], values[1].begin());
+
+        // the layer loop is unrolled at compile time so that every layer gets its own fixed-size kernel
+        [&]<usize... LAYERS>(std::index_sequence<LAYERS...>) {
+            ((forward_tile_simd<LAYERS + 1, 1>(buffers[(LAYERS + 1) % 2].data(), buffers[LAYERS % 2].data()),
+              std::copy_n(buffers[LAYERS % 2].begin(), packed_t::layer_sizes[LAYERS + 2], values[LAYERS + 2].begin())),
+             ...);
+        }(std::make_index_sequence<sizeof...(sizes) - 2>{});
+        return values.back();
+    }
+
+    // the first layer takes the sparse path if at most this part of the inputs is nonzero. the dense kernel catches up
+    // from 28 of 42 nonzero inputs on for 512 outputs, for the 35 of neural_net_player the sparse path is always faster
+    static constexpr f32 SPARSE_DENSITY = 2.f / 3.f;
+
+    /**
+     * board encodings are -1, 0 and 1 only. the indices of the 1s go to the front of indices and those of the -1s to
+     * the back, false if another value shows up or more than SPARSE_DENSITY of the inputs are nonzero
+     */
+    static bool sparse_input(std::span<T> input, std::array<u16, packed_weights<T, sizes...>::layer_sizes[0]> &indices,
+                             usize &num_plus, usize &num_minus) {
+        num_plus = num_minus = 0;
+        for (usize i = 0; i < indices.size(); ++i) {
+            if (input[i] == 1.0f)
+                indices[num_plus++] = static_cast<u16>(i);
+            else if (input[i] == -1.0f)
+                indices[indices.size() - ++num_minus] = static_cast<u16>(i);
+            else if (input[i] != 0.0f)
+                return false;
+        }
+        return static_cast<f32>(num_plus + num_minus) <= SPARSE_DENSITY * static_cast<f32>(indices.size());
+    }
+
+    /**
+     * output blocks [FIRST_BLOCK, ...) of the first layer for a sparse input, the weights of the inputs that are 1 are
+     * added to the biases and those of the inputs that are -1 subtracted, no multiplications and no zero inputs
+     */
+    template<usize FIRST_BLOCK = 0>
+    void forward_sparse_simd(u16 const *plus, usize num_plus, u16 const *minus, usize num_minus, f32 *out) const {
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr usize NUM_IN = packed_t::layer_sizes[0];
+        constexpr usize NUM_OUT = packed_t::layer_sizes[1];
+        constexpr usize NUM_BLOCKS = packed_t::padded(NUM_OUT) / packed_t::SIMD_WIDTH;
+        // the 1s and the -1s are summed separately, two independent chains of adds per block
+        constexpr usize GROUP_SIZE = std::min<usize>(NUM_BLOCKS - FIRST_BLOCK, 6);
+
+        f32 const *weights = packed().weights(0) + FIRST_BLOCK * NUM_IN * 8;
+        f32 const *biases = packed().biases(1) + FIRST_BLOCK * 8;
+        __m256 acc[GROUP_SIZE], neg[GROUP_SIZE];
+        for (usize k = 0; k < GROUP_SIZE; ++k) {
+            acc[k] = _mm256_load_ps(biases + k * 8);
+            neg[k] = _mm256_setzero_ps();
+        }
+        const usize num_both = std::min(num_plus, num_minus);
+        for (usize n = 0; n < num_both; ++n) {
+            for (usize k = 0; k < GROUP_SIZE; ++k) {
+                acc[k] = _mm256_add_ps(acc[k], _mm256_load_ps(weights + (k * NUM_IN + plus[n]) * 8));
+                neg[k] = _mm256_add_ps(neg[k], _mm256_load_ps(weights + (k * NUM_IN + minus[n]) * 8));
+            }
+        }
+        for (usize n = num_both; n < num_plus; ++n)
+            for (usize k = 0; k < GROUP_SIZE; ++k)
+                acc[k] = _mm256_add_ps(acc[k], _mm256_load_ps(weights + (k * NUM_IN + plus[n]) * 8));
+        for (usize n = num_both; n < num_minus; ++n)
+            for (usize k = 0; k < GROUP_SIZE; ++k)
+                neg[k] = _mm256_add_ps(neg[k], _mm256_load_ps(weights + (k * NUM_IN + minus[n]) * 8));
+        for (usize k = 0; k < GROUP_SIZE; ++k) {
+            acc[k] = _mm256_sub_ps(acc[k], neg[k]);
+            if constexpr (simd_activation<F1>)
+                acc[k] = m_activation_function(acc[k]);
+            _mm256_store_ps(out + (FIRST_BLOCK + k) * 8, acc[k]);
+        }
+
+        if constexpr (FIRST_BLOCK + GROUP_SIZE < NUM_BLOCKS) {
+            forward_sparse_simd<FIRST_BLOCK + GROUP_SIZE>(plus, num_plus, minus, num_minus, out);
+        } else if constexpr (!simd_activation<F1>) {
+            for (usize node = 0; node < NUM_OUT; ++node)
+                out[node] = m_activation_function(out[node]);
+        }
+    }
+
+    /**
+     * output blocks [FIRST_BLOCK, FIRST_BLOCK + NUM_BLOCKS) of one layer for TILE_SIZE consecutive positions on the
+     * packed weights, in and out hold one padded, 32 byte aligned row per position. every load of a weight vector is
+     * used for the whole tile
+     */
+    template<usize LAYER, usize TILE_SIZE, usize FIRST_BLOCK, usize NUM_BLOCKS>
+    void forward_blocks_simd(f32 const *in, f32 *out) const {
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr usize NUM_IN = packed_t::layer_sizes[LAYER];
+        constexpr usize IN_STRIDE = packed_t::padded(NUM_IN);
+        constexpr usize OUT_STRIDE = packed_t::padded(packed_t::layer_sizes[LAYER + 1]);
+
+        // with few accumulators the fma latency would dominate, so the inputs are split over independent partial sums
+        constexpr usize NUM_SPLITS = std::clamp<usize>(8 / (TILE_SIZE * NUM_BLOCKS), 1, 4);
+
+        f32 const *weights = packed().weights(LAYER) + FIRST_BLOCK * NUM_IN * 8;
+        f32 const *biases = packed().biases(LAYER + 1) + FIRST_BLOCK * 8;
+        __m256 acc[NUM_SPLITS][TILE_SIZE][NUM_BLOCKS];
+        for (usize t = 0; t < TILE_SIZE; ++t) {
+            for (usize k = 0; k < NUM_BLOCKS; ++k) {
+                acc[0][t][k] = _mm256_load_ps(biases + k * 8);
+                for (usize split = 1; split < NUM_SPLITS; ++split)
+                    acc[split][t][k] = _mm256_setzero_ps();
+            }
+        }
+
+        auto step = [&](usize i, __m256 (&partial)[TILE_SIZE][NUM_BLOCKS]) {
+            __m256 w[NUM_BLOCKS];
+            for (usize k = 0; k < NUM_BLOCKS; ++k)
+                w[k] = _mm256_load_ps(weights + (k * NUM_IN + i) * 8);
+            for (usize t = 0; t < TILE_SIZE; ++t) {
+                const __m256 x = _mm256_broadcast_ss(in + t * IN_STRIDE + i);
+                for (usize k = 0; k < NUM_BLOCKS; ++k)
+                    partial[t][k] = _mm256_fmadd_ps(w[k], x, partial[t][k]);
+            }
+        };
+        constexpr usize NUM_SPLIT_INPUTS = NUM_IN / NUM_SPLITS * NUM_SPLITS;
+#pragma GCC unroll 4
+        for (usize i = 0; i < NUM_SPLIT_INPUTS; i += NUM_SPLITS)
+            for (usize split = 0; split < NUM_SPLITS; ++split)
+                step(i + split, acc[split]);
+        if constexpr (NUM_SPLIT_INPUTS < NUM_IN)
+            for (usize i = NUM_SPLIT_INPUTS; i < NUM_IN; ++i)
+                step(i, acc[0]);
+
+        for (usize t = 0; t < TILE_SIZE; ++t) {
+            for (usize k = 0; k < NUM_BLOCKS; ++k) {
+                for (usize split = 1; split < NUM_SPLITS; ++split)
+                    acc[0][t][k] = _mm256_add_ps(acc[0][t][k], acc[split][t][k]);
+                if constexpr (simd_activation<F1>)
+                    acc[0][t][k] = m_activation_function(acc[0][t][k]);
+                _mm256_store_ps(out + t * OUT_STRIDE + (FIRST_BLOCK + k) * 8, acc[0][t][k]);
+            }
+        }
+    }
+
+    // one layer for TILE_SIZE positions, the output blocks are split into groups so that at most 12 accumulators are
+    // live and they stay in registers next to the weights and the broadcast input
+    template<usize LAYER, usize TILE_SIZE, usize FIRST_BLOCK = 0>
+    void forward_tile_simd(f32 const *in, f32 *out) const {
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr usize NUM_OUT = packed_t::layer_sizes[LAYER + 1];
+        constexpr usize OUT_STRIDE = packed_t::padded(NUM_OUT);
+        constexpr usize NUM_BLOCKS = OUT_STRIDE / packed_t::SIMD_WIDTH;
+        constexpr usize GROUP_SIZE = std::min<usize>(NUM_BLOCKS - FIRST_BLOCK, std::max<usize>(12 / TILE_SIZE, 1));
+
+        forward_blocks_simd<LAYER, TILE_SIZE, FIRST_BLOCK, GROUP_SIZE>(in, out);
+        if constexpr (FIRST_BLOCK + GROUP_SIZE < NUM_BLOCKS) {
+            forward_tile_simd<LAYER, TILE_SIZE, FIRST_BLOCK + GROUP_SIZE>(in, out);
+        } else if constexpr (!simd_activation<F1>) {
+            for (usize t = 0; t < TILE_SIZE; ++t)
+                for (usize node = 0; node < NUM_OUT; ++node)
+                    out[t * OUT_STRIDE + node] = m_activation_function(out[t * OUT_STRIDE + node]);
+        }
+    }
+
+    // one layer for num_positions positions as a matrix-matrix product, the positions that don't fill a tile run alone
+    template<usize LAYER>
+    void forward_layer_batch_simd(f32 const *in, f32 *out, usize num_positions) const {
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr usize IN_STRIDE = packed_t::padded(packed_t::layer_sizes[LAYER]);
+        constexpr usize OUT_STRIDE = packed_t::padded(packed_t::layer_sizes[LAYER + 1]);
+        // narrow layers get more positions per tile, 12 accumulators either way
+        constexpr usize TILE_SIZE = 12 / std::min<usize>(OUT_STRIDE / packed_t::SIMD_WIDTH, 4);
+        usize pos = 0;
+        for (; pos + TILE_SIZE <= num_positions; pos += TILE_SIZE)
+            forward_tile_simd<LAYER, TILE_SIZE>(in + pos * IN_STRIDE, out + pos * OUT_STRIDE);
+        for (; pos < num_positions; ++pos)
+            forward_tile_simd<LAYER, 1>(in + pos * IN_STRIDE, out + pos * OUT_STRIDE);
+    }
+#endif
+
+    // positions are evaluated in chunks of this size so that the activations of a chunk stay in cache between layers
+    static constexpr usize BATCH_BLOCK_SIZE = 48;
+
+    /**
+     * evaluates n positions at once, inputs holds n rows of input layer size and outputs gets n rows of output layer
+     * size. every layer is run as a matrix-matrix product over a chunk of positions, the workspace is kept between
+     * calls
+     */
+    void evaluate_batch(std::span<const T> inputs, usize n, std::span<T> outputs) const {
+        constexpr usize NUM_INPUTS = std::array{sizes...}.front();
+        assert(inputs.size() >= n * NUM_INPUTS && outputs.size() >= n * NUM_OUTPUTS);
+
+#if defined(__AVX2__) && defined(__FMA__)
+        if constexpr (std::is_same_v<T, f32>) {
+            using packed_t = packed_weights<T, sizes...>;
+            struct alignas(64) cache_line {
+                f32 m_data[16];
+            };
+            constexpr usize BUFFER_LINES = (BATCH_BLOCK_SIZE * packed_t::MAX_PADDED_SIZE + 15) / 16;
+            thread_local std::vector<cache_line> workspace(2 * BUFFER_LINES);
+            f32 *buffers[2] = {workspace[0].m_data, workspace[BUFFER_LINES].m_data};
+
+            for (usize first = 0; first < n; first += BATCH_BLOCK_SIZE) {
+                const usize num_positions = std::min(BATCH_BLOCK_SIZE, n - first);
+                constexpr usize IN_STRIDE = packed_t::padded(NUM_INPUTS);
+                for (usize row = 0; row < num_positions; ++row)
+                    std::copy_n(inputs.begin() + static_cast<isize>((first + row) * NUM_INPUTS), NUM_INPUTS,
+                                buffers[0] + row * IN_STRIDE);
+
+                [&]<usize... LAYERS>(std::index_sequence<LAYERS...>) {
+                    (forward_layer_batch_simd<LAYERS>(buffers[LAYERS % 2], buffers[(LAYERS + 1) % 2], num_positions),
+                     ...);
+                }(std::make_index_sequence<sizeof...(sizes) - 1>{});
+
+                constexpr usize OUT_STRIDE = packed_t::padded(NUM_OUTPUTS);
+                f32 const *result = buffers[(sizeof...(sizes) - 1) % 2];
+                for (usize row = 0; row < num_positions; ++row)
+                    std::copy_n(result + row * OUT_STRIDE, NUM_OUTPUTS,
+                                outputs.begin() + static_cast<isize>((first + row) * NUM_OUTPUTS));
+            }
+            return;
+        }
+#endif
+        thread_local std::array<T, NUM_INPUTS> input;
+        thread_local layer_array<T, sizes...> values;
+        for (usize i = 0; i < n; ++i) {
+            std::copy_n(inputs.begin() + static_cast<isize>(i * NUM_INPUTS), NUM_INPUTS, input.begin());
+            std::span<T> output = forward_propagate(input, values);
+            std::copy(output.begin(), output.end(), outputs.begin() + static_cast<isize>(i * NUM_OUTPUTS));
+        }
+    }
+
+    [[nodiscard]] std::span<T> forward_propagate_scalar(std::span<T> input, layer_array<T, sizes...> &values) const {
         std::span<T> input_layer{values.front()}, output_layer{values.back()};
         std::copy(input.begin(), input.end(), input_layer.begin());
         for (usize layer = 1; layer < values.size(); ++layer) {
@@ -223,74 +509,183 @@ struct neural_net {
         return output_layer;
     }
 
-    [[nodiscard]] constexpr derivative_pair_t backward_propagate(layer_array<T, sizes...> const &node_values,
-                                                                 std::span<T> correct_output,
-                                                                 bool post_activation_variables) const {
-        // result variables
-        std::unique_ptr<weight_array<T, sizes...>> weight_derivatives = std::make_unique<weight_array<T, sizes...>>();
-        std::unique_ptr<layer_array<T, sizes...>> bias_derivatives = std::make_unique<layer_array<T, sizes...>>();
-
-        const std::span output{node_values.back()};
+    /**
+     * adds the gradients of the squared error 0.5 * |output - correct_output|^2 of one sample to weight_gradients and
+     * bias_gradients. node_values have to come from forward_propagate on that sample, m_activation_derivative gets the
+     * activated value of a node. deltas is scratch space
+     */
+    void accumulate_gradients(layer_array<T, sizes...> const &node_values, std::span<const T> correct_output,
+                              layer_array<T, sizes...> &deltas, weight_array<T, sizes...> &weight_gradients,
+                              layer_array<T, sizes...> &bias_gradients) const {
         const usize num_layers = size();
-
-        // process last layer
-        for (usize node = 0; node < output.size(); ++node) {
-            bias_derivatives.back()[node] =
-                    m_activation_derivative(output[node]) * (output[node] - correct_output[node]);
-        }
-
-        // process all layers between last and first layer (exclusive)
-        for (usize layer = num_layers - 2; layer > 0; --layer) {
-            for (usize node = 0; node < node_values[layer].size(); ++node) {
+        const auto output = node_values.back();
+        for (usize node = 0; node < output.size(); ++node)
+            deltas.back()[node] = m_activation_derivative(output[node]) * (output[node] - correct_output[node]);
+
+        for (usize layer = num_layers - 1; layer > 0; --layer) {
+            const auto delta = deltas[layer];
+            const auto prev_values = node_values[layer - 1];
+            auto bias_gradient = bias_gradients[layer];
+            for (usize node = 0; node < delta.size(); ++node)
+                bias_gradient[node] += delta[node];
+
+            auto weight_gradient = weight_gradients[layer - 1];
+            auto const weights = m_weights[layer - 1];
+            for (usize prev_node = 0; prev_node < prev_values.size(); ++prev_node) {
+                auto gradient_row = weight_gradient[prev_node];
+                auto const weight_row = weights[prev_node];
+                const T value = prev_values[prev_node];
                 T sum = 0;
-                for (usize next_node = 0; next_node < node_values[layer + 1].size(); ++next_node) {
-                    const T weight_derivative = node_values[layer][node] * bias_derivatives[layer + 1][next_node];
-                    sum += weight_derivative;
-                    weight_derivatives[layer][node][next_node] = weight_derivative;
+                for (usize node = 0; node < delta.size(); ++node) {
+                    gradient_row[node] += value * delta[node];
+                    sum += weight_row[node] * delta[node];
                 }
-                const T bias_derivative = m_activation_derivative(node_values[layer][node]) * sum;
-                bias_derivative[layer][node] = bias_derivative;
+                // the input layer has no activation and needs no delta
+                if (layer > 1) deltas[layer - 1][prev_node] = m_activation_derivative(value) * sum;
             }
         }
+    }
+
+    // the gradients of one sample in workspace.m_weight_gradients and workspace.m_bias_gradients, see accumulate_gradients
+    void backward_propagate(layer_array<T, sizes...> const &node_values, std::span<const T> correct_output,
+                            gradient_workspace &workspace) const {
+        workspace.m_weight_gradients.fill(0);
+        workspace.m_bias_gradients.fill(0);
+        accumulate_gradients(node_values, correct_output, workspace.m_deltas, workspace.m_weight_gradients,
+                             workspace.m_bias_gradients);
+    }
+
+    // one gradient descent step on the gradients of a workspace
+    void apply_gradients(gradient_workspace const &workspace, T learning_rate) {
+        for (usize i = 0; i < m_weights.m_data.size(); ++i)
+            m_weights.m_data[i] -= workspace.m_weight_gradients.m_data[i] * learning_rate;
+        for (usize i = 0; i < m_biases.m_data.size(); ++i)
+            m_biases.m_data[i] -= workspace.m_bias_gradients.m_data[i] * learning_rate;
+        pack();
+    }
 
-        // process first layer
-        for (usize node = 0; node < node_values[0].size(); ++node) {
-            for (usize next_node = 0; next_node < node_values[1].size(); ++next_node) {
-                const T weight_derivative = node_values[0][node] * bias_derivatives[1][next_node];
-                weight_derivatives[0][node][next_node] = weight_derivative;
+    /**
+     * one gradient descent step on the squared error of one sample without any gradient buffer: every weight is read
+     * for the delta of the previous layer and updated in the same loop, and the packed copy is updated along with it.
+     * node_values have to come from forward_propagate on that sample
+     */
+    void sgd_step(layer_array<T, sizes...> const &node_values, std::span<const T> correct_output, T learning_rate) {
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr usize W = packed_t::SIMD_WIDTH;
+        if (m_mapped_packed) pack();
+
+        layer_array<T, sizes...> deltas;
+        const auto output = node_values.back();
+        for (usize node = 0; node < output.size(); ++node)
+            deltas.back()[node] = m_activation_derivative(output[node]) * (output[node] - correct_output[node]);
+
+        for (usize layer = size() - 1; layer > 0; --layer) {
+            const auto delta = deltas[layer];
+            const auto prev_values = node_values[layer - 1];
+            auto biases = m_biases[layer];
+            T *packed_biases = m_packed.m_biases.data() + packed_t::bias_offsets[layer];
+            for (usize node = 0; node < delta.size(); ++node) {
+                biases[node] -= learning_rate * delta[node];
+                packed_biases[node] = biases[node];
+            }
+
+            auto weights = m_weights[layer - 1];
+            T *packed = m_packed.m_weights.data() + packed_t::weight_offsets[layer - 1];
+            const usize num_in = prev_values.size();
+            for (usize prev_node = 0; prev_node < num_in; ++prev_node) {
+                auto weight_row = weights[prev_node];
+                const T value = prev_values[prev_node];
+                const T step = learning_rate * value;
+                // one partial sum per lane so that the loop over a block vectorizes
+                std::array<T, W> sums{};
+                for (usize first = 0; first < delta.size(); first += W) {
+                    // the weights of one input for W consecutive outputs are consecutive in the packed copy too
+                    T *packed_row = packed + ((first / W) * num_in + prev_node) * W;
+                    const usize count = std::min(W, delta.size() - first);
+                    for (usize lane = 0; lane < count; ++lane) {
+                        T &w = weight_row[first + lane];
+                        sums[lane] += w * delta[first + lane];
+                        w -= step * delta[first + lane];
+                        packed_row[lane] = w;
+                    }
+                }
+                if (layer > 1)
+                    deltas[layer - 1][prev_node] =
+                            m_activation_derivative(value) * std::accumulate(sums.begin(), sums.end(), T{0});
             }
         }
+    }
 
-        return {weight_derivatives, bias_derivatives};
+    [[deprecated("allocates, use backward_propagate with a gradient_workspace")]] derivative_pair_t
+    backward_propagate(layer_array<T, sizes...> const &node_values, std::span<T> correct_output,
+                       [[maybe_unused]] bool post_activation_variables) const {
+        auto weight_derivatives = std::make_unique<weight_array<T, sizes...>>();
+        auto bias_derivatives = std::make_unique<layer_array<T, sizes...>>();
+        layer_array<T, sizes...> deltas;
+        accumulate_gradients(node_values, correct_output, deltas, *weight_derivatives, *bias_derivatives);
+        return {std::move(weight_derivatives), std::move(bias_derivatives)};
     }
 
-    [[nodiscard]] constexpr derivative_pair_t compute_derivatives(std::span<T> correct_output,
-                                                                  bool post_activation_variables) {
+    [[deprecated("allocates, use backward_propagate with a gradient_workspace")]] derivative_pair_t
+    compute_derivatives(std::span<T> correct_output, bool post_activation_variables) {
         return backward_propagate(m_values, correct_output, post_activation_variables);
     }
 
-    void apply_derivatives(derivative_pair_t const &derivatives, T learning_rate) {
+    // one gradient descent step
+    [[deprecated("use apply_gradients or sgd_step")]] void apply_derivatives(derivative_pair_t const &derivatives,
+                                                                             T learning_rate) {
         auto &[weight_derivatives, bias_derivatives] = derivatives;
-        for (usize i = 0; i < weight_derivatives.size(); ++i) {
-            m_weights.data()[i] += weight_derivatives->data()[i] * learning_rate;
-        }
-        for (usize i = 0; i < bias_derivatives.size(); ++i) {
-            m_biases.data()[i] += bias_derivatives->data[i] * learning_rate;
-        }
+        for (usize i = 0; i < m_weights.m_data.size(); ++i)
+            m_weights.m_data[i] -= weight_derivatives->m_data[i] * learning_rate;
+        for (usize i = 0; i < m_biases.m_data.size(); ++i)
+            m_biases.m_data[i] -= bias_derivatives->m_data[i] * learning_rate;
+        pack();
     }
 
     [[nodiscard]] std::span<T> evaluate(std::span<T> inp) {
         return forward_propagate(inp, m_values);
     }
 
-    [[nodiscard]] std::array<T, (sizes, ...)> evaluate_const(std::span<T> inp) const {
-        layer_array<T, sizes...> values;
-        std::span<T> output = forward_propagate(inp, values);
-        std::array<T, (sizes, ...)> out_arr{};
-        std::copy(output.begin(), output.end(), out_arr.begin());
+    // size of the output layer
+    static constexpr usize NUM_OUTPUTS = std::array{sizes...}.back();
+
+    [[nodiscard]] std::array<T, NUM_OUTPUTS> evaluate_const(std::span<T> inp) const {
+        std::array<T, NUM_OUTPUTS> out_arr{};
+        evaluate_batch(inp, 1, out_arr);
         return out_arr;
     }
 
+    /**
+     * runs the net from the activations of the first hidden layer on, for callers that keep the first layer up to date
+     * themselves (see first_layer_accumulator)
+     */
+    void evaluate_from_first_hidden(std::span<const T> hidden, std::span<T> outputs) const {
+        static_assert(sizeof...(sizes) >= 3);
+#if defined(__AVX2__) && defined(__FMA__)
+        if constexpr (std::is_same_v<T, f32>) {
+            using packed_t = packed_weights<T, sizes...>;
+            alignas(64) std::array<f32, packed_t::MAX_PADDED_SIZE> buffers[2];
+            std::copy(hidden.begin(), hidden.end(), buffers[1].begin());
+            [&]<usize... LAYERS>(std::index_sequence<LAYERS...>) {
+                (forward_tile_simd<LAYERS + 1, 1>(buffers[(LAYERS + 1) % 2].data(), buffers[LAYERS % 2].data()), ...);
+            }(std::make_index_sequence<sizeof...(sizes) - 2>{});
+            std::copy_n(buffers[(sizeof...(sizes) - 1) % 2].begin(), NUM_OUTPUTS, outputs.begin());
+            return;
+        }
+#endif
+        layer_array<T, sizes...> values;
+        std::copy(hidden.begin(), hidden.end(), values[1].begin());
+        for (usize layer = 2; layer < values.size(); ++layer) {
+            for (usize node = 0; node < values[layer].size(); ++node) {
+                T sum = m_biases[layer][node];
+                for (usize prev_node = 0; prev_node < values[layer - 1].size(); ++prev_node)
+                    sum += m_weights[layer - 1][prev_node][node] * values[layer - 1][prev_node];
+                values[layer][node] = m_activation_function(sum);
+            }
+        }
+        std::copy(values.back().begin(), values.back().end(), outputs.begin());
+    }
+
     constexpr void swap(neural_net const &x) {
         *this = x;
     }
@@ -323,6 +718,83 @@ struct neural_net {
             iss >> i;
         for (auto &i: m_biases.m_data)
             iss >> i;
+        pack();
+    }
+
+    // writes the binary format of neural_net_file_header
+    void save(std::string const &path) const {
+        using header_t = neural_net_file_header;
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr std::array<u32, sizeof...(sizes)> layer_sizes{static_cast<u32>(sizes)...};
+
+        header_t header;
+        header.m_dtype = header_t::dtype_of<T>();
+        header.m_num_layers = sizeof...(sizes);
+        header.m_packed_width = packed_t::SIMD_WIDTH;
+        header.m_weights_offset = header_t::aligned(sizeof(header) + sizeof(layer_sizes));
+        header.m_weights_size = sizeof(m_weights.m_data);
+        header.m_biases_offset = header_t::aligned(header.m_weights_offset + header.m_weights_size);
+        header.m_biases_size = sizeof(m_biases.m_data);
+        header.m_packed_offset = header_t::aligned(header.m_biases_offset + header.m_biases_size);
+        header.m_packed_size = sizeof(packed_t);
+
+        std::vector<std::byte> file(header.m_packed_offset + header.m_packed_size);
+        std::memcpy(file.data() + sizeof(header), layer_sizes.data(), sizeof(layer_sizes));
+        std::memcpy(file.data() + header.m_weights_offset, m_weights.m_data.data(), header.m_weights_size);
+        std::memcpy(file.data() + header.m_biases_offset, m_biases.m_data.data(), header.m_biases_size);
+        std::memcpy(file.data() + header.m_packed_offset, &packed(), header.m_packed_size);
+        header.m_checksum = util::word_fnv_hash(std::span{file}.subspan(sizeof(header)));
+        std::memcpy(file.data(), &header, sizeof(header));
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<char const *>(file.data()), static_cast<std::streamsize>(file.size()));
+        if (!out)
+            throw std::runtime_error("can't write " + path);
+    }
+
+    /**
+     * reads a file written by save. only the packed inference weights are zero-copy: they are used straight from a
+     * shared mapping of the file if their layout matches this build, otherwise they are packed again. m_weights and
+     * m_biases are arrays inside the net and always get a copy of their sections, so every loaded net still holds its
+     * own raw weights and the mapping only saves the memory and the packing of the packed copy
+     * @return whether the mapped packed weights are used
+     */
+    bool load(std::string const &path, bool verify_checksum = true) {
+        using header_t = neural_net_file_header;
+        using packed_t = packed_weights<T, sizes...>;
+        constexpr std::array<u32, sizeof...(sizes)> layer_sizes{static_cast<u32>(sizes)...};
+
+        auto file = std::make_shared<const util::mapped_file>(path);
+        const std::span<const std::byte> bytes = file->bytes();
+        header_t header;
+        if (bytes.size() < sizeof(header) + sizeof(layer_sizes))
+            throw std::runtime_error(path + " is too small for a neural net");
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (header.m_magic != header_t::MAGIC)
+            throw std::runtime_error(path + " is not a neural net");
+        if (header.m_version != header_t::VERSION)
+            throw std::runtime_error(path + " has unsupported version " + std::to_string(header.m_version));
+        if (header.m_dtype != header_t::dtype_of<T>() || header.m_num_layers != layer_sizes.size() ||
+            std::memcmp(bytes.data() + sizeof(header), layer_sizes.data(), sizeof(layer_sizes)) != 0 ||
+            header.m_weights_size != sizeof(m_weights.m_data) || header.m_biases_size != sizeof(m_biases.m_data))
+            throw std::runtime_error(path + " has a different layout than this neural net");
+        if (std::max({header.m_weights_offset + header.m_weights_size, header.m_biases_offset + header.m_biases_size,
+                      header.m_packed_offset + header.m_packed_size}) > bytes.size())
+            throw std::runtime_error(path + " is truncated");
+        if (verify_checksum && util::word_fnv_hash(bytes.subspan(sizeof(header))) != header.m_checksum)
+            throw std::runtime_error(path + " is corrupted");
+
+        std::memcpy(m_weights.m_data.data(), bytes.data() + header.m_weights_offset, header.m_weights_size);
+        std::memcpy(m_biases.m_data.data(), bytes.data() + header.m_biases_offset, header.m_biases_size);
+        std::byte const *packed_data = bytes.data() + header.m_packed_offset;
+        if (header.m_packed_width != packed_t::SIMD_WIDTH || header.m_packed_size != sizeof(packed_t) ||
+            reinterpret_cast<std::uintptr_t>(packed_data) % alignof(packed_t)) {
+            pack();
+            return false;
+        }
+        // the mapping lives as long as any net that uses it
+        m_mapped_packed = std::shared_ptr<const packed_t>(file, reinterpret_cast<packed_t const *>(packed_data));
+        return true;
     }
 };
 } // namespace gya
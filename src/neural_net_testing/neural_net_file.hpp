@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../include.hpp"
+#include "../binary_file.hpp"
+
+namespace gya {
+
+/**
+ * binary file of a neural_net, written by neural_net::save and read by neural_net::load:
+ *  header, layer sizes, then the raw weights, the raw biases and the packed inference weights, every section starts at
+ *  a multiple of ALIGNMENT so that the packed weights can be used straight from a mapping of the file.
+ * all numbers are stored in the byte order of the machine that wrote the file
+ */
+struct neural_net_file_header {
+    static constexpr std::array<char, 8> MAGIC{'g', 'y', 'a', 'n', 'n', 'e', 't', '\0'};
+    static constexpr u32 VERSION = 1;
+    static constexpr u32 ALIGNMENT = 64;
+
+    enum class dtype : u32 {
+        F32,
+        F64,
+    };
+
+    std::array<char, 8> m_magic = MAGIC;
+    u32 m_version = VERSION;
+    dtype m_dtype = dtype::F32;
+    u32 m_alignment = ALIGNMENT;
+    u32 m_num_layers = 0;
+    // elements per simd register of the packed weights, they can only be mapped if it matches
+    u32 m_packed_width = 0;
+    u32 m_reserved = 0;
+    u64 m_weights_offset = 0;
+    u64 m_weights_size = 0;
+    u64 m_biases_offset = 0;
+    u64 m_biases_size = 0;
+    u64 m_packed_offset = 0;
+    u64 m_packed_size = 0;
+    // of everything after the header
+    u64 m_checksum = 0;
+
+    template<class T>
+    static constexpr dtype dtype_of() {
+        static_assert(std::is_same_v<T, f32> || std::is_same_v<T, f64>, "only f32 and f64 nets can be saved");
+        return std::is_same_v<T, f32> ? dtype::F32 : dtype::F64;
+    }
+
+    static constexpr u64 aligned(u64 offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+};
+
+} // namespace gya
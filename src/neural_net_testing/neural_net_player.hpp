@@ -5,14 +5,24 @@
 #include "neural_net.hpp"
 
 namespace gya {
-constexpr static auto fast_activation_function = [](f32 x) {
-    return std::clamp(x * 0.2f + 0.5f, 0.0f, 1.0f);
+struct fast_activation {
+    constexpr f32 operator()(f32 x) const {
+        return std::clamp(x * 0.2f + 0.5f, 0.0f, 1.0f);
+    }
+
+#ifdef __AVX__
+    __m256 operator()(__m256 x) const {
+        x = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.2f)), _mm256_set1_ps(0.5f));
+        return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    }
+#endif
 };
 
-constexpr static auto fast_activation_derivative = [](f32 x) {
-    if (x < 2.5f) return 0.0f;
-    if (x > 2.5f) return 0.0f;
-    return 0.2f;
+constexpr static fast_activation fast_activation_function{};
+
+// takes the activated value like every derivative used by neural_net
+constexpr static auto fast_activation_derivative = [](f32 y) {
+    return y > 0.0f && y < 1.0f ? 0.2f : 0.0f;
 };
 
 constexpr static auto tanh_activation_function = [](f32 x) {
@@ -55,16 +65,22 @@ struct neural_net_player {
         return m_net.m_weights.m_data.size() + m_net.m_biases.m_data.size();
     }
 
-    [[nodiscard]] u8 operator()(gya::board const &b) {
-        if (std::all_of(b.data.begin(), b.data.end(), [](auto &x) { return x.height == 6; }))
-            throw std::runtime_error("board is full");
-
+    // +1 for stones of the player to move, -1 for the opponent's
+    [[nodiscard]] static std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT> encode(gya::board const &b) {
         std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT> input{};
         for (usize i = 0; i < gya::BOARD_HEIGHT; ++i) {
             for (usize j = 0; j < gya::BOARD_WIDTH; ++j) {
                 input[i * gya::BOARD_WIDTH + j] = b.data[i][j] * b.turn();
             }
         }
+        return input;
+    }
+
+    [[nodiscard]] u8 operator()(gya::board const &b) {
+        if (std::all_of(b.data.begin(), b.data.end(), [](auto &x) { return x.height == 6; }))
+            throw std::runtime_error("board is full");
+
+        auto input = encode(b);
         const auto net_output = m_net.evaluate_const(input);
         u8 ans = 0;
         for (u8 i = 0; i < 7; ++i)
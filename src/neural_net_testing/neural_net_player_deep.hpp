@@ -30,91 +30,89 @@ struct neural_net_player_deep {
     move_neural_net_t m_move_net;
     state_neural_net_t m_state_net;
 
+    using input_t = std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT>;
+
     struct move_state {
-        gya::board board;
-        u8 played_move;
+        input_t input;
+        u8 move;
     };
 
     std::vector<move_state> m_prev_states;
 
-    neural_net_player_deep() : m_move_net{F1{}, F2{}} { m_move_net.update_randomly(0.5); }
+    neural_net_player_deep() : m_move_net{F1{}, F2{}}, m_state_net{F1{}, F2{}} {
+        m_move_net.update_randomly(0.5);
+        m_state_net.update_randomly(0.5);
+    }
 
-    neural_net_player_deep(F1 f, F2 derivative) : m_move_net{f, derivative} { m_move_net.update_randomly(0.5); }
+    neural_net_player_deep(F1 f, F2 derivative) : m_move_net{f, derivative}, m_state_net{f, derivative} {
+        m_move_net.update_randomly(0.5);
+        m_state_net.update_randomly(0.5);
+    }
 
     auto &operator=(neural_net_player_deep const &other) {
         m_move_net = other.m_move_net;
+        m_state_net = other.m_state_net;
         return *this;
     }
 
     [[nodiscard]] usize size() const {
-        return m_move_net.m_weights.data.size() + m_move_net.m_biases.data.size();
+        return m_move_net.m_weights.m_data.size() + m_move_net.m_biases.m_data.size();
     }
 
-    // do the Q-learning stuff
+    // do the Q-learning stuff, one gradient step per stored position from the last one backwards
     void learn(bool won, bool lost) {
+        if (m_prev_states.empty()) return;
+
         // reward for last state
-        f32 reward = won - lost;
+        const f32 reward = static_cast<f32>(won) - static_cast<f32>(lost);
 
         constexpr f32 learning_rate = 0.01f, discount_factor = 0.9f;
 
-        // temporal difference for last move
-        const auto last_board = m_prev_states.back().board;
-        const auto last_outp = m_move_net.evaluate(last_board);
-        const auto last_move = m_prev_states.back().move;
-
-        const f32 old_last_q = m_state_net.evaluate(last_board);
-        const f32 last_q = old_last_q + learning_rate * (reward - old_last_q);
-
-        std::array<f32, gya::BOARD_WIDTH> correct_last_output = last_outp.back();
-        correct_last_output[last_move] += last_q;
-
-        m_move_net.apply_derivatives(m_move_net.compute_derivatives(correct_last_output));
-
-        f32 next_q_value = last_q;
-
-        //  go through all layers except the last one
-        for (usize i = m_prev_states.size() - 1; i-- > 0;) {
-            std::array move_output = m_move_net.evaluate(m_prev_states[i].board);
-            const f32 state_output = m_state_net.evaluate(m_prev_states[i].board);
-            const f32 q_state = state_output + learning_rate * (discount_factor * next_q_value - state_output);
-            const f32 q_move = move_output + learning_rate * (discount_factor * next_q_value - move_output);
+        f32 next_q_value = reward;
+        for (usize i = m_prev_states.size(); i-- > 0;) {
+            auto &[input, move] = m_prev_states[i];
+            const f32 target = i + 1 == m_prev_states.size() ? reward : discount_factor * next_q_value;
 
-            const std::array<f32, 1> temp{q_state};
-            m_state_net.apply_derivatives(m_state_net.compute_derivatives(temp, false));
+            const f32 state_output = m_state_net.evaluate(input)[0];
+            std::array<f32, 1> state_target{target};
+            m_state_net.sgd_step(m_state_net.m_values, state_target, learning_rate);
 
-            move_output[m_prev_states[i].move] = q_move;
-            m_move_net.apply_derivatives(m_move_net.compute_derivatives(move_output, false));
+            const auto move_output = m_move_net.evaluate(input);
+            std::array<f32, gya::BOARD_WIDTH> move_target;
+            std::copy(move_output.begin(), move_output.end(), move_target.begin());
+            move_target[move] = target;
+            m_move_net.sgd_step(m_move_net.m_values, move_target, learning_rate);
 
             next_q_value = state_output;
         }
+        m_prev_states.clear();
     }
 
     [[nodiscard]] u8 operator()(gya::board const &b) {
         if (std::all_of(b.data.begin(), b.data.end(), [](auto &x) { return x.height == gya::BOARD_HEIGHT; }))
             throw std::runtime_error("board is full");
 
-        std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT> input{};
+        input_t input{};
         for (usize i = 0; i < gya::BOARD_HEIGHT; ++i) {
             for (usize j = 0; j < gya::BOARD_WIDTH; ++j) {
                 input[gya::BOARD_WIDTH * i + j] = static_cast<f32>(b[i][j] * b.turn());
             }
         }
 
-        auto net_output = m_move_net.evaluate(input);
+        const auto net_output = m_move_net.evaluate_const(input);
 
         u8 ans = 0;
         f32 ans_val = -std::numeric_limits<f32>::max();
         for (u8 i = 0; i < gya::BOARD_WIDTH; ++i) {
             if (b[i].height == gya::BOARD_HEIGHT) continue;
-            f32 val = net_output[gya::BOARD_WIDTH * i + b[i].height];
-            if (val > ans_val || b[ans].height == gya::BOARD_HEIGHT) {
+            if (net_output[i] > ans_val) {
                 ans = i;
-                ans_val = val;
+                ans_val = net_output[i];
             }
         }
 
         // store all previous states of the network for Q-learning
-        m_prev_states.emplace_back(m_move_net.m_values, ans);
+        m_prev_states.push_back({input, ans});
 
         return ans;
     }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../include.hpp"
+#include "layer_array.hpp"
+#include "weight_array.hpp"
+
+namespace gya {
+
+/**
+ * inference copy of the weights and biases of a neural_net. the weights of every layer are stored output-major in
+ * blocks of SIMD_WIDTH outputs, block[input][lane], so that a single aligned load gives the weights of one input for
+ * SIMD_WIDTH consecutive outputs and a block is read front to back. the number of outputs is padded to a multiple of
+ * SIMD_WIDTH with zero weights and biases
+ */
+template<class T, usize... sizes>
+struct packed_weights {
+    static constexpr usize SIMD_WIDTH = 32 / sizeof(T);
+
+    static constexpr usize padded(usize n) {
+        return (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    }
+
+    static constexpr auto layer_sizes = std::array{sizes...};
+
+    // offset of the weights leading into layer i + 1
+    static constexpr auto weight_offsets = [] {
+        std::array<usize, sizeof...(sizes)> arr{};
+        for (usize i = 0, sum = 0; i < arr.size(); ++i) {
+            arr[i] = sum;
+            if (i + 1 < arr.size()) sum += layer_sizes[i] * padded(layer_sizes[i + 1]);
+        }
+        return arr;
+    }();
+
+    static constexpr auto bias_offsets = [] {
+        std::array<usize, sizeof...(sizes) + 1> arr{};
+        for (usize i = 0, sum = 0; i < arr.size(); ++i) {
+            arr[i] = sum;
+            if (i < sizeof...(sizes)) sum += padded(layer_sizes[i]);
+        }
+        return arr;
+    }();
+
+    static constexpr usize MAX_PADDED_SIZE = padded(std::max({sizes...}));
+
+    alignas(64) std::array<T, weight_offsets.back()> m_weights{};
+    alignas(64) std::array<T, bias_offsets.back()> m_biases{};
+
+    // weights leading into layer + 1
+    [[nodiscard]] T const *weights(usize layer) const {
+        return m_weights.data() + weight_offsets[layer];
+    }
+
+    [[nodiscard]] T const *biases(usize layer) const {
+        return m_biases.data() + bias_offsets[layer];
+    }
+
+    void pack(weight_array<T, sizes...> const &weights, layer_array<T, sizes...> const &biases) {
+        for (usize layer = 0; layer + 1 < layer_sizes.size(); ++layer) {
+            const usize num_in = layer_sizes[layer], num_out = layer_sizes[layer + 1];
+            T *dst = m_weights.data() + weight_offsets[layer];
+            for (usize out = 0; out < padded(num_out); ++out) {
+                const usize block = out / SIMD_WIDTH, lane = out % SIMD_WIDTH;
+                for (usize in = 0; in < num_in; ++in)
+                    dst[(block * num_in + in) * SIMD_WIDTH + lane] = out < num_out ? weights[layer][in][out] : T{};
+            }
+        }
+        for (usize layer = 0; layer < layer_sizes.size(); ++layer) {
+            T *dst = m_biases.data() + bias_offsets[layer];
+            for (usize node = 0; node < padded(layer_sizes[layer]); ++node)
+                dst[node] = node < layer_sizes[layer] ? biases[layer][node] : T{};
+        }
+    }
+};
+
+} // namespace gya
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "../board.hpp"
+#include "../include.hpp"
+#include "neural_net_player.hpp"
+
+namespace gya {
+
+/**
+ * population of neural_net_players for evolutionary training. the weights and biases of all players are kept in one
+ * contiguous store with one cache line aligned row per player, so selection copies whole rows and mutation is a branch
+ * free loop over a row. the games of a generation are spread over the omp threads, every game and every mutation gets
+ * its own rng seeded from the population seed, the generation and its index, so the results don't depend on the
+ * number of threads
+ */
+template<class PLAYER = neural_net_player<>>
+class population {
+public:
+    using player_t = PLAYER;
+
+    struct generation_stats {
+        usize m_num_games = 0;
+        f64 m_seconds = 0;
+        i32 m_best_score = 0;
+
+        [[nodiscard]] f64 games_per_second() const {
+            return static_cast<f64>(m_num_games) / m_seconds;
+        }
+    };
+
+    // results of the players against a fixed opponent, summed over the population
+    struct match_stats {
+        usize m_num_games = 0;
+        f64 m_seconds = 0;
+        std::array<usize, 2> m_wins{}, m_ties{}, m_losses{}; // index 0 when the population moves first
+
+        [[nodiscard]] f64 games_per_second() const {
+            return static_cast<f64>(m_num_games) / m_seconds;
+        }
+    };
+
+private:
+    struct alignas(64) cache_line {
+        f32 m_data[16];
+    };
+
+    usize m_size;
+    usize m_num_weights;
+    usize m_num_biases;
+    usize m_row_lines;
+    u64 m_seed;
+    u64 m_generation = 0;
+    // current and next generation, swapped by evolve
+    std::vector<cache_line> m_params, m_next_params;
+    // nets of the rows, rebuilt after every change of the store
+    std::vector<player_t> m_players;
+
+    // lowbias32, a counter based rng that vectorizes
+    static constexpr u32 hash(u32 x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    [[nodiscard]] u64 seed_of(u64 stream, u64 index) const {
+        // splitmix64 of the population seed, the generation and the index within the generation
+        u64 z = m_seed + 0x9e3779b97f4a7c15ull * (m_generation * 0x100000001b3ull + stream * 0x10000ull + index + 1);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    [[nodiscard]] f32 *row(std::vector<cache_line> &params, usize player) const {
+        return params[player * m_row_lines].m_data;
+    }
+
+    // the parameters of a player in [-1, 1], a random portion of them is moved by up to change_rate
+    void mutate(f32 *params, f32 mutation_rate, f32 change_rate, u64 seed) const {
+        const auto threshold = static_cast<u32>(mutation_rate * 4294967295.0f);
+        const auto s = static_cast<u32>(seed);
+        const usize n = m_num_weights + m_num_biases;
+        for (usize i = 0; i < n; ++i) {
+            const u32 r1 = hash(s + static_cast<u32>(i) * 0x9e3779b9u);
+            const u32 r2 = hash(r1 ^ 0x85ebca6bu);
+            const f32 noise = (static_cast<f32>(r2 >> 8) * (2.0f / 16777216.0f) - 1.0f) * change_rate;
+            params[i] = std::clamp(params[i] + (r1 < threshold ? noise : 0.0f), -1.0f, 1.0f);
+        }
+    }
+
+    void build_players() {
+#pragma omp parallel for schedule(static)
+        for (usize i = 0; i < m_size; ++i) {
+            auto &net = m_players[i].m_net;
+            f32 const *params = row(m_params, i);
+            std::copy_n(params, m_num_weights, net.m_weights.m_data.begin());
+            std::copy_n(params + m_num_weights, m_num_biases, net.m_biases.m_data.begin());
+            net.pack();
+        }
+    }
+
+    // random opening of num_moves moves, even so that player one is to move
+    static board random_opening(u64 seed, i32 num_moves) {
+        board b;
+        random_player p{seed};
+        for (i32 i = 0; i < num_moves && !b.has_won().is_game_over(); ++i)
+            b.play(p(b), i % 2 == 0 ? 1 : -1);
+        return b.has_won().is_game_over() ? board{} : b;
+    }
+
+public:
+    /**
+     * @param size number of players, the parameters start uniformly distributed in [-0.1, 0.1] like
+     * neural_net::fill_randomly
+     */
+    population(usize size, u64 seed) : m_size{size}, m_seed{seed}, m_players(size) {
+        m_num_weights = m_players[0].m_net.m_weights.m_data.size();
+        m_num_biases = m_players[0].m_net.m_biases.m_data.size();
+        m_row_lines = (m_num_weights + m_num_biases + 15) / 16;
+        m_params.resize(m_size * m_row_lines);
+        m_next_params.resize(m_size * m_row_lines);
+        for (usize i = 0; i < m_size; ++i) {
+            f32 *params = row(m_params, i);
+            const auto s = static_cast<u32>(seed_of(0, i));
+            for (usize j = 0; j < m_num_weights + m_num_biases; ++j)
+                params[j] = (static_cast<f32>(hash(s + static_cast<u32>(j) * 0x9e3779b9u) >> 8) * (2.0f / 16777216.0f) -
+                             1.0f) * 0.1f;
+        }
+        build_players();
+    }
+
+    [[nodiscard]] usize size() const {
+        return m_size;
+    }
+
+    [[nodiscard]] player_t const &operator[](usize i) const {
+        return m_players[i];
+    }
+
+    /**
+     * one generation: every player plays every other player once with each color from a random opening of up to 8
+     * moves and scores +1 for a win and -1 for a loss. the best surviving_portion of the players survive in the order
+     * of their scores, the other rows are filled with copies of the best players and mutated
+     */
+    generation_stats evolve(f32 surviving_portion, f32 change_rate) {
+        auto const start = std::chrono::steady_clock::now();
+        const usize num_games = m_size * m_size;
+        std::vector<i8> results(num_games, 0);
+#pragma omp parallel
+        {
+            // every thread plays with its own copies, the players keep state between moves
+            std::vector<player_t> players = m_players;
+#pragma omp for schedule(dynamic, 16)
+            for (usize game = 0; game < num_games; ++game) {
+                const usize first = game / m_size, second = game % m_size;
+                if (first == second) continue;
+                const u64 seed = seed_of(1, game);
+                const board opening = random_opening(seed, static_cast<i32>(seed % 5 * 2));
+                const auto result = util::test_game(players[first], players[second], opening).has_won();
+                results[game] = static_cast<i8>(result.player_1_won() - result.player_2_won());
+            }
+        }
+
+        std::vector<std::pair<i32, usize>> scores(m_size);
+        for (usize i = 0; i < m_size; ++i)
+            scores[i] = {0, i};
+        for (usize game = 0; game < num_games; ++game) {
+            scores[game / m_size].first += results[game];
+            scores[game % m_size].first -= results[game];
+        }
+        // best first, ties keep the order of the last generation
+        std::stable_sort(scores.begin(), scores.end(), [](auto const &a, auto const &b) { return a.first > b.first; });
+
+        const usize num_survivors = std::clamp<usize>(static_cast<usize>(std::ceil(surviving_portion * m_size)), 1,
+                                                      m_size);
+#pragma omp parallel for schedule(static)
+        for (usize i = 0; i < m_size; ++i) {
+            const usize parent = scores[i < num_survivors ? i : (i - num_survivors) % num_survivors].second;
+            std::copy_n(row(m_params, parent), m_row_lines * 16, row(m_next_params, i));
+            if (i >= num_survivors) {
+                const u64 seed = seed_of(2, i);
+                // like the old per player mutation, on average 1 / 16 of the parameters change
+                const f32 mutation_rate = static_cast<f32>(seed >> 40) / static_cast<f32>(1 << 24) / 8;
+                mutate(row(m_next_params, i), mutation_rate, change_rate, seed);
+            }
+        }
+        std::swap(m_params, m_next_params);
+        build_players();
+        ++m_generation;
+
+        return {num_games - m_size, std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count(),
+                scores[0].first};
+    }
+
+    // every player plays num_games games with each color against copies of opponent, from random openings of 2 moves
+    template<class OPPONENT>
+    match_stats play_against(OPPONENT const &opponent, usize num_games) const {
+        auto const start = std::chrono::steady_clock::now();
+        match_stats stats;
+        const usize total = m_size * num_games;
+        std::vector<std::array<i8, 2>> results(total);
+#pragma omp parallel
+        {
+            std::vector<player_t> players = m_players;
+            OPPONENT other = opponent;
+#pragma omp for schedule(dynamic, 16)
+            for (usize game = 0; game < total; ++game) {
+                auto &player = players[game / num_games];
+                const board opening = random_opening(seed_of(3, game), 2);
+                const auto first = util::test_game(player, other, opening).has_won();
+                const auto second = util::test_game(other, player, opening).has_won();
+                results[game] = {static_cast<i8>(first.player_1_won() - first.player_2_won()),
+                                 static_cast<i8>(second.player_2_won() - second.player_1_won())};
+            }
+        }
+        for (auto const &result: results) {
+            for (usize color = 0; color < 2; ++color) {
+                stats.m_wins[color] += result[color] > 0;
+                stats.m_ties[color] += result[color] == 0;
+                stats.m_losses[color] += result[color] < 0;
+            }
+        }
+        stats.m_num_games = 2 * total;
+        stats.m_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+};
+
+} // namespace gya
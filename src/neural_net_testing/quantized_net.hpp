@@ -0,0 +1,285 @@
+#pragma once
+
+#include "../include.hpp"
+#include "neural_net.hpp"
+
+namespace gya {
+
+/**
+ * int8 inference copy of a trained dense net for players that don't learn anymore. every layer has one weight scale,
+ * the weights are stored as round(w * scale) in [-127, 127]. the inputs of a layer are quantized to int8 with a scale
+ * picked from their largest absolute value, the dot products are accumulated in int32 and converted back to floats
+ * for the bias and the activation function.
+ * with avx vnni the dot products are done by dpbusd, with avx2 by maddubs + madd, otherwise in scalar code. both need
+ * an unsigned operand, so |x| is multiplied by the weight with the sign of x, which also keeps the int16 pair sums of
+ * maddubs from saturating
+ */
+template<class F>
+class quantized_net {
+public:
+    // one int32 lane of a block holds 4 consecutive inputs
+    static constexpr usize GROUP_SIZE = 4;
+    static constexpr usize BLOCK_SIZE = 8;
+
+    struct layer {
+        usize m_num_inputs = 0;
+        usize m_num_outputs = 0;
+        f32 m_scale = 1;
+        bool m_activate = true;
+        // block[input / GROUP_SIZE][lane][input % GROUP_SIZE] for blocks of BLOCK_SIZE outputs, zero padded
+        std::vector<i8> m_weights;
+        std::vector<f32> m_biases;
+
+        [[nodiscard]] usize padded_inputs() const {
+            return (m_num_inputs + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
+        }
+
+        [[nodiscard]] usize padded_outputs() const {
+            return (m_num_outputs + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        }
+    };
+
+    std::vector<layer> m_layers;
+    F m_activation_function;
+
+    explicit quantized_net(F f = {}) : m_activation_function{std::move(f)} {}
+
+    /**
+     * appends a layer, weight(input, output) gives the f32 weights and biases has num_outputs entries
+     * @param activate whether the activation function is applied to the outputs of this layer
+     */
+    template<class WEIGHT>
+    void add_layer(usize num_inputs, usize num_outputs, WEIGHT &&weight, std::span<const f32> biases, bool activate) {
+        assert(m_layers.empty() || m_layers.back().m_num_outputs == num_inputs);
+        assert(biases.size() >= num_outputs);
+        layer &l = m_layers.emplace_back();
+        l.m_num_inputs = num_inputs;
+        l.m_num_outputs = num_outputs;
+        l.m_activate = activate;
+
+        f32 mx = 0;
+        for (usize in = 0; in < num_inputs; ++in)
+            for (usize out = 0; out < num_outputs; ++out)
+                mx = std::max(mx, std::abs(static_cast<f32>(weight(in, out))));
+        l.m_scale = mx > 0 ? 127.0f / mx : 1.0f;
+
+        const usize num_groups = l.padded_inputs() / GROUP_SIZE;
+        l.m_weights.assign(l.padded_inputs() * l.padded_outputs(), 0);
+        for (usize in = 0; in < num_inputs; ++in) {
+            for (usize out = 0; out < num_outputs; ++out) {
+                const usize block = out / BLOCK_SIZE, lane = out % BLOCK_SIZE;
+                const usize idx = ((block * num_groups + in / GROUP_SIZE) * BLOCK_SIZE + lane) * GROUP_SIZE +
+                                  in % GROUP_SIZE;
+                l.m_weights[idx] = static_cast<i8>(std::lround(static_cast<f32>(weight(in, out)) * l.m_scale));
+            }
+        }
+        l.m_biases.assign(l.padded_outputs(), 0);
+        std::copy_n(biases.begin(), num_outputs, l.m_biases.begin());
+    }
+
+    [[nodiscard]] usize num_inputs() const {
+        return m_layers.front().m_num_inputs;
+    }
+
+    [[nodiscard]] usize num_outputs() const {
+        return m_layers.back().m_num_outputs;
+    }
+
+    // bytes of quantized weights
+    [[nodiscard]] usize weight_bytes() const {
+        usize sum = 0;
+        for (auto const &l: m_layers)
+            sum += l.m_weights.size();
+        return sum;
+    }
+
+    void evaluate(std::span<const f32> input, std::span<f32> output) const {
+        assert(input.size() >= num_inputs() && output.size() >= num_outputs());
+        // values and quantized values, padded so that quantization can always work on 32 values at a time
+        thread_local std::vector<f32> values;
+        thread_local std::vector<i8> quantized, quantized_abs;
+        usize buffer_size = 0;
+        for (auto const &l: m_layers)
+            buffer_size = std::max({buffer_size, l.padded_inputs(), l.padded_outputs()});
+        buffer_size = (buffer_size + 31) / 32 * 32;
+        if (values.size() < buffer_size) {
+            values.resize(buffer_size);
+            quantized.resize(buffer_size);
+            quantized_abs.resize(buffer_size);
+        }
+
+        // the padding of the values is quantized too, so it has to be zero
+        auto clear_padding = [&](usize n) {
+            std::fill(values.begin() + static_cast<isize>(n), values.begin() + static_cast<isize>((n + 31) / 32 * 32),
+                      0.0f);
+        };
+        std::copy_n(input.begin(), num_inputs(), values.begin());
+        clear_padding(num_inputs());
+        usize num_values = num_inputs();
+        for (auto const &l: m_layers) {
+            const f32 scale = quantize(values.data(), num_values, quantized.data(), quantized_abs.data());
+            forward_layer(l, quantized.data(), quantized_abs.data(), scale, values.data());
+            clear_padding(l.m_num_outputs);
+            num_values = l.m_num_outputs;
+        }
+        std::copy_n(values.begin(), num_outputs(), output.begin());
+    }
+
+    [[nodiscard]] std::vector<f32> evaluate(std::span<const f32> input) const {
+        std::vector<f32> output(num_outputs());
+        evaluate(input, output);
+        return output;
+    }
+
+private:
+    /**
+     * x * scale rounded into [-127, 127] and its absolute value, n is rounded up to a multiple of 32 and the values
+     * after n have to be zero
+     * @return scale
+     */
+    static f32 quantize(f32 const *x, usize n, i8 *out, i8 *out_abs) {
+        n = (n + 31) / 32 * 32;
+#ifdef __AVX2__
+        __m256 mx8 = _mm256_setzero_ps();
+        const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        for (usize i = 0; i < n; i += 8)
+            mx8 = _mm256_max_ps(mx8, _mm256_and_ps(_mm256_loadu_ps(x + i), abs_mask));
+        alignas(32) f32 lanes[8];
+        _mm256_store_ps(lanes, mx8);
+        const f32 mx = *std::max_element(lanes, lanes + 8);
+        const f32 scale = mx > 0 ? 127.0f / mx : 1.0f;
+
+        const __m256 s = _mm256_set1_ps(scale);
+        // packs interleaves the 128 bit lanes
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (usize i = 0; i < n; i += 32) {
+            const __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i), s));
+            const __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 8), s));
+            const __m256i c = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 16), s));
+            const __m256i d = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 24), s));
+            const __m256i packed = _mm256_permutevar8x32_epi32(
+                    _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d)), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out_abs + i), _mm256_abs_epi8(packed));
+        }
+#else
+        f32 mx = 0;
+        for (usize i = 0; i < n; ++i)
+            mx = std::max(mx, std::abs(x[i]));
+        const f32 scale = mx > 0 ? 127.0f / mx : 1.0f;
+        for (usize i = 0; i < n; ++i) {
+            out[i] = static_cast<i8>(std::lround(x[i] * scale));
+            out_abs[i] = static_cast<i8>(std::abs(out[i]));
+        }
+#endif
+        return scale;
+    }
+
+#ifdef __AVX2__
+    static __m256i dot_group(__m256i acc, __m256i x_abs, __m256i x, i8 const *weights) {
+        const __m256i w = _mm256_sign_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(weights)), x);
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+        return _mm256_dpbusd_epi32(acc, x_abs, w);
+#elif defined(__AVXVNNI__)
+        return _mm256_dpbusd_avx_epi32(acc, x_abs, w);
+#else
+        return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(x_abs, w), _mm256_set1_epi16(1)));
+#endif
+    }
+
+    // NUM_BLOCKS blocks of outputs starting at first_block, the inputs are broadcast once for all of them
+    template<usize NUM_BLOCKS>
+    void forward_blocks(layer const &l, usize first_block, i8 const *x, i8 const *x_abs, f32 dequantize,
+                        f32 *out) const {
+        const usize num_groups = l.padded_inputs() / GROUP_SIZE;
+        const usize block_stride = num_groups * BLOCK_SIZE * GROUP_SIZE;
+        i8 const *weights = l.m_weights.data() + first_block * block_stride;
+        // few blocks get independent partial sums over the groups so that the dot product latency doesn't dominate
+        constexpr usize NUM_SPLITS = std::clamp<usize>(8 / NUM_BLOCKS, 1, 4);
+        __m256i acc[NUM_SPLITS][NUM_BLOCKS];
+        for (usize split = 0; split < NUM_SPLITS; ++split)
+            for (usize k = 0; k < NUM_BLOCKS; ++k)
+                acc[split][k] = _mm256_setzero_si256();
+        auto step = [&](usize g, __m256i (&partial)[NUM_BLOCKS]) {
+            i32 group, group_abs;
+            std::memcpy(&group, x + g * GROUP_SIZE, sizeof(group));
+            std::memcpy(&group_abs, x_abs + g * GROUP_SIZE, sizeof(group_abs));
+            const __m256i xs = _mm256_set1_epi32(group), xs_abs = _mm256_set1_epi32(group_abs);
+            for (usize k = 0; k < NUM_BLOCKS; ++k)
+                partial[k] = dot_group(partial[k], xs_abs, xs, weights + k * block_stride + g * BLOCK_SIZE * GROUP_SIZE);
+        };
+        usize g = 0;
+        for (; g + NUM_SPLITS <= num_groups; g += NUM_SPLITS)
+            for (usize split = 0; split < NUM_SPLITS; ++split)
+                step(g + split, acc[split]);
+        for (; g < num_groups; ++g)
+            step(g, acc[0]);
+
+        const __m256 d = _mm256_set1_ps(dequantize);
+        for (usize k = 0; k < NUM_BLOCKS; ++k) {
+            for (usize split = 1; split < NUM_SPLITS; ++split)
+                acc[0][k] = _mm256_add_epi32(acc[0][k], acc[split][k]);
+            const usize node = (first_block + k) * BLOCK_SIZE;
+            __m256 v = _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[0][k]), d, _mm256_loadu_ps(l.m_biases.data() + node));
+            if constexpr (simd_activation<F>)
+                if (l.m_activate) v = m_activation_function(v);
+            _mm256_storeu_ps(out + node, v);
+        }
+    }
+#endif
+
+    void forward_layer(layer const &l, i8 const *x, [[maybe_unused]] i8 const *x_abs, f32 x_scale, f32 *out) const {
+        const f32 dequantize = 1.0f / (x_scale * l.m_scale);
+#ifdef __AVX2__
+        // up to 8 blocks share the broadcast inputs
+        const usize num_blocks = l.padded_outputs() / BLOCK_SIZE;
+        usize block = 0;
+        for (; block + 8 <= num_blocks; block += 8)
+            forward_blocks<8>(l, block, x, x_abs, dequantize, out);
+        switch (num_blocks - block) {
+            case 7: forward_blocks<7>(l, block, x, x_abs, dequantize, out); break;
+            case 6: forward_blocks<6>(l, block, x, x_abs, dequantize, out); break;
+            case 5: forward_blocks<5>(l, block, x, x_abs, dequantize, out); break;
+            case 4: forward_blocks<4>(l, block, x, x_abs, dequantize, out); break;
+            case 3: forward_blocks<3>(l, block, x, x_abs, dequantize, out); break;
+            case 2: forward_blocks<2>(l, block, x, x_abs, dequantize, out); break;
+            case 1: forward_blocks<1>(l, block, x, x_abs, dequantize, out); break;
+            default: break;
+        }
+        constexpr bool ACTIVATED = simd_activation<F>;
+#else
+        const usize num_groups = l.padded_inputs() / GROUP_SIZE;
+        for (usize node = 0; node < l.padded_outputs(); ++node) {
+            const usize block = node / BLOCK_SIZE, lane = node % BLOCK_SIZE;
+            i32 sum = 0;
+            for (usize in = 0; in < l.padded_inputs(); ++in)
+                sum += x[in] * l.m_weights[((block * num_groups + in / GROUP_SIZE) * BLOCK_SIZE + lane) * GROUP_SIZE +
+                                           in % GROUP_SIZE];
+            out[node] = static_cast<f32>(sum) * dequantize + l.m_biases[node];
+        }
+        constexpr bool ACTIVATED = false;
+#endif
+        if (!ACTIVATED && l.m_activate)
+            for (usize node = 0; node < l.m_num_outputs; ++node)
+                out[node] = m_activation_function(out[node]);
+    }
+};
+
+/**
+ * int8 copy of a gya::neural_net, the activation function is applied after every layer like in forward_propagate
+ */
+template<bool USE_BACKPROP, bool LABELED_DATA, class T, class F1, class F2, usize... sizes>
+quantized_net<F1> quantize(neural_net<USE_BACKPROP, LABELED_DATA, T, F1, F2, sizes...> const &net) {
+    constexpr auto layer_sizes = std::array{sizes...};
+    quantized_net<F1> result{net.m_activation_function};
+    for (usize layer = 0; layer + 1 < layer_sizes.size(); ++layer) {
+        std::vector<f32> biases(layer_sizes[layer + 1]);
+        for (usize node = 0; node < biases.size(); ++node)
+            biases[node] = static_cast<f32>(net.m_biases[layer + 1][node]);
+        result.add_layer(layer_sizes[layer], layer_sizes[layer + 1],
+                         [&](usize in, usize out) { return net.m_weights[layer][in][out]; }, biases, true);
+    }
+    return result;
+}
+
+} // namespace gya
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../include.hpp"
+#include "quantized_net.hpp"
+
+#include "../../lib/tiny_dnn/tiny_dnn/tiny_dnn.h"
+
+namespace gya {
+
+// tanh like tiny_dnn's tanh_layer, the 8 wide version is a clamped pade approximation
+struct tanh_activation {
+    f32 operator()(f32 x) const {
+        return std::tanh(x);
+    }
+
+#ifdef __AVX2__
+    __m256 operator()(__m256 x) const {
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-4.97f)), _mm256_set1_ps(4.97f));
+        const __m256 x2 = _mm256_mul_ps(x, x);
+        __m256 p = _mm256_add_ps(x2, _mm256_set1_ps(378.0f));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(17325.0f));
+        p = _mm256_mul_ps(_mm256_fmadd_ps(p, x2, _mm256_set1_ps(135135.0f)), x);
+        __m256 q = _mm256_fmadd_ps(_mm256_set1_ps(28.0f), x2, _mm256_set1_ps(3150.0f));
+        q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(62370.0f));
+        q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(135135.0f));
+        const __m256 y = _mm256_div_ps(p, q);
+        return _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+    }
+#endif
+};
+
+// one dense layer, weights[input * num_outputs + output]
+struct dense_layer {
+    usize m_num_inputs = 0;
+    usize m_num_outputs = 0;
+    std::vector<f32> m_weights;
+    std::vector<f32> m_biases;
+    bool m_activate = false;
+};
+
+/**
+ * the layers of a tiny_dnn net like the ones of nn_test.cpp as dense layers, made of convolutional (stride 1, no
+ * padding), fully connected and tanh layers. a convolution on the fixed input size is a linear map, so it is unrolled
+ * into a dense layer
+ */
+inline std::vector<dense_layer> dense_layers(tiny_dnn::network<tiny_dnn::sequential> const &net) {
+    std::vector<dense_layer> result;
+    for (usize i = 0; i < net.layer_size(); ++i) {
+        tiny_dnn::layer const &l = *net[i];
+        const std::string type = l.layer_type();
+        if (type == "tanh-activation") {
+            if (result.empty() || result.back().m_activate)
+                throw std::runtime_error("tanh has to follow a weight layer");
+            result.back().m_activate = true;
+            continue;
+        }
+
+        const std::vector<tiny_dnn::vec_t const *> params = l.weights();
+        tiny_dnn::vec_t const &w = *params[0];
+        dense_layer &dense = result.emplace_back();
+        dense.m_num_inputs = l.in_shape()[0].size();
+        dense.m_num_outputs = l.out_shape()[0].size();
+        dense.m_biases.assign(dense.m_num_outputs, 0.0f);
+        if (type == "fully-connected") {
+            if (params.size() > 1)
+                std::copy_n(params[1]->begin(), dense.m_num_outputs, dense.m_biases.begin());
+            dense.m_weights.assign(w.begin(), w.begin() + static_cast<isize>(dense.m_num_inputs * dense.m_num_outputs));
+        } else if (type == "conv") {
+            const tiny_dnn::shape3d in = l.in_shape()[0], kernel = l.in_shape()[1], out = l.out_shape()[0];
+            if (out.width_ != in.width_ - kernel.width_ + 1 || out.height_ != in.height_ - kernel.height_ + 1)
+                throw std::runtime_error("only convolutions with stride 1 and no padding can be unrolled");
+            for (usize o = 0; o < out.depth_; ++o)
+                std::fill_n(dense.m_biases.begin() + static_cast<isize>(out.get_index(0, 0, o)), out.area(),
+                            params.size() > 1 ? (*params[1])[o] : 0.0f);
+            // with the index calculations of tiny_dnn's conv2d kernel
+            dense.m_weights.assign(in.size() * out.size(), 0.0f);
+            for (usize o = 0; o < out.depth_; ++o)
+                for (usize c = 0; c < in.depth_; ++c)
+                    for (usize y = 0; y < out.height_; ++y)
+                        for (usize x = 0; x < out.width_; ++x)
+                            for (usize ky = 0; ky < kernel.height_; ++ky)
+                                for (usize kx = 0; kx < kernel.width_; ++kx)
+                                    dense.m_weights[in.get_index(x + kx, y + ky, c) * out.size() +
+                                                    out.get_index(x, y, o)] =
+                                            w[kernel.get_index(kx, ky, in.depth_ * o + c)];
+        } else {
+            throw std::runtime_error("can't convert layer of type " + type);
+        }
+    }
+    return result;
+}
+
+// int8 copy of a tiny_dnn net, see dense_layers for the layers that are supported
+inline quantized_net<tanh_activation> quantize(tiny_dnn::network<tiny_dnn::sequential> const &net) {
+    quantized_net<tanh_activation> result;
+    for (dense_layer const &l: dense_layers(net))
+        result.add_layer(l.m_num_inputs, l.m_num_outputs, [&](usize in, usize out) {
+            return l.m_weights[in * l.m_num_outputs + out];
+        }, l.m_biases, l.m_activate);
+    return result;
+}
+
+} // namespace gya
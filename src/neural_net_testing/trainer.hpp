@@ -0,0 +1,200 @@
+#pragma once
+
+#include "../include.hpp"
+#include "layer_array.hpp"
+#include "neural_net.hpp"
+#include "weight_array.hpp"
+
+namespace gya {
+
+enum class optimizer {
+    SGD,
+    ADAM,
+};
+
+template<class NEURAL_NET>
+class trainer;
+
+/**
+ * minibatch trainer for the squared error of a neural_net. the samples of a batch are spread over the omp threads,
+ * every thread accumulates into its own gradient buffers. the optimizer step sums them up, updates the optimizer state
+ * and the parameters and clears the buffers in one pass. all buffers and the adam moments are allocated once in the
+ * constructor, a batch doesn't allocate
+ */
+template<bool USE_BACKPROP, bool LABELED_DATA, class T, class F1, class F2, usize... sizes>
+class trainer<neural_net<USE_BACKPROP, LABELED_DATA, T, F1, F2, sizes...>> {
+public:
+    using neural_net_t = neural_net<USE_BACKPROP, LABELED_DATA, T, F1, F2, sizes...>;
+    using layer_array_t = layer_array<T, sizes...>;
+    using weight_array_t = weight_array<T, sizes...>;
+
+    static constexpr usize NUM_INPUTS = std::array{sizes...}.front();
+    static constexpr usize NUM_OUTPUTS = std::array{sizes...}.back();
+
+    neural_net_t &m_net;
+    optimizer m_optimizer;
+    T m_learning_rate;
+    T m_beta1;
+    T m_beta2;
+    T m_epsilon;
+
+private:
+    struct thread_buffers {
+        layer_array_t m_values;
+        layer_array_t m_deltas;
+        layer_array_t m_bias_gradients;
+        weight_array_t m_weight_gradients;
+        T m_loss;
+    };
+
+    // one per thread of the largest team seen so far
+    std::vector<std::unique_ptr<thread_buffers>> m_buffers;
+    // number of buffers that hold gradients of the current batch
+    usize m_num_used_buffers = 0;
+
+    // for train_epoch
+    std::vector<usize> m_order;
+    std::vector<T> m_batch_inputs, m_batch_targets;
+
+    // first and second moments of adam
+    std::unique_ptr<weight_array_t> m_weight_m, m_weight_v;
+    std::unique_ptr<layer_array_t> m_bias_m, m_bias_v;
+    u64 m_num_steps = 0;
+
+public:
+    trainer(neural_net_t &net, optimizer opt, T learning_rate, T beta1 = 0.9, T beta2 = 0.999, T epsilon = 1e-8)
+            : m_net(net), m_optimizer(opt), m_learning_rate(learning_rate), m_beta1(beta1), m_beta2(beta2),
+              m_epsilon(epsilon) {
+        if (m_optimizer == optimizer::ADAM) {
+            m_weight_m = std::make_unique<weight_array_t>();
+            m_weight_v = std::make_unique<weight_array_t>();
+            m_bias_m = std::make_unique<layer_array_t>();
+            m_bias_v = std::make_unique<layer_array_t>();
+        }
+    }
+
+    /**
+     * one optimizer step on the mean gradient of n samples, inputs and targets hold one row per sample
+     * @return mean loss of the batch before the step
+     */
+    T train_batch(std::span<const T> inputs, std::span<const T> targets, usize n) {
+        assert(inputs.size() >= n * NUM_INPUTS && targets.size() >= n * NUM_OUTPUTS);
+        if (!n) return 0;
+
+        usize num_threads = 1;
+#pragma omp parallel
+        {
+#pragma omp single
+            {
+                // the team can be larger than at the last step, the barrier of single covers the new buffers
+                num_threads = static_cast<usize>(omp_get_num_threads());
+                while (m_buffers.size() < num_threads)
+                    m_buffers.push_back(std::make_unique<thread_buffers>());
+            }
+            // the gradient buffers were cleared by the previous step
+            thread_buffers &b = *m_buffers[static_cast<usize>(omp_get_thread_num())];
+            b.m_loss = 0;
+#pragma omp for schedule(static)
+            for (usize i = 0; i < n; ++i) {
+                std::array<T, NUM_INPUTS> input;
+                std::copy_n(inputs.begin() + static_cast<isize>(i * NUM_INPUTS), NUM_INPUTS, input.begin());
+                const std::span<const T> target = targets.subspan(i * NUM_OUTPUTS, NUM_OUTPUTS);
+                const auto output = m_net.forward_propagate(input, b.m_values);
+                for (usize j = 0; j < NUM_OUTPUTS; ++j)
+                    b.m_loss += (output[j] - target[j]) * (output[j] - target[j]) / 2;
+                m_net.accumulate_gradients(b.m_values, target, b.m_deltas, b.m_weight_gradients, b.m_bias_gradients);
+            }
+        }
+
+        m_num_used_buffers = std::max(m_num_used_buffers, num_threads);
+        T loss = 0;
+        for (usize t = 0; t < num_threads; ++t)
+            loss += m_buffers[t]->m_loss;
+
+        const T scale = T{1} / static_cast<T>(n);
+        if (m_optimizer == optimizer::SGD) {
+            step(m_net.m_weights.m_data, &thread_buffers::m_weight_gradients, scale, sgd_update());
+            step(m_net.m_biases.m_data, &thread_buffers::m_bias_gradients, scale, sgd_update());
+        } else {
+            ++m_num_steps;
+            step(m_net.m_weights.m_data, &thread_buffers::m_weight_gradients, scale,
+                 adam_update(m_weight_m->m_data.data(), m_weight_v->m_data.data()));
+            step(m_net.m_biases.m_data, &thread_buffers::m_bias_gradients, scale,
+                 adam_update(m_bias_m->m_data.data(), m_bias_v->m_data.data()));
+        }
+        m_net.pack();
+        return loss * scale;
+    }
+
+    /**
+     * one pass over n samples in a random order with the given batch size
+     * @return mean loss over the pass
+     */
+    T train_epoch(std::span<const T> inputs, std::span<const T> targets, usize n, usize batch_size, u64 seed) {
+        auto &order = m_order;
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64{seed});
+
+        auto &batch_inputs = m_batch_inputs, &batch_targets = m_batch_targets;
+        batch_inputs.resize(batch_size * NUM_INPUTS);
+        batch_targets.resize(batch_size * NUM_OUTPUTS);
+        T loss_sum = 0;
+        for (usize first = 0; first < n; first += batch_size) {
+            const usize num_samples = std::min(batch_size, n - first);
+            for (usize i = 0; i < num_samples; ++i) {
+                std::copy_n(inputs.begin() + static_cast<isize>(order[first + i] * NUM_INPUTS), NUM_INPUTS,
+                            batch_inputs.begin() + static_cast<isize>(i * NUM_INPUTS));
+                std::copy_n(targets.begin() + static_cast<isize>(order[first + i] * NUM_OUTPUTS), NUM_OUTPUTS,
+                            batch_targets.begin() + static_cast<isize>(i * NUM_OUTPUTS));
+            }
+            loss_sum += train_batch(batch_inputs, batch_targets, num_samples) * static_cast<T>(num_samples);
+        }
+        return n ? loss_sum / static_cast<T>(n) : 0;
+    }
+
+private:
+    // update(i, g) changes parameter i for the mean gradient g
+    auto sgd_update() const {
+        return [rate = m_learning_rate](T &param, usize, T g) { param -= rate * g; };
+    }
+
+    auto adam_update(T *m, T *v) const {
+        const T m_correction = T{1} / (1 - std::pow(m_beta1, static_cast<T>(m_num_steps)));
+        const T v_correction = T{1} / (1 - std::pow(m_beta2, static_cast<T>(m_num_steps)));
+        return [=, this](T &param, usize i, T g) {
+            m[i] = m_beta1 * m[i] + (1 - m_beta1) * g;
+            v[i] = m_beta2 * v[i] + (1 - m_beta2) * g * g;
+            param -= m_learning_rate * (m[i] * m_correction) / (std::sqrt(v[i] * v_correction) + m_epsilon);
+        };
+    }
+
+    /**
+     * sums up the gradients of every thread, applies the update and clears the gradients for the next batch, all in one
+     * pass over the parameters
+     */
+    template<usize N, class BUFFER, class UPDATE>
+    void step(std::array<T, N> &params, BUFFER thread_buffers::*gradients, T scale, UPDATE update) {
+        const usize num_buffers = m_num_used_buffers;
+        if (num_buffers == 1) {
+            auto &g = ((*m_buffers[0]).*gradients).m_data;
+            for (usize i = 0; i < N; ++i) {
+                update(params[i], i, g[i] * scale);
+                g[i] = 0;
+            }
+            return;
+        }
+#pragma omp parallel for schedule(static) if (N >= 1024)
+        for (usize i = 0; i < N; ++i) {
+            T sum = 0;
+            for (usize t = 0; t < num_buffers; ++t) {
+                auto &g = ((*m_buffers[t]).*gradients).m_data;
+                sum += g[i];
+                g[i] = 0;
+            }
+            update(params[i], i, sum * scale);
+        }
+    }
+};
+
+} // namespace gya
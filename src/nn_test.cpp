@@ -5,6 +5,7 @@
 #include "heuristic/brute_force/transposition_table_solver.hpp"
 #include "heuristic/brute_force/two_move_solver.hpp"
 #include "heuristic/mcts/mcts.hpp"
+#include "heuristic/mcts/puct.hpp"
 #include "heuristic/solver_variations/A.hpp"
 #include "heuristic/solver_variations/Abias.hpp"
 #include "heuristic/solver_variations/simple_n_move_solver.hpp"
@@ -30,6 +31,27 @@ struct net_printer {
     }
 };
 
+// evaluates the leaves of a puct search with one batched forward pass of the network
+struct tiny_dnn_evaluator {
+    network<sequential> *net;
+
+    void operator()(std::span<gya::board const> positions, std::span<mcts::evaluation> results) const {
+        std::vector<tensor_t> inputs(positions.size());
+        for (usize k = 0; k < positions.size(); ++k) {
+            vec_t input;
+            for (i32 i = gya::BOARD_HEIGHT - 1; i >= 0; i--)
+                for (i32 j = 0; j < gya::BOARD_WIDTH; j++)
+                    input.push_back(positions[k][j][i]);
+            inputs[k] = {input};
+        }
+        const auto outputs = net->predict(inputs);
+        for (usize k = 0; k < positions.size(); ++k) {
+            const vec_t &q = outputs[k][0];
+            results[k] = mcts::evaluation_from_q_values(positions[k], std::span<const f32>{q.data(), q.size()});
+        }
+    }
+};
+
 void benchmark(network<sequential> &net) {
     struct solver_from_network {
         network<sequential> &net;
@@ -85,6 +107,21 @@ void benchmark(network<sequential> &net) {
         }
         outfiles[i] << w << ' ' << t << ' ' << l << std::endl;
     }
+
+    // the network as the leaf evaluator of a search
+    static std::ofstream puct_outfile(path + identifier + "-puct-n_move_solver_4.benchmark_data");
+    mcts::puct puct_solver{tiny_dnn_evaluator{&net}, 256};
+    auto f = [&](gya::board const &board) { return puct_solver.move(board, board.turn()); };
+    auto n_move_solver = [](gya::board const &board) { return heuristic::n_move_solver{4}(board); };
+    i32 w = 0, t = 0, l = 0;
+    for (int game_idx = 0; game_idx < 10; ++game_idx) {
+        gya::board b1 = util::test_game(f, n_move_solver);
+        gya::board b2 = util::test_game(n_move_solver, f);
+        w += b1.has_won().player_1_won() + b2.has_won().player_2_won();
+        t += b1.has_won().is_tie() + b2.has_won().is_tie();
+        l += b1.has_won().player_2_won() + b2.has_won().player_1_won();
+    }
+    puct_outfile << w << ' ' << t << ' ' << l << std::endl;
 }
 
 int main() {
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "../../include.hpp"
+
+#include "../utils/tensor.hpp"
+#include "../utils/math.hpp"
+#include "../utils/activation.hpp"
+
+#include "layer_base.hpp"
+
+namespace pinguml {
+
+/**
+ * k x k convolution with stride 1 and pad zeros around every side (pad = (k - 1) / 2 keeps the size of the board), one
+ * bias per filter. made for small inputs like a 6 x 7 board with many channels: the input is unrolled with im2col into
+ * a (channels * k * k) x (rows * cols) matrix that stays in l2 and the filters are applied with one gemm, so the
+ * register blocking of gemm is used instead of a loop over the tiny rows. the channels of the nodes start at multiples
+ * of m_channel_stride like in every layer, the rows of the batched path are dense.
+ * the size of the nodes is set by the first connection, all connections have to come from layers of the same size
+ */
+class convolution_layer : public layer_base {
+public:
+    u32 m_kernel;
+    u32 m_filters;
+    u32 m_pad;
+
+    convolution_layer(const std::string name, const u32 kernel, const u32 filters, const u32 pad, activation_base *f) : layer_base(name, 1, 1, filters), m_kernel(kernel), m_filters(filters), m_pad(pad) {
+        m_f = f;
+        m_uses_biases = 1;
+        m_biases = tensor(m_filters, 1, 1);
+        m_biases.fill(0.f);
+    }
+
+    virtual std::string config_string() {
+        return "convolution " + std::to_string(m_kernel) + " " + std::to_string(m_filters) + " " + std::to_string(m_pad) + " " + m_f->m_name + "\n";
+    }
+
+    // weights[filter][channel][ky][kx]
+    virtual tensor *create_connection(layer_base &left_layer, const u32 index) {
+        const tensor &left = left_layer.m_nodes;
+        if (left.m_rows + 2 * m_pad < m_kernel || left.m_cols + 2 * m_pad < m_kernel)
+            throw std::runtime_error("convolution kernel is larger than the input of " + m_name);
+        const u32 rows = left.m_rows + 2 * m_pad - m_kernel + 1, cols = left.m_cols + 2 * m_pad - m_kernel + 1;
+        if (m_backward_connections.empty()) {
+            m_nodes = tensor(rows, cols, m_filters);
+            m_delta = tensor(rows, cols, m_filters);
+        }
+        else if (rows != m_nodes.m_rows || cols != m_nodes.m_cols)
+            throw std::runtime_error("inputs of different sizes in " + m_name);
+
+        left_layer.m_forward_connections.push_back({index, this});
+        m_backward_connections.push_back({index, &left_layer});
+        return new tensor(m_filters, left.m_channels * m_kernel * m_kernel, 1);
+    }
+
+    // out (+)= the filters applied to in, the channels of in and out are in_stride and out_stride apart
+    void convolve(const tensor &left, const f32 *in, const u32 in_stride, const f32 *weights, f32 *out, const u32 out_stride, const bool overwrite) const {
+        const u32 size = left.m_channels * m_kernel * m_kernel, positions = m_nodes.m_rows * m_nodes.m_cols;
+        if (overwrite)
+            for (u32 i = 0; i < m_filters; i++) std::memset(out + i * out_stride, 0, positions * sizeof(f32));
+        // a 1 x 1 convolution is a gemm with the input as it is
+        if (m_kernel == 1 && !m_pad) {
+            gemm(false, false, m_filters, positions, size, weights, size, in, in_stride, out, out_stride);
+            return;
+        }
+        thread_local std::vector<f32> col;
+        col.resize(size * positions);
+        im2col(in, left.m_channels, left.m_rows, left.m_cols, in_stride, m_kernel, m_pad, col.data());
+        gemm(false, false, m_filters, positions, size, weights, size, col.data(), positions, out, out_stride);
+    }
+
+    // left delta += the transposed convolution of delta
+    void deconvolve(const tensor &left, const f32 *delta, const u32 delta_stride, const f32 *weights, f32 *left_delta, const u32 left_stride) const {
+        const u32 size = left.m_channels * m_kernel * m_kernel, positions = m_nodes.m_rows * m_nodes.m_cols;
+        if (m_kernel == 1 && !m_pad) {
+            gemm(true, false, size, positions, m_filters, weights, size, delta, delta_stride, left_delta, left_stride);
+            return;
+        }
+        thread_local std::vector<f32> col;
+        col.assign(size * positions, 0.f);
+        gemm(true, false, size, positions, m_filters, weights, size, delta, delta_stride, col.data(), positions);
+        col2im(col.data(), left.m_channels, left.m_rows, left.m_cols, left_stride, m_kernel, m_pad, left_delta);
+    }
+
+    // delta weights += delta * in^T, unrolled like in convolve
+    void correlate(const tensor &left, const f32 *in, const u32 in_stride, const f32 *delta, const u32 delta_stride, f32 *delta_weights) const {
+        const u32 size = left.m_channels * m_kernel * m_kernel, positions = m_nodes.m_rows * m_nodes.m_cols;
+        if (m_kernel == 1 && !m_pad) {
+            gemm(false, true, m_filters, size, positions, delta, delta_stride, in, in_stride, delta_weights, size);
+            return;
+        }
+        thread_local std::vector<f32> col;
+        col.resize(size * positions);
+        im2col(in, left.m_channels, left.m_rows, left.m_cols, in_stride, m_kernel, m_pad, col.data());
+        gemm(false, true, m_filters, size, positions, delta, delta_stride, col.data(), positions, delta_weights, size);
+    }
+
+    // the padding of the channels stays 0
+    virtual void activate() {
+        const u32 positions = m_nodes.m_rows * m_nodes.m_cols;
+        for (u32 i = 0; i < m_filters; i++)
+            m_f->activation_c(m_nodes.m_ptr + i * m_nodes.m_channel_stride, m_biases.m_ptr[i], positions);
+    }
+
+    virtual void activate_batch(const u32 batch) {
+        const u32 positions = m_nodes.m_rows * m_nodes.m_cols;
+        for (u32 i = 0; i < batch; i++)
+            for (u32 j = 0; j < m_filters; j++)
+                m_f->activation_c(m_batch_nodes.m_ptr + (i * m_filters + j) * positions, m_biases.m_ptr[j], positions);
+    }
+
+    static void activate_kernel(const forward_step &step, [[maybe_unused]] const f32 *weights) {
+        for (u32 i = 0; i < step.m_channels; i++)
+            step.m_f->activation_c(step.m_out + i * step.m_channel_stride, step.m_biases[i], step.m_channel_size);
+    }
+
+    virtual forward_step activate_step() {
+        forward_step step;
+        step.m_kernel = activate_kernel;
+        step.m_out = m_nodes.m_ptr;
+        step.m_biases = m_biases.m_ptr;
+        step.m_f = m_f;
+        step.m_channels = m_filters;
+        step.m_channel_size = m_nodes.m_rows * m_nodes.m_cols;
+        step.m_channel_stride = m_nodes.m_channel_stride;
+        return step;
+    }
+
+    template<bool OVERWRITE>
+    static void push_forward_kernel(const forward_step &step, const f32 *weights) {
+        const auto &layer = *static_cast<const convolution_layer*>(step.m_layer);
+        layer.convolve(step.m_left_layer->m_nodes, step.m_in, step.m_channel_stride, weights, step.m_out, layer.m_nodes.m_channel_stride, OVERWRITE);
+    }
+
+    virtual forward_step push_forward_step(const layer_base &left_layer, const u32 connection, const bool overwrite) {
+        forward_step step;
+        step.m_kernel = overwrite ? push_forward_kernel<true> : push_forward_kernel<false>;
+        step.m_in = left_layer.m_nodes.m_ptr;
+        step.m_out = m_nodes.m_ptr;
+        step.m_connection = connection;
+        step.m_channel_stride = left_layer.m_nodes.m_channel_stride;
+        step.m_left_layer = &left_layer;
+        step.m_layer = this;
+        return step;
+    }
+
+    virtual void push_forward(const layer_base &left_layer, const tensor &weights, [[maybe_unused]] const i32 train = 0) {
+        convolve(left_layer.m_nodes, left_layer.m_nodes.m_ptr, left_layer.m_nodes.m_channel_stride, weights.m_ptr, m_nodes.m_ptr, m_nodes.m_channel_stride, false);
+    }
+
+    virtual void push_forward_batch(const layer_base &left_layer, const tensor &weights, const u32 batch) {
+        const tensor &left = left_layer.m_nodes;
+        const u32 left_size = left.m_rows * left.m_cols * left.m_channels, positions = m_nodes.m_rows * m_nodes.m_cols;
+        for (u32 i = 0; i < batch; i++)
+            convolve(left, left_layer.m_batch_nodes.m_ptr + i * left_size, left.m_rows * left.m_cols, weights.m_ptr, m_batch_nodes.m_ptr + i * m_filters * positions, positions, false);
+    }
+
+    virtual void propogate_delta(layer_base &left_layer, const tensor &weights) {
+        deconvolve(left_layer.m_nodes, m_delta.m_ptr, m_delta.m_channel_stride, weights.m_ptr, left_layer.m_delta.m_ptr, left_layer.m_delta.m_channel_stride);
+    }
+
+    virtual void propogate_delta_batch(layer_base &left_layer, const tensor &weights, const u32 batch) {
+        const tensor &left = left_layer.m_nodes;
+        const u32 left_size = left.m_rows * left.m_cols * left.m_channels, positions = m_nodes.m_rows * m_nodes.m_cols;
+        for (u32 i = 0; i < batch; i++)
+            deconvolve(left, m_batch_delta.m_ptr + i * m_filters * positions, positions, weights.m_ptr, left_layer.m_batch_delta.m_ptr + i * left_size, left.m_rows * left.m_cols);
+    }
+
+    virtual void calculate_delta_weights(const layer_base &left_layer, tensor &delta_weights) {
+        delta_weights.resize(m_filters, left_layer.m_nodes.m_channels * m_kernel * m_kernel, 1);
+        delta_weights.fill(0.f);
+        correlate(left_layer.m_nodes, left_layer.m_nodes.m_ptr, left_layer.m_nodes.m_channel_stride, m_delta.m_ptr, m_delta.m_channel_stride, delta_weights.m_ptr);
+    }
+
+    virtual void calculate_delta_weights_batch(const layer_base &left_layer, tensor &delta_weights, const u32 batch) {
+        const tensor &left = left_layer.m_nodes;
+        const u32 left_size = left.m_rows * left.m_cols * left.m_channels, positions = m_nodes.m_rows * m_nodes.m_cols;
+        delta_weights.resize(m_filters, left.m_channels * m_kernel * m_kernel, 1);
+        delta_weights.fill(0.f);
+        for (u32 i = 0; i < batch; i++)
+            correlate(left, left_layer.m_batch_nodes.m_ptr + i * left_size, left.m_rows * left.m_cols, m_batch_delta.m_ptr + i * m_filters * positions, positions, delta_weights.m_ptr);
+    }
+
+    // the bias of a filter gets the delta of all its positions
+    virtual void calculate_delta_biases(tensor &delta_biases) {
+        const u32 positions = m_nodes.m_rows * m_nodes.m_cols;
+        delta_biases.resize(m_filters, 1, 1);
+        delta_biases.fill(0.f);
+        for (u32 i = 0; i < m_filters; i++)
+            for (u32 j = 0; j < positions; j++)
+                delta_biases.m_ptr[i] += m_delta.m_ptr[i * m_delta.m_channel_stride + j];
+    }
+
+    virtual void calculate_delta_biases_batch(tensor &delta_biases, const u32 batch) {
+        const u32 positions = m_nodes.m_rows * m_nodes.m_cols;
+        delta_biases.resize(m_filters, 1, 1);
+        delta_biases.fill(0.f);
+        for (u32 i = 0; i < batch; i++)
+            for (u32 j = 0; j < m_filters; j++)
+                for (u32 k = 0; k < positions; k++)
+                    delta_biases.m_ptr[j] += m_batch_delta.m_ptr[(i * m_filters + j) * positions + k];
+    }
+};
+
+} // namespace pinguml
@@ -7,6 +7,7 @@
 #include "layer_base.hpp"
 #include "input_layer.hpp"
 #include "fully_connected_layer.hpp"
+#include "convolution_layer.hpp"
 
 namespace pinguml {
 
@@ -22,13 +23,25 @@ layer_base *create_layer(const std::string name, const std::string build) {
         return new input_layer(name, height, width, channels);
     }
     else if(layer_type == "fully_connected") {
-        std::string activation;
-        str >> height >> activation;
+        std::string activation, inputs;
+        str >> height >> activation >> inputs;
 
         if(height <= 0) 
             throw std::runtime_error("invalid number of nodes in fully connected layer");
+        if(!inputs.empty() && inputs != "sparse")
+            throw std::runtime_error("invalid option '" + inputs + "' of fully connected layer");
+
+        return new fully_connected_layer(name, height, create_activation(activation), inputs == "sparse");
+    }
+    else if(layer_type == "convolution") {
+        u32 kernel, filters, pad;
+        std::string activation;
+        str >> kernel >> filters >> pad >> activation;
+
+        if(kernel == 0 || filters == 0)
+            throw std::runtime_error("invalid kernel size or number of filters in convolution layer");
 
-        return new fully_connected_layer(name, height, create_activation(activation));
+        return new convolution_layer(name, kernel, filters, pad, create_activation(activation));
     }
     else throw std::runtime_error("invalid layer-type '" + layer_type + "'");
 
@@ -19,6 +19,10 @@ public:
 
     virtual void activate() {}
 
+    virtual forward_step activate_step() { return {}; }
+
+    virtual void activate_batch([[maybe_unused]] const u32 batch) {}
+
     virtual std::string config_string() {
         return "input " + std::to_string(m_nodes.m_rows) + " " + std::to_string(m_nodes.m_cols) + " " + std::to_string(m_nodes.m_channels) + " " + m_f->m_name + "\n"; 
     }
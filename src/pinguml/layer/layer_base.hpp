@@ -7,6 +7,27 @@
 
 namespace pinguml {
 
+constexpr u32 NO_CONNECTION = std::numeric_limits<u32>::max();
+
+class layer_base;
+
+// one kernel call of the compiled forward pass of a network, the tensors are bound when the network is connected and
+// only the weights are looked up per call because they are double buffered
+struct forward_step {
+    void (*m_kernel)(const forward_step &step, const f32 *weights) = nullptr;
+    const f32 *m_in = nullptr;
+    f32 *m_out = nullptr;
+    const f32 *m_biases = nullptr;
+    activation_base *m_f = nullptr;
+    u32 m_connection = NO_CONNECTION;
+    u32 m_rows = 0, m_cols = 0;
+    u32 m_channels = 1, m_channel_size = 0, m_channel_stride = 0;
+    // for kernels that need more of the layers than the sizes above
+    const layer_base *m_left_layer = nullptr, *m_layer = nullptr;
+    // changes whenever the network changes its weights, for kernels that keep something derived from them
+    const std::atomic<u64> *m_weights_version = nullptr;
+};
+
 class layer_base {
 protected:
     bool m_uses_weights;
@@ -22,6 +43,10 @@ public:
     tensor m_biases;
     tensor m_delta;
 
+    // minibatch of the batched path, one sample per row without channel padding
+    tensor m_batch_nodes;
+    tensor m_batch_delta;
+
     u32 m_pad_rows;
     u32 m_pad_cols;
 
@@ -56,22 +81,99 @@ public:
             m_f->activation_c(m_nodes.m_ptr, 0.f, m_nodes.size());
     }
 
+    virtual void activate_batch(const u32 batch) {
+        const u32 size = m_nodes.m_rows * m_nodes.m_cols * m_nodes.m_channels;
+        for (u32 i = 0; i < batch; i++) {
+            if (m_uses_biases)
+                m_f->activation(m_batch_nodes.m_ptr + i * size, m_biases.m_ptr, size);
+            else
+                m_f->activation_c(m_batch_nodes.m_ptr + i * size, 0.f, size);
+        }
+    }
+
+    static void activate_kernel(const forward_step &step, [[maybe_unused]] const f32 *weights) {
+        if (step.m_biases)
+            step.m_f->activation(step.m_out, step.m_biases, step.m_rows);
+        else
+            step.m_f->activation_c(step.m_out, 0.f, step.m_rows);
+    }
+
+    static void zero_kernel(const forward_step &step, [[maybe_unused]] const f32 *weights) {
+        std::memset(step.m_out, 0, step.m_rows * sizeof(f32));
+    }
+
+    // activate() as a step of a compiled forward pass, no kernel if the layer isn't activated
+    virtual forward_step activate_step() {
+        forward_step step;
+        step.m_kernel = activate_kernel;
+        step.m_out = m_nodes.m_ptr;
+        step.m_biases = m_uses_biases ? m_biases.m_ptr : nullptr;
+        step.m_f = m_f;
+        step.m_rows = m_nodes.size();
+        return step;
+    }
+
     void set_learning_rate(const f32 alpha) { m_learning_rate = alpha; }
 
     virtual void push_forward([[maybe_unused]] const layer_base &left_layer, [[maybe_unused]] const tensor &weights, [[maybe_unused]] i32 train) {}
 
+    // push_forward as a step of a compiled forward pass, the first push into a layer overwrites its nodes instead of
+    // adding to them. no kernel if the layer doesn't push anything
+    virtual forward_step push_forward_step([[maybe_unused]] const layer_base &left_layer, [[maybe_unused]] const u32 connection, [[maybe_unused]] const bool overwrite) {
+        return {};
+    }
+
+    virtual void push_forward_batch([[maybe_unused]] const layer_base &left_layer, [[maybe_unused]] const tensor &weights, [[maybe_unused]] const u32 batch) {}
+
     f32 df(f32 *in, u32 i) { 
         if (m_f) return m_f->activation_d(in, i); 
         return 1.f;
     }
 
+    // delta *= df over the whole layer
+    void df(const f32 *in, f32 *delta, const u32 size) {
+        if (m_f) m_f->activation_d_tensor(in, delta, size);
+    }
+
+    void df_batch(const u32 batch) {
+        df(m_batch_nodes.m_ptr, m_batch_delta.m_ptr, batch * m_nodes.m_rows * m_nodes.m_cols * m_nodes.m_channels);
+    }
+
     virtual std::string config_string() { return ""; }
 
     virtual void calculate_delta_weights([[maybe_unused]] const layer_base &left_layer, [[maybe_unused]] tensor &delta_weights) {}
 
     virtual void propogate_delta([[maybe_unused]] layer_base &left_layer, [[maybe_unused]] const tensor &weights) {}
 
-    virtual void update_biases([[maybe_unused]] const tensor &delta_biases, [[maybe_unused]] const f32 alpha) {}
+    /**
+     * propogate_delta and calculate_delta_weights for one connection. left_df is set for the last connection that
+     * propogates into left_layer, its delta is complete then and gets multiplied by its df as well. layers that can do
+     * it all in one pass over the weights override this
+     */
+    virtual void backpropogate(layer_base &left_layer, const tensor &weights, tensor &delta_weights, const bool left_df) {
+        propogate_delta(left_layer, weights);
+        calculate_delta_weights(left_layer, delta_weights);
+        if (left_df) left_layer.df(left_layer.m_nodes.m_ptr, left_layer.m_delta.m_ptr, left_layer.m_nodes.size());
+    }
+
+    virtual void calculate_delta_weights_batch([[maybe_unused]] const layer_base &left_layer, [[maybe_unused]] tensor &delta_weights, [[maybe_unused]] const u32 batch) {}
+
+    virtual void propogate_delta_batch([[maybe_unused]] layer_base &left_layer, [[maybe_unused]] const tensor &weights, [[maybe_unused]] const u32 batch) {}
+
+    // gradient of the biases of the per sample path, in the shape of m_biases
+    virtual void calculate_delta_biases(tensor &delta_biases) {
+        delta_biases = m_delta;
+    }
+
+    // the same summed over a batch of the batched path
+    virtual void calculate_delta_biases_batch(tensor &delta_biases, const u32 batch) {
+        const u32 size = m_batch_delta.m_cols;
+        delta_biases.resize(m_nodes.m_rows, m_nodes.m_cols, m_nodes.m_channels);
+        delta_biases.fill(0.f);
+        for (u32 i = 0; i < batch; i++)
+            for (u32 j = 0; j < size; j++)
+                delta_biases.m_ptr[j] += m_batch_delta.m_ptr[i * size + j];
+    }
 };
 
 } // namespace pinguml
@@ -2,40 +2,62 @@
 
 #include "../include.hpp"
 
-#include <unistd.h>
+#include <atomic>
+#include <thread>
 
 #include "layer/create_layer.hpp"
 #include "layer/layer_base.hpp"
 #include "layer/input_layer.hpp"
 #include "layer/fully_connected_layer.hpp"
+#include "layer/convolution_layer.hpp"
 
 #include "utils/activation.hpp"
 #include "utils/cost.hpp"
+#include "utils/dataset.hpp"
+#include "utils/file.hpp"
 #include "utils/math.hpp"
 #include "utils/tensor.hpp"
+#include "utils/thread_pool.hpp"
 #include "utils/solver.hpp"
 
 namespace pinguml {
 
-const u8 BATCH_RESERVED = 1, BATCH_FREE = 0, BATCH_COMPLETE = 2;
-const i8 BATCH_FILLED_COMPLETE = -2, BATCH_FILLED_IN_PROCESS = -1;
 const u8 MAIN_COPY = 0;
 
+// forward pass of one network copy compiled into a flat list of kernel calls, see network::compile
+struct forward_plan {
+    // nodes and size of the input layers, the input of forward is copied into them in this order
+    std::vector<std::pair<f32*, u32>> m_inputs;
+    std::vector<forward_step> m_steps;
+    f32 *m_output = nullptr;
+
+    // the layers split in branches, chains in which every layer but the first has one left layer that has no other
+    // right layer. the branches are in topological order, their layers too, branch b has the layers m_branches[b]
+    // and the steps [m_branch_steps[b], m_branch_steps[b + 1])
+    std::vector<std::vector<u32>> m_branches;
+    std::vector<u32> m_branch_steps;
+    // between branches, backward is forward with the edges reversed
+    task_graph m_forward_graph, m_backward_graph;
+    // (connection, layer index) of the left layers of every layer in topological order and of the right layers in
+    // reverse topological order, the order in which their contributions are summed
+    std::vector<std::vector<std::pair<u32, u32>>> m_lefts, m_rights;
+};
+
+/**
+ * training with train_class / train_target is split in minibatches of batch_size() samples. every sample takes a slot
+ * with an atomic ticket, the slots of a minibatch are summed by a tree reduction: the second of two sibling slots to
+ * finish adds the other one into the lower slot and moves up, so the sums run in parallel on the threads that finish
+ * their samples and the last one applies the update.
+ * the weights and biases are double buffered: the update of minibatch g writes the back buffers while the samples of
+ * minibatch g + 1 already run on the front buffers, so the gradients are at most one minibatch stale. the slots and
+ * counters are kept for two minibatches, minibatch g + 2 waits until g is applied
+ */
 class network {
 private:
 
 #if defined(OMP)
-    omp_lock_t m_lock_batch;
-    void lock_batch() { omp_set_lock(&m_lock_batch); }
-    void unlock_batch() { omp_unset_lock(&m_lock_batch); }
-    void init_lock() { omp_init_lock(&m_lock_batch); }
-    void destroy_lock() { omp_destroy_lock(&m_lock_batch); }
     u32 thread_num() { return omp_get_thread_num(); }
 #else
-    void lock_batch() {}
-    void unlock_batch() {}
-    void init_lock() {}
-    void destroy_lock() {}
     u32 thread_num() { return 0; }
 #endif
 
@@ -52,12 +74,36 @@ public:
 
     std::unordered_map<std::string, u32> m_layer_id;  
     std::vector<std::pair<std::string, std::string>> m_edge_list;
+    // the weights can be written directly. fully_connected layers built with the sparse option keep a transpose of
+    // theirs, with those call weights_changed() after writing them, between the writes and the next forward
     std::vector<tensor*> m_connections; 
+    // index of the solver state of every connection and of the biases of every layer
+    std::vector<u32> m_connection_states;
+    std::vector<u32> m_bias_states;
+    u32 m_nr_states = 0;
 
     std::vector<std::vector<layer_base*>> m_network_copies;
     std::vector<std::vector<tensor>> m_delta_weights_copies; 
     std::vector<std::vector<tensor>> m_delta_biases_copies; 
-    std::vector<u8> m_batch_statuses;
+    std::vector<tensor> m_batch_delta_weights;
+    std::vector<tensor> m_batch_delta_biases;
+    std::vector<forward_plan> m_plans;
+    std::unique_ptr<task_graph_pool> m_branch_pool;
+    std::atomic<u64> m_weights_version{0};
+    // files whose mapped memory is used by the weights
+    std::vector<std::unique_ptr<util::mapped_file>> m_mappings;
+
+    // back buffers of m_connections, allocated by the first update, and the front and back biases of all layers,
+    // swapped by every update
+    std::vector<tensor*> m_back_connections;
+    std::array<std::vector<tensor>, 2> m_master_biases;
+    // number of minibatch updates applied since start_epoch and the generation each copy has loaded
+    std::atomic<u64> m_next_ticket{0};
+    std::atomic<u64> m_published{0};
+    std::vector<u64> m_copy_generation;
+    std::vector<u64> m_slot_generation;
+    std::unique_ptr<std::atomic<u32>[]> m_tree_counters;
+    u32 m_tree_size;
 
 
     network(std::string solver = nullptr): m_output_size(0), m_nr_threads(1) { 
@@ -65,14 +111,15 @@ public:
         m_cost_f = nullptr;
         m_solver = create_solver(solver);
         m_network_copies.resize(1);
-        m_delta_weights_copies.resize(m_batch_size);
-        m_delta_biases_copies.resize(m_batch_size);
-        m_batch_statuses.resize(m_batch_size);
+        m_plans.resize(1);
+        set_batch_size(m_batch_size);
         m_current_epoch = 0; 
         m_nr_epochs = 1000;
     }
 
-    ~network() { destroy_lock(); }
+    ~network() {
+        for (auto connection: m_back_connections) delete connection;
+    }
 
     u32 output_size() { return m_output_size; }
 
@@ -89,9 +136,24 @@ public:
         u32 cur_nr_batches = (u32)m_network_copies.size();
         if (cur_nr_batches < m_nr_threads) m_network_copies.resize(m_nr_threads);
         // (cur_nr_bathces > m_nr_threads) ?
+
+        // new copies of a network that is already built get its layers and connections
+        for (u32 i = cur_nr_batches; i < (u32)m_network_copies.size(); i++) {
+            for (auto layer: m_network_copies[MAIN_COPY])
+                m_network_copies[i].push_back(create_layer(layer->m_name, layer->config_string()));
+            for (u32 j = 0; j < (u32)m_edge_list.size(); j++)
+                delete m_network_copies[i][m_layer_id[m_edge_list[j].second]]->create_connection(*m_network_copies[i][m_layer_id[m_edge_list[j].first]], j);
+        }
+
+        m_copy_generation.assign(m_network_copies.size(), std::numeric_limits<u64>::max());
         sync_network_copies();
+        compile();
     }
 
+    /**
+     * one network copy per thread, 0 for one per core. with OMP the copy of a sample is the OpenMP thread number,
+     * without it callers that run their own threads pass the copy_id to train_class / train_target and forward
+     */
     void enable_threads(u32 nr_threads = 0) {
 #if defined(OMP)
         if (!nr_threads) nr_threads = omp_get_num_procs();
@@ -99,8 +161,8 @@ public:
         omp_set_nested(1);
         omp_set_num_threads(m_nr_threads);
 #else
-        if (nr_threads > 1) throw std::runtime_error("Define OpenMP for threading");
-        m_nr_threads = 1;
+        if (!nr_threads) nr_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        m_nr_threads = nr_threads;
 #endif
         create_network_copies();
     }
@@ -114,12 +176,17 @@ public:
 
         layer_base *layer = create_layer(name, build);
         m_network_copies[MAIN_COPY].push_back(layer);
+        if (m_solver && layer->uses_biases())
+            m_solver->push_back(layer->m_biases.m_rows, layer->m_biases.m_cols, layer->m_biases.m_channels, false);
+        m_bias_states.push_back(m_solver && layer->uses_biases() ? m_nr_states++ : 0);
 
         m_output_size = layer->m_nodes.m_rows * layer->m_nodes.m_cols * layer->m_nodes.m_channels;
 
         for(u32 i = 1; i < (u32)m_network_copies.size(); i++) 
             m_network_copies[i].push_back(create_layer(name, build));
 
+        compile();
+
         return true;
     }
 
@@ -135,6 +202,11 @@ public:
         u32 connection_index = (u32)m_connections.size();
         tensor *connection = right_layer->create_connection(*left_layer, connection_index);
         m_connections.push_back(connection);
+        // allocated by the first update, networks that only infer don't need them
+        m_back_connections.push_back(nullptr);
+        // the size of a layer can depend on its inputs
+        const tensor &output = m_network_copies[MAIN_COPY].back()->m_nodes;
+        m_output_size = output.m_rows * output.m_cols * output.m_channels;
 
         for(u32 i = 1; i < (u32)m_network_copies.size(); i++) {
             left_layer = m_network_copies[i][left_index];
@@ -146,8 +218,145 @@ public:
             if(connection) m_solver->push_back(connection->m_rows, connection->m_cols, connection->m_channels);
             else m_solver->push_back(1, 1, 1);
         }
+        m_connection_states.push_back(m_solver ? m_nr_states++ : 0);
 
         if(connection) connection->fill(1);
+
+        compile();
+    }
+
+    /**
+     * compiles the forward pass of every copy into a forward_plan: the layers in topological order, each with the
+     * pushes from its left layers followed by its activation, grouped in branches. the first push into a layer
+     * overwrites its nodes, so forward doesn't zero anything and runs without rtti or virtual calls into the layers.
+     * called whenever the network changes
+     */
+    void compile() {
+        weights_changed();
+        m_plans.resize(m_network_copies.size());
+        for (u32 i = 0; i < (u32)m_network_copies.size(); i++)
+            compile(i);
+    }
+
+    void compile(const u32 copy_id) {
+        const std::vector<layer_base*> &layers = m_network_copies[copy_id];
+        forward_plan &plan = m_plans[copy_id];
+        plan = forward_plan();
+        if (layers.empty()) return;
+
+        // kahn's algorithm, among the ready layers the one pushed back first goes first
+        std::vector<u32> in_degree(layers.size()), order;
+        std::priority_queue<u32, std::vector<u32>, std::greater<u32>> ready;
+        for (u32 i = 0; i < (u32)layers.size(); i++) {
+            in_degree[i] = (u32)layers[i]->m_backward_connections.size();
+            if (!in_degree[i]) ready.push(i);
+        }
+        while (!ready.empty()) {
+            const u32 index = ready.top();
+            ready.pop();
+            order.push_back(index);
+            for (auto &i: layers[index]->m_forward_connections)
+                if (!--in_degree[m_layer_id[i.second->m_name]]) ready.push(m_layer_id[i.second->m_name]);
+        }
+        if (order.size() != layers.size())
+            throw std::runtime_error("network has a cycle");
+
+        std::vector<u32> position(layers.size());
+        for (u32 i = 0; i < (u32)order.size(); i++) position[order[i]] = i;
+        plan.m_lefts.resize(layers.size());
+        plan.m_rights.resize(layers.size());
+        for (u32 i = 0; i < (u32)layers.size(); i++) {
+            for (auto &j: layers[i]->m_backward_connections) plan.m_lefts[i].push_back({j.first, m_layer_id[j.second->m_name]});
+            for (auto &j: layers[i]->m_forward_connections) plan.m_rights[i].push_back({j.first, m_layer_id[j.second->m_name]});
+            std::sort(plan.m_lefts[i].begin(), plan.m_lefts[i].end(),
+                      [&](auto &a, auto &b) { return position[a.second] < position[b.second]; });
+            std::sort(plan.m_rights[i].begin(), plan.m_rights[i].end(),
+                      [&](auto &a, auto &b) { return position[a.second] > position[b.second]; });
+        }
+
+        // a layer continues the branch of its left layer if it is that layer's only right layer
+        std::vector<u32> branch_of(layers.size());
+        for (u32 index: order) {
+            const auto &lefts = plan.m_lefts[index];
+            if (lefts.size() == 1 && plan.m_rights[lefts[0].second].size() == 1) {
+                branch_of[index] = branch_of[lefts[0].second];
+            } else {
+                branch_of[index] = (u32)plan.m_branches.size();
+                plan.m_branches.emplace_back();
+            }
+            plan.m_branches[branch_of[index]].push_back(index);
+        }
+
+        const u32 nr_branches = (u32)plan.m_branches.size();
+        plan.m_forward_graph.resize(nr_branches);
+        plan.m_backward_graph.resize(nr_branches);
+        for (u32 b = 0; b < nr_branches; b++)
+            for (auto &left: plan.m_lefts[plan.m_branches[b].front()]) {
+                const u32 dependency = branch_of[left.second];
+                auto &dependents = plan.m_forward_graph.m_dependents[dependency];
+                if (std::find(dependents.begin(), dependents.end(), b) != dependents.end()) continue;
+                plan.m_forward_graph.add_dependency(b, dependency);
+                plan.m_backward_graph.add_dependency(dependency, b);
+            }
+
+        for (u32 i = 0; i < (u32)layers.size(); i++) {
+            // the padding of the nodes is never written by the kernels
+            layers[i]->m_nodes.fill(0.f);
+            if (dynamic_cast<input_layer*>(layers[i]) != nullptr)
+                plan.m_inputs.push_back({layers[i]->m_nodes.m_ptr, layers[i]->m_nodes.size()});
+        }
+
+        for (auto &branch: plan.m_branches) {
+            plan.m_branch_steps.push_back((u32)plan.m_steps.size());
+            for (u32 index: branch) {
+                layer_base *layer = layers[index];
+                bool written = dynamic_cast<input_layer*>(layer) != nullptr;
+                for (auto &[connection, left]: plan.m_lefts[index]) {
+                    const forward_step push = layer->push_forward_step(*layers[left], connection, !written);
+                    if (push.m_kernel) {
+                        plan.m_steps.push_back(push);
+                        written = true;
+                    }
+                }
+                if (!written) {
+                    forward_step zero;
+                    zero.m_kernel = layer_base::zero_kernel;
+                    zero.m_out = layer->m_nodes.m_ptr;
+                    zero.m_rows = layer->m_nodes.size();
+                    plan.m_steps.push_back(zero);
+                }
+
+                const forward_step activation = layer->activate_step();
+                if (activation.m_kernel) plan.m_steps.push_back(activation);
+            }
+        }
+        plan.m_branch_steps.push_back((u32)plan.m_steps.size());
+        for (auto &step: plan.m_steps) step.m_weights_version = &m_weights_version;
+
+        plan.m_output = layers.back()->m_nodes.m_ptr;
+    }
+
+    /**
+     * runs independent branches of the network on nr_threads threads (counting the caller) in forward, forward_batch,
+     * backpropogation and train_batch, 0 for one per core. worth it for wide branches like the heads of a policy /
+     * value net, the per-thread copies of train_class / train_target share the threads, a copy that finds them busy
+     * runs its branches itself. 1 turns it off
+     */
+    void enable_branch_threads(u32 nr_threads = 0) {
+        if (!nr_threads) nr_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        m_branch_pool = nr_threads > 1 ? std::make_unique<task_graph_pool>(nr_threads) : nullptr;
+    }
+
+    // run(b) for every branch b of the plan of copy_id after the branches it depends on
+    template<class F>
+    void run_branches(const u32 copy_id, const bool backward, F &&run) {
+        const forward_plan &plan = m_plans[copy_id];
+        const task_graph &graph = backward ? plan.m_backward_graph : plan.m_forward_graph;
+        if (m_branch_pool && graph.parallel() && m_branch_pool->try_run(graph, std::function<void(u32)>(run)))
+            return;
+        const u32 nr_branches = (u32)plan.m_branches.size();
+        for (u32 b = 0; b < nr_branches; b++)
+            run(backward ? nr_branches - 1 - b : b);
     }
 
     void connect() {	
@@ -160,39 +369,71 @@ public:
         return -1;
     }
 
-    f32 *forward(const f32 *input, i32 copy_id = -1, u32 training=0) {
+    f32 *forward(const f32 *input, i32 copy_id = -1, [[maybe_unused]] u32 training=0) {
         if(copy_id < 0) copy_id = thread_num();
         if (copy_id > (i32)m_nr_threads && m_nr_threads > 0)
             throw std::runtime_error("threading error\n");
         if (copy_id >= (i32)m_network_copies.size())
             throw std::runtime_error("threading error\n");
 
-        std::vector<layer_base*> inputs;
-        for(auto layer: m_network_copies[copy_id]) {
-            if (dynamic_cast<input_layer*>(layer) != nullptr) inputs.push_back(layer);
-            layer->m_nodes.fill(0.f);
-        }
-
-        const f32 *input_copy = input;
+        load_generation(copy_id);
+        const std::vector<tensor*> &connections = connections_of(copy_id);
+        const forward_plan &plan = m_plans[copy_id];
 
-        for(auto layer: inputs) {
-            std::memcpy(layer->m_nodes.m_ptr, input_copy, sizeof(f32) * layer->m_nodes.size());
-            input_copy += layer->m_nodes.size();
+        for (auto &[nodes, size]: plan.m_inputs) {
+            std::memcpy(nodes, input, sizeof(f32) * size);
+            input += size;
         }
 
-        for(auto layer: m_network_copies[copy_id]) {
-            layer->activate(); 
+        run_branches(copy_id, false, [&](const u32 b) {
+            for (u32 i = plan.m_branch_steps[b]; i < plan.m_branch_steps[b + 1]; i++) {
+                const forward_step &step = plan.m_steps[i];
+                const tensor *weights = step.m_connection < connections.size() ? connections[step.m_connection] : nullptr;
+                step.m_kernel(step, weights ? weights->m_ptr : nullptr);
+            }
+        });
+
+        return plan.m_output;
+    }
 
-            for(auto &i: layer->m_forward_connections) {
-                u32 connection_index = i.first; 
-                layer_base *right_layer = i.second;
+    // forward pass of a whole minibatch, input holds batch samples after each other, returns batch rows of output_size()
+    f32 *forward_batch(const f32 *input, const u32 batch, i32 copy_id = -1) {
+        if(copy_id < 0) copy_id = thread_num();
+        if (copy_id >= (i32)m_network_copies.size())
+            throw std::runtime_error("threading error\n");
 
-                right_layer->push_forward(*layer, *m_connections[connection_index], training);
+        std::vector<layer_base*> inputs;
+        u32 input_size = 0;
+        for(auto layer: m_network_copies[copy_id]) {
+            const u32 size = layer->m_nodes.m_rows * layer->m_nodes.m_cols * layer->m_nodes.m_channels;
+            layer->m_batch_nodes.resize(batch, size, 1);
+            layer->m_batch_nodes.fill(0.f);
+            if (dynamic_cast<input_layer*>(layer) != nullptr) {
+                inputs.push_back(layer);
+                input_size += size;
             }
+        }
 
+        for (u32 i = 0; i < batch; i++) {
+            const f32 *input_copy = input + i * input_size;
+            for(auto layer: inputs) {
+                const u32 size = layer->m_nodes.m_rows * layer->m_nodes.m_cols * layer->m_nodes.m_channels;
+                std::memcpy(layer->m_batch_nodes.m_ptr + i * size, input_copy, sizeof(f32) * size);
+                input_copy += size;
+            }
         }
 
-        return m_network_copies[copy_id][m_network_copies[copy_id].size()-1]->m_nodes.m_ptr;
+        const forward_plan &plan = m_plans[copy_id];
+        const std::vector<layer_base*> &layers = m_network_copies[copy_id];
+        run_branches(copy_id, false, [&](const u32 b) {
+            for (u32 index: plan.m_branches[b]) {
+                for (auto &[connection, left]: plan.m_lefts[index])
+                    layers[index]->push_forward_batch(*layers[left], *m_connections[connection], batch);
+                layers[index]->activate_batch(batch);
+            }
+        });
+
+        return m_network_copies[copy_id][m_network_copies[copy_id].size() - 1]->m_batch_nodes.m_ptr;
     }
 
     u32 arg_max(const f32 *output, const u32 size) {
@@ -211,105 +452,154 @@ public:
 
     u32 batch_size() { return m_batch_size; }
 
-    void reset_mini_batch() { 
-        m_batch_statuses.assign(m_batch_statuses.size(), BATCH_FREE);
-    }
-
     void set_batch_size(u32 batch_size) {
         m_batch_size = std::max(batch_size, (u32)1);
-        m_delta_weights_copies.resize(m_batch_size);
-        m_delta_biases_copies.resize(m_batch_size);
-        m_batch_statuses.resize(m_batch_size); 
+        m_delta_weights_copies.resize(2 * m_batch_size);
+        m_delta_biases_copies.resize(2 * m_batch_size);
+        m_slot_generation.resize(2 * m_batch_size);
+        m_tree_size = std::bit_ceil(m_batch_size);
+        m_tree_counters = std::make_unique<std::atomic<u32>[]>(2 * m_tree_size);
         reset_mini_batch();
     }
 
-    int next_free_batch() {
-        u32 reserved = 0;
-        u32 filled = 0;
-        for (u32 i = 0; i < (u32)m_batch_statuses.size(); i++) {
-            if (m_batch_statuses[i] == BATCH_FREE) return i;
-            if (m_batch_statuses[i] == BATCH_RESERVED) reserved++;
-            if (m_batch_statuses[i] == BATCH_COMPLETE) filled++;
-        }
-        if (reserved > 0) return BATCH_FILLED_IN_PROCESS; 
-        if (filled == m_batch_statuses.size()) return BATCH_FILLED_COMPLETE;
-
-        throw std::runtime_error("threading error"); 
+    // front weights and biases of the generation every copy works with, the main copy holds them between epochs
+    /**
+     * has to be called after the weights were changed by hand, kernels may keep copies of them until then.
+     * start_epoch, the training functions and read do it themselves
+     */
+    void weights_changed() {
+        m_weights_version.fetch_add(1, std::memory_order_release);
     }
 
-    void sync_mini_batch() {
-        i8 next = next_free_batch();
-        if (next == BATCH_FILLED_IN_PROCESS) throw std::runtime_error("thread locked");
-
-        u32 nr_layers = (u32)m_network_copies[MAIN_COPY].size();
-
-        // sum contributions in delta weights and delta biases
-        layer_base *layer;
-        for (i32 i = (i32)nr_layers - 1; i >= 0; i--) {
-            layer = m_network_copies[MAIN_COPY][i];
+    void reset_mini_batch() {
+        weights_changed();
+        m_next_ticket = 0;
+        m_published = 0;
+        for (u32 i = 0; i < 2 * m_tree_size; i++) m_tree_counters[i] = 0;
+        m_copy_generation.assign(m_network_copies.size(), std::numeric_limits<u64>::max());
+        for (auto &biases: m_master_biases) {
+            biases.resize(m_network_copies[MAIN_COPY].size());
+            for (u32 i = 0; i < (u32)biases.size(); i++)
+                biases[i] = m_network_copies[MAIN_COPY][i]->m_biases;
+        }
+    }
 
-            for(auto &j: layer->m_backward_connections) {
-                u32 connection_index = (u32)j.first;
+    const std::vector<tensor*> &connections_of(const u32 copy_id) {
+        return m_copy_generation[copy_id] != std::numeric_limits<u64>::max() && (m_copy_generation[copy_id] & 1) ? m_back_connections : m_connections;
+    }
 
-                if (m_batch_statuses[MAIN_COPY] == BATCH_FREE) 
-                    m_delta_weights_copies[MAIN_COPY][connection_index].fill(0);
+    // biases of the newest applied update into a copy
+    void load_generation(const u32 copy_id) {
+        if (m_master_biases[0].size() != m_network_copies[copy_id].size()) return;
+        const u64 generation = m_published.load(std::memory_order_acquire);
+        if (m_copy_generation[copy_id] == generation) return;
+        for (u32 i = 0; i < (u32)m_network_copies[copy_id].size(); i++)
+            if (m_network_copies[copy_id][i]->uses_biases())
+                m_network_copies[copy_id][i]->m_biases = m_master_biases[generation & 1][i];
+        m_copy_generation[copy_id] = generation;
+    }
 
-                for (u32 k = 1; k < m_batch_size; k++) 
-                    if (m_batch_statuses[k] == BATCH_COMPLETE) 
-                        m_delta_weights_copies[MAIN_COPY][connection_index] += m_delta_weights_copies[k][connection_index];
-            }
+    /**
+     * minibatch generation with the summed gradients in slot, only called once generation - 1 is applied. runs on the
+     * thread that finished the minibatch while the others already train on the front buffers, so it stays serial
+     */
+    void apply_update(const u32 slot, const u64 generation) {
+        // no sample has used a back buffer before the first update is published
+        for (u32 i = 0; i < (u32)m_connections.size(); i++)
+            if (m_connections[i] && !m_back_connections[i]) m_back_connections[i] = new tensor(*m_connections[i]);
+        const std::vector<tensor*> &front = generation & 1 ? m_back_connections : m_connections;
+        const std::vector<tensor*> &back = generation & 1 ? m_connections : m_back_connections;
+        for (u32 i = 0; i < (u32)m_connections.size(); i++) {
+            if (!front[i]) continue;
+            if (m_delta_weights_copies[slot].size() > i && m_delta_weights_copies[slot][i].size())
+                m_solver->update_weights_from(*front[i], back[i], m_connection_states[i], m_delta_weights_copies[slot][i]);
+            else
+                *back[i] = *front[i];
+        }
 
-            //if (dynamic_cast<convolution_layer*> (layer) != NULL)  continue;
+        std::vector<tensor> &front_biases = m_master_biases[generation & 1], &back_biases = m_master_biases[(generation + 1) & 1];
+        for (u32 i = 0; i < (u32)front_biases.size(); i++) {
+            if (m_network_copies[MAIN_COPY][i]->uses_biases() && m_delta_biases_copies[slot].size() > i && m_delta_biases_copies[slot][i].size())
+                m_solver->update_weights_from(front_biases[i], &back_biases[i], m_bias_states[i], m_delta_biases_copies[slot][i]);
+            else
+                back_biases[i] = front_biases[i];
+        }
+        weights_changed();
+    }
 
-            if (m_batch_statuses[MAIN_COPY] == BATCH_FREE) 
-                m_delta_biases_copies[MAIN_COPY][i].fill(0);
+    void add_slot(const u32 dst, const u32 src) {
+        for (u32 i = 0; i < (u32)m_delta_weights_copies[src].size(); i++)
+            if (m_delta_weights_copies[src][i].size()) m_delta_weights_copies[dst][i] += m_delta_weights_copies[src][i];
+        for (u32 i = 0; i < (u32)m_delta_biases_copies[src].size(); i++)
+            if (m_delta_biases_copies[src][i].size()) m_delta_biases_copies[dst][i] += m_delta_biases_copies[src][i];
+    }
 
-            for (u32 j = 1; j < m_batch_size; j++) 
-                if (m_batch_statuses[j] == BATCH_COMPLETE) 
-                    m_delta_biases_copies[MAIN_COPY][i] += m_delta_biases_copies[j][i];
+    // tree reduction of the minibatch of slot, the thread that completes the root applies the update
+    void finish_slot(const u32 slot) {
+        const u32 half = slot >= m_batch_size;
+        const u32 offset = half * m_batch_size;
+        const u64 generation = m_slot_generation[slot];
+        u32 index = slot - offset;
+        for (u32 level = 0; (1u << level) < m_batch_size; level++) {
+            const u32 step = 1u << level;
+            // a left node without right sibling moves up alone
+            if (!(index & step) && index + step >= m_batch_size) continue;
+            std::atomic<u32> &counter = m_tree_counters[half * m_tree_size + (m_tree_size >> (level + 1)) + (index >> (level + 1))];
+            if (counter.fetch_add(1, std::memory_order_acq_rel) == 0) return;
+            counter.store(0, std::memory_order_relaxed);
+            index &= ~step;
+            add_slot(offset + index, offset + index + step);
         }
 
-        // update weights and add delta biases to main copy 
-        for (i32 i = nr_layers - 1; i >= 0; i--) {
-            layer = m_network_copies[MAIN_COPY][i];
-
-            for(auto &j: layer->m_backward_connections) {
-                u32 connection_index = (u32)j.first;
-                if (m_delta_weights_copies[MAIN_COPY][connection_index].size())
-                    if(m_connections[connection_index]) 
-                        m_solver->update_weights(m_connections[connection_index], connection_index, m_delta_weights_copies[MAIN_COPY][connection_index]);
+        while (m_published.load(std::memory_order_acquire) != generation) std::this_thread::yield();
+        apply_update(offset, generation);
+        m_published.store(generation + 1, std::memory_order_release);
+    }
 
-            }
+    /**
+     * finishes the tree reduction of a minibatch with only its first filled slots done: afterwards slot offset + index
+     * holds the sum of the filled slots of its subtree at level. finish_slot has summed the subtrees that are filled
+     * completely already, and none of the partly filled ones, whose right children are added here
+     */
+    void reduce_partial(const u32 offset, const u32 index, const u32 level, const u32 filled) {
+        if (!level || std::min(index + (1u << level), m_batch_size) <= filled) return;
+        const u32 half = 1u << (level - 1);
+        reduce_partial(offset, index, level - 1, filled);
+        if (index + half >= filled) return;
+        reduce_partial(offset, index + half, level - 1, filled);
+        add_slot(offset + index, offset + index + half);
+    }
 
-            layer->update_biases(m_delta_biases_copies[MAIN_COPY][i], m_solver->m_learning_rate);
+    // applies a partly filled minibatch and moves the front buffers into the main copy, no sample may be running
+    void sync_mini_batch() {
+        const u64 ticket = m_next_ticket;
+        const u64 generation = ticket / m_batch_size;
+        const u32 filled = (u32)(ticket % m_batch_size);
+        const u32 offset = (generation & 1) * m_batch_size;
+        if (filled && m_solver) {
+            reduce_partial(offset, 0, (u32)std::countr_zero(m_tree_size), filled);
+            apply_update(offset, generation);
+            m_published = generation + 1;
         }
 
-        reset_mini_batch();
+        const u64 published = m_published;
+        if (published & 1) std::swap(m_connections, m_back_connections);
+        for (u32 i = 0; i < (u32)m_master_biases[published & 1].size(); i++)
+            if (m_network_copies[MAIN_COPY][i]->uses_biases())
+                m_network_copies[MAIN_COPY][i]->m_biases = m_master_biases[published & 1][i];
+
         sync_network_copies();
+        reset_mini_batch();
     }
 
+    // claims the next slot, waits while the minibatch before the previous one is being applied
     i32 reserve_next_batch() {
-        lock_batch();
-        i32 index = -3;
-        while (index < 0) {
-            index = next_free_batch();
-            if (index >= 0) { 
-                m_batch_statuses[index] = BATCH_RESERVED;
-                unlock_batch();
-                return index;
-            }
-            else if (index == BATCH_FILLED_COMPLETE) { 
-                sync_mini_batch(); 
-                index = next_free_batch();
-                m_batch_statuses[index] = BATCH_RESERVED;
-                unlock_batch();
-                return index;
-            }
-            unlock_batch();
-            usleep(1 * 1000);
-            lock_batch();
-        }
-        return -3;
+        const u64 ticket = m_next_ticket.fetch_add(1, std::memory_order_relaxed);
+        const u64 generation = ticket / m_batch_size;
+        while (m_published.load(std::memory_order_acquire) + 1 < generation) std::this_thread::yield();
+        const u32 slot = (u32)((generation & 1) * m_batch_size + ticket % m_batch_size);
+        m_slot_generation[slot] = generation;
+        return (i32)slot;
     }
 
     f32 learning_rate() {
@@ -339,6 +629,7 @@ public:
         m_cost_f = create_cost(cost_function);
 
         if (!m_current_epoch) reset_solver();
+        reset_mini_batch();
     }
 
     bool over() {
@@ -354,52 +645,37 @@ public:
         return over();
     }
 
+    // every layer pulls the deltas of its right layers, then its delta is final and gives its gradients
     void backpropogation(const u32 batch_index, const u32 copy_id) {
-        const u32 nr_layers = (u32)m_network_copies[copy_id].size();
-
-        layer_base *layer;
-        for (i32 i = nr_layers - 1; i >= 0; i--) {
-            layer = m_network_copies[copy_id][i];
-            u32 layer_size = layer->m_nodes.size();
+        const std::vector<layer_base*> &layers = m_network_copies[copy_id];
+        const forward_plan &plan = m_plans[copy_id];
+        const std::vector<tensor*> &connections = connections_of(copy_id);
+        const u32 nr_layers = (u32)layers.size();
 
-            if (i < (i32)nr_layers - 1)
-                for (u32 j = 0; j < layer_size; j++)
-                    layer->m_delta.m_ptr[j] *= layer->df(layer->m_nodes.m_ptr, (u32)j);
-
-            for(auto &j: layer->m_backward_connections) {
-                layer_base *left_layer = j.second;
-                layer->propogate_delta(*left_layer, *m_connections[j.first]);
-            }
-        }
-
-        u32 nr_connections = (u32)m_connections.size();
-        m_delta_weights_copies[batch_index].resize(nr_connections);
+        m_delta_weights_copies[batch_index].resize(m_connections.size());
         m_delta_biases_copies[batch_index].resize(nr_layers);
 
-        for (i32 i = nr_layers - 1; i >= 0; i--) {
-            layer = m_network_copies[copy_id][i];
+        run_branches(copy_id, true, [&](const u32 b) {
+            const std::vector<u32> &branch = plan.m_branches[b];
+            for (auto index = branch.rbegin(); index != branch.rend(); index++) {
+                layer_base *layer = layers[*index];
+                // the gradient of a connection is taken together with its delta, when its left layer pulls it
+                const auto &rights = plan.m_rights[*index];
+                const bool uses_df = *index < nr_layers - 1;
+                for (u32 r = 0; r < rights.size(); r++) {
+                    const auto &[connection, right] = rights[r];
+                    layers[right]->backpropogate(*layer, *connections[connection],
+                                                 m_delta_weights_copies[batch_index][connection],
+                                                 uses_df && r + 1 == rights.size());
+                }
+                if (uses_df && rights.empty())
+                    layer->df(layer->m_nodes.m_ptr, layer->m_delta.m_ptr, layer->m_nodes.size());
 
-            for(auto &j: layer->m_backward_connections) {
-                layer_base *left_layer = j.second;
-                u32 connection_index = (u32)j.first;
-                
-                //if (dynamic_cast<max_pooling_layer*> (layer) != NULL)  continue;
-                
-                layer->calculate_delta_weights(*left_layer, m_delta_weights_copies[batch_index][connection_index]);
+                layer->calculate_delta_biases(m_delta_biases_copies[batch_index][*index]);
             }
-            //if (dynamic_cast<convolution_layer*> (layer) != NULL)  continue;
+        });
 
-            m_delta_biases_copies[batch_index][i] = layer->m_delta;
-        }
-
-        lock_batch();
-
-        m_batch_statuses[batch_index] = BATCH_COMPLETE;
-        i32 next_index = next_free_batch();
-        if (next_index == BATCH_FILLED_COMPLETE) 
-            sync_mini_batch(); 
-                               
-        unlock_batch();
+        finish_slot(batch_index);
     }
 
     tensor make_input(f32 *input, const u32 copy_id) { 
@@ -423,7 +699,8 @@ public:
     bool train_class(f32 *in, u32 label_index, i32 copy_id = -1) {
         if (m_solver == nullptr) throw std::runtime_error("set solver");
         if (copy_id < 0) copy_id = thread_num();
-        if (copy_id > (i32)m_nr_threads) throw std::runtime_error("out of bounds thread");
+        // before taking a slot, a slot that is never finished blocks every later minibatch
+        if (copy_id >= (i32)m_network_copies.size()) throw std::runtime_error("out of bounds thread");
 
         f32 *input = in;
 
@@ -458,8 +735,9 @@ public:
             if(cost_activation_type)
                 layer->m_delta.m_ptr[i] = cost_activation_type * (layer->m_nodes.m_ptr[i] - target[i]);
             else
-                layer->m_delta.m_ptr[i] = m_cost_f->cost_d(layer->m_nodes.m_ptr[i], target[i]) * layer->df(layer->m_nodes.m_ptr, i);
+                layer->m_delta.m_ptr[i] = m_cost_f->cost_d(layer->m_nodes.m_ptr[i], target[i]);
         }
+        if (!cost_activation_type) layer->df(layer->m_nodes.m_ptr, layer->m_delta.m_ptr, size);
 
         backpropogation(batch_index, copy_id);
 
@@ -470,9 +748,7 @@ public:
     bool train_target(f32 *in, f32 *target, i32 positive = 1, i32 copy_id = -1) {
         if (m_solver == NULL) throw std::runtime_error("set solver");
         if (copy_id < 0) copy_id = thread_num();
-        if (copy_id > (i32)m_nr_threads) throw std::runtime_error("need to enable OMP");
-
-        tensor input = make_input(in, copy_id);
+        if (copy_id >= (i32)m_network_copies.size()) throw std::runtime_error("out of bounds thread");
 
         i32 batch_index = reserve_next_batch();
         if (batch_index < 0) return false;
@@ -498,21 +774,89 @@ public:
                 if (cost_activation_type > 0)
                     layer->m_delta.m_ptr[i] = cost_activation_type * (layer->m_nodes.m_ptr[i] - target[i]);
                 else
-                    layer->m_delta.m_ptr[i] = m_cost_f->cost_d(layer->m_nodes.m_ptr[i], target[i]) * layer->df(layer->m_nodes.m_ptr, i);
+                    layer->m_delta.m_ptr[i] = m_cost_f->cost_d(layer->m_nodes.m_ptr[i], target[i]);
             }
             else {
                 if (cost_activation_type > 0)
                     layer->m_delta.m_ptr[i] = cost_activation_type * (1.f - abs(layer->m_nodes.m_ptr[i] - target[i]));
                 else
-                    layer->m_delta.m_ptr[i] = (1.f - abs(m_cost_f->cost_d(layer->m_nodes.m_ptr[i], target[i]))) * layer->df(layer->m_nodes.m_ptr, i);
+                    layer->m_delta.m_ptr[i] = 1.f - abs(m_cost_f->cost_d(layer->m_nodes.m_ptr[i], target[i]));
             }
         }
+        if (cost_activation_type <= 0) layer->df(layer->m_nodes.m_ptr, layer->m_delta.m_ptr, size);
 
         backpropogation(batch_index, copy_id);
 
         return true;
     }
 
+    // one step of the solver on a whole minibatch, the gradients are summed over the batch like sync_mini_batch does
+    bool train_batch(const f32 *in, const f32 *target, const u32 batch, i32 copy_id = -1) {
+        if (m_solver == nullptr) throw std::runtime_error("set solver");
+        if (copy_id < 0) copy_id = thread_num();
+        if (m_next_ticket) sync_mini_batch();
+
+        forward_batch(in, batch, copy_id);
+
+        const u32 nr_layers = (u32)m_network_copies[copy_id].size();
+        for(auto layer: m_network_copies[copy_id]) {
+            layer->m_batch_delta.resize(layer->m_batch_nodes.m_rows, layer->m_batch_nodes.m_cols, 1);
+            layer->m_batch_delta.fill(0.f);
+        }
+
+        layer_base *layer = m_network_copies[copy_id][nr_layers - 1];
+
+        f32 cost_activation_type = 0;
+        if (layer->m_f->m_name == "sigmoid" && m_cost_f->m_name == "cross_entropy") cost_activation_type = 1;
+        else if (layer->m_f->m_name == "softmax" && m_cost_f->m_name == "cross_entropy") cost_activation_type = 1;
+        else if (layer->m_f->m_name == "tanh" && m_cost_f->m_name == "cross_entropy") cost_activation_type = 4;
+
+        for (u32 i = 0; i < batch * m_output_size; i++) {
+            if (cost_activation_type > 0)
+                layer->m_batch_delta.m_ptr[i] = cost_activation_type * (layer->m_batch_nodes.m_ptr[i] - target[i]);
+            else
+                layer->m_batch_delta.m_ptr[i] = m_cost_f->cost_d(layer->m_batch_nodes.m_ptr[i], target[i]);
+        }
+        if (cost_activation_type <= 0) layer->df_batch(batch);
+
+        const forward_plan &plan = m_plans[copy_id];
+        const std::vector<layer_base*> &layers = m_network_copies[copy_id];
+        run_branches(copy_id, true, [&](const u32 b) {
+            const std::vector<u32> &branch = plan.m_branches[b];
+            for (auto index = branch.rbegin(); index != branch.rend(); index++) {
+                for (auto &[connection, right]: plan.m_rights[*index])
+                    layers[right]->propogate_delta_batch(*layers[*index], *m_connections[connection], batch);
+                if (*index < nr_layers - 1) layers[*index]->df_batch(batch);
+            }
+        });
+
+        // the weights are only updated once every delta is propagated through them
+        m_batch_delta_weights.resize(m_connections.size());
+        m_batch_delta_biases.resize(nr_layers);
+        run_branches(copy_id, false, [&](const u32 b) {
+            for (u32 index: plan.m_branches[b]) {
+                for (auto &[connection, left]: plan.m_lefts[index]) {
+                    if (!m_connections[connection]) continue;
+                    layers[index]->calculate_delta_weights_batch(*layers[left], m_batch_delta_weights[connection], batch);
+                    m_solver->update_weights(m_connections[connection], m_connection_states[connection], m_batch_delta_weights[connection]);
+                }
+
+                if (!layers[index]->uses_biases()) continue;
+                layers[index]->calculate_delta_biases_batch(m_batch_delta_biases[index], batch);
+                m_solver->update_weights(&m_network_copies[MAIN_COPY][index]->m_biases, m_bias_states[index], m_batch_delta_biases[index]);
+            }
+        });
+
+        sync_network_copies();
+        reset_mini_batch();
+
+        return true;
+    }
+
+    bool train_batch(const minibatch &batch, i32 copy_id = -1) {
+        return train_batch(batch.m_inputs.m_ptr, batch.m_targets.m_ptr, batch.m_size, copy_id);
+    }
+
     std::string configuration() {
         std::string str;
         for (u32 i = 0; i < (u32)m_network_copies[MAIN_COPY].size(); i++) 
@@ -532,7 +876,8 @@ public:
         return str;
     }
 
-    bool write(std::ofstream& ofs, [[maybe_unused]] bool final = 0) {
+    // layers and edges, read back by read_topology
+    void write_topology(std::ostream &ofs) {
         u32 layer_cnt = (u32)m_network_copies[MAIN_COPY].size();
 
         ofs << "pinguml" << std::endl;
@@ -546,6 +891,10 @@ public:
         ofs << (u32)m_edge_list.size() << std::endl;
         for(u32 j = 0; j < (u32)m_edge_list.size(); j++)
             ofs << m_edge_list[j].first << std::endl << m_edge_list[j].second << std::endl;
+    }
+
+    bool write(std::ofstream& ofs, [[maybe_unused]] bool final = 0) {
+        write_topology(ofs);
 
         ofs << (u32)0 << std::endl;
 
@@ -573,6 +922,56 @@ public:
         return write(temp, final);
     }
 
+    /**
+     * the biases of the layers that use them, then the weights, in the order of the files. counts as a change of the
+     * weights, later writes through the pointers need weights_changed() like writes to m_connections
+     */
+    std::vector<tensor*> stored_tensors() {
+        weights_changed();
+        std::vector<tensor*> tensors;
+        for (auto layer: m_network_copies[MAIN_COPY])
+            if (layer->uses_biases()) tensors.push_back(&layer->m_biases);
+        for (auto connection: m_connections)
+            if (connection) tensors.push_back(connection);
+        return tensors;
+    }
+
+    // see network_file_header for the format
+    bool write_binary(const std::string &filename) {
+        std::ostringstream topology;
+        write_topology(topology);
+        const std::string config = topology.str();
+        const std::vector<tensor*> tensors = stored_tensors();
+
+        network_file_header header;
+        header.m_topology_offset = sizeof(header);
+        header.m_topology_size = config.size();
+        header.m_table_offset = network_file_header::aligned(header.m_topology_offset + header.m_topology_size);
+        header.m_nr_tensors = tensors.size();
+        header.m_data_offset = network_file_header::aligned(header.m_table_offset + tensors.size() * sizeof(network_file_header::entry));
+
+        std::vector<network_file_header::entry> table(tensors.size());
+        u64 offset = header.m_data_offset;
+        for (u32 i = 0; i < (u32)tensors.size(); i++) {
+            table[i] = {offset, tensors[i]->size()};
+            offset = network_file_header::aligned(offset + tensors[i]->size() * sizeof(f32));
+        }
+        header.m_data_size = offset - header.m_data_offset;
+
+        std::vector<std::byte> file(offset);
+        std::memcpy(file.data() + header.m_topology_offset, config.data(), config.size());
+        std::memcpy(file.data() + header.m_table_offset, table.data(), table.size() * sizeof(network_file_header::entry));
+        for (u32 i = 0; i < (u32)tensors.size(); i++)
+            std::memcpy(file.data() + table[i].m_offset, tensors[i]->m_ptr, tensors[i]->size() * sizeof(f32));
+        header.m_checksum = util::word_fnv_hash(std::span{file}.subspan(sizeof(header)));
+        std::memcpy(file.data(), &header, sizeof(header));
+
+        std::ofstream ofs(filename, std::ios::binary);
+        if (!ofs.is_open()) return false;
+        ofs.write(reinterpret_cast<const char*>(file.data()), (std::streamsize)file.size());
+        return ofs.good();
+    }
+
 
     std::string getcleanline(std::istream& ifs) {
         std::string s;
@@ -597,6 +996,34 @@ public:
         }
     }
 
+    // layers and edges as written by write_topology, after the number of layers
+    void read_topology(std::istream &ifs, const u32 nr_layers) {
+        std::string s;
+        std::string layer_name;
+        std::string layer_build;
+        for (u32 i = 0; i < (u32)nr_layers; i++) {
+            layer_name = getcleanline(ifs);
+            layer_build = getcleanline(ifs);
+            push_back(layer_name, layer_build);
+        }
+
+        i32 graph_count;
+        ifs >> graph_count;
+        getline(ifs, s); 
+        if (graph_count <= 0) {
+            connect();
+        }
+        else {
+            std::string layer_name1;
+            std::string layer_name2;
+            for (u32 i = 0; i < (u32)graph_count; i++) {
+                layer_name1 = getcleanline(ifs);
+                layer_name2 = getcleanline(ifs);
+                connect(layer_name1, layer_name2);
+            }
+        }
+    }
+
     bool read(std::istream &ifs) {
         if(!ifs.good()) return false;
         std::string s;
@@ -620,35 +1047,14 @@ public:
             connect();
 
             sync_network_copies();
+            reset_mini_batch();
 
             return true;
         }
         else
             nr_layers = std::stoi(s);
 
-        std::string layer_name;
-        std::string layer_build;
-        for (u32 i = 0; i < (u32)nr_layers; i++) {
-            layer_name = getcleanline(ifs);
-            layer_build = getcleanline(ifs);
-            push_back(layer_name, layer_build);
-        }
-
-        i32 graph_count;
-        ifs >> graph_count;
-        getline(ifs, s); 
-        if (graph_count <= 0) {
-            connect();
-        }
-        else {
-            std::string layer_name1;
-            std::string layer_name2;
-            for (u32 i = 0; i < (u32)graph_count; i++) {
-                layer_name1 = getcleanline(ifs);
-                layer_name2 = getcleanline(ifs);
-                connect(layer_name1, layer_name2);
-            }
-        }
+        read_topology(ifs, nr_layers);
 
         u32 binary;
         s = getcleanline(ifs); 
@@ -685,6 +1091,60 @@ public:
         }
 
         sync_network_copies();
+        reset_mini_batch();
+
+        return true;
+    }
+
+    /**
+     * reads a file of write_binary, throws if it isn't a valid one. with adopt the weights are used straight from a
+     * private mapping of the file: their pages are read when they are first used and only copied when they are
+     * trained, and the checksum isn't checked since that would read the whole file. otherwise everything is copied
+     * out of the mapping and the mapping is closed
+     */
+    bool read_binary(const std::string &filename, const bool adopt = false) {
+        auto file = std::make_unique<util::mapped_file>(filename, true);
+        const std::byte *data = file->data();
+        const u64 size = file->size();
+
+        network_file_header header;
+        if (size < sizeof(header))
+            throw std::runtime_error(filename + " is too small");
+        std::memcpy(&header, data, sizeof(header));
+        if (header.m_magic != network_file_header::MAGIC || header.m_version != network_file_header::VERSION ||
+            header.m_alignment != network_file_header::ALIGNMENT)
+            throw std::runtime_error(filename + " isn't a pinguml file of this version");
+        if (header.m_topology_offset + header.m_topology_size > size ||
+            header.m_table_offset + header.m_nr_tensors * sizeof(network_file_header::entry) > size ||
+            header.m_data_offset + header.m_data_size != size)
+            throw std::runtime_error(filename + " is truncated");
+        if (!adopt && util::word_fnv_hash(file->bytes().subspan(sizeof(header))) != header.m_checksum)
+            throw std::runtime_error(filename + " is corrupt");
+
+        std::istringstream topology(std::string(reinterpret_cast<const char*>(data + header.m_topology_offset), header.m_topology_size));
+        if (getcleanline(topology) != "pinguml")
+            throw std::runtime_error(filename + " has no topology");
+        read_topology(topology, (u32)std::stoi(getcleanline(topology)));
+
+        const std::vector<tensor*> tensors = stored_tensors();
+        if (tensors.size() != header.m_nr_tensors)
+            throw std::runtime_error(filename + " doesn't match its topology");
+        const u32 nr_biases = (u32)(tensors.size() - std::count_if(m_connections.begin(), m_connections.end(), [](tensor *connection) { return connection != nullptr; }));
+        for (u32 i = 0; i < (u32)tensors.size(); i++) {
+            network_file_header::entry entry;
+            std::memcpy(&entry, data + header.m_table_offset + i * sizeof(entry), sizeof(entry));
+            if (entry.m_size != tensors[i]->size() || entry.m_offset % network_file_header::ALIGNMENT ||
+                entry.m_offset < header.m_data_offset || entry.m_offset + entry.m_size * sizeof(f32) > size)
+                throw std::runtime_error(filename + " doesn't match its topology");
+
+            f32 *values = reinterpret_cast<f32*>(file->data() + entry.m_offset);
+            if (adopt && i >= nr_biases) tensors[i]->adopt(values);
+            else std::memcpy(tensors[i]->m_ptr, values, entry.m_size * sizeof(f32));
+        }
+        if (adopt) m_mappings.push_back(std::move(file));
+
+        sync_network_copies();
+        reset_mini_batch();
 
         return true;
     }
@@ -692,6 +1152,12 @@ public:
     bool read(std::string filename) {
         std::ifstream fs(filename.c_str(), std::ios::binary);
         if (fs.is_open()) {
+            std::array<char, 8> magic{};
+            fs.read(magic.data(), magic.size());
+            if (fs.gcount() == (std::streamsize)magic.size() && magic == network_file_header::MAGIC)
+                return read_binary(filename);
+            fs.clear();
+            fs.seekg(0);
             bool ret = read(fs);
             fs.close();
             return ret;
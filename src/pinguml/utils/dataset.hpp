@@ -0,0 +1,270 @@
+#pragma once
+
+#include "../../include.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "file.hpp"
+#include "tensor.hpp"
+
+namespace pinguml {
+
+/**
+ * binary shard of training samples, written by dataset_writer and streamed by dataset:
+ *  header, then at m_data_offset the samples after each other, every sample is m_input_size inputs (board planes
+ *  etc.) followed by m_target_size targets, all f32 in the byte order of the machine that wrote the file.
+ * there is no checksum, checking one would read the whole shard before the first sample is used
+ */
+struct dataset_file_header {
+    static constexpr std::array<char, 8> MAGIC{'p', 'i', 'n', 'g', 'd', 'a', 't', 'a'};
+    static constexpr u32 VERSION = 1;
+    static constexpr u32 ALIGNMENT = 64;
+
+    std::array<char, 8> m_magic = MAGIC;
+    u32 m_version = VERSION;
+    u32 m_input_size = 0;
+    u32 m_target_size = 0;
+    u32 m_reserved = 0;
+    u64 m_nr_samples = 0;
+    u64 m_data_offset = ALIGNMENT;
+
+    u64 sample_size() const { return (u64)m_input_size + m_target_size; }
+};
+
+class dataset_writer {
+private:
+    std::ofstream m_file;
+    dataset_file_header m_header;
+
+public:
+    dataset_writer(const std::string &filename, const u32 input_size, const u32 target_size)
+            : m_file(filename, std::ios::binary | std::ios::trunc) {
+        if (!m_file) throw std::runtime_error("can't open " + filename);
+        m_header.m_input_size = input_size;
+        m_header.m_target_size = target_size;
+        const std::vector<char> zeros(m_header.m_data_offset, 0);
+        m_file.write(zeros.data(), (std::streamsize)zeros.size());
+    }
+
+    dataset_writer(const dataset_writer &) = delete;
+    dataset_writer &operator=(const dataset_writer &) = delete;
+
+    ~dataset_writer() { close(); }
+
+    void write(const f32 *input, const f32 *target) {
+        m_file.write(reinterpret_cast<const char *>(input), (std::streamsize)(m_header.m_input_size * sizeof(f32)));
+        m_file.write(reinterpret_cast<const char *>(target), (std::streamsize)(m_header.m_target_size * sizeof(f32)));
+        m_header.m_nr_samples++;
+    }
+
+    // writes the header, nothing can be written afterwards
+    void close() {
+        if (!m_file.is_open()) return;
+        m_file.seekp(0);
+        m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header));
+        m_file.close();
+    }
+};
+
+// m_size samples, row i of m_inputs and m_targets belongs to sample i
+struct minibatch {
+    tensor m_inputs, m_targets;
+    u32 m_size = 0;
+};
+
+/**
+ * streams minibatches out of mapped shards. a reader thread draws the samples through a shuffle buffer of
+ * buffer_size samples, the shards are read in a random order and each of them from front to back, so the pages are
+ * read ahead by the kernel while the buffer mixes samples that are up to buffer_size apart. the reader builds the
+ * batches in nr_slots slots ahead of the trainer, next() hands out a slot until the next call, so the trainer only
+ * waits if reading and building a batch is slower than training on it.
+ * an epoch is one pass over all samples, the last batch of an epoch can be smaller than batch_size
+ */
+class dataset {
+private:
+    struct shard {
+        std::unique_ptr<util::mapped_file> m_file;
+        const f32 *m_samples;
+        u64 m_nr_samples;
+    };
+
+    std::vector<shard> m_shards;
+    u32 m_input_size = 0, m_target_size = 0;
+    u32 m_batch_size;
+    u64 m_nr_samples = 0;
+
+    // only used by the reader thread
+    std::vector<const f32 *> m_buffer;
+    u32 m_buffer_size;
+    std::vector<u32> m_order;
+    u32 m_shard = 0;
+    u64 m_sample = 0;
+    bool m_end_of_epoch = false;
+    std::mt19937_64 m_gen;
+
+    // ring of slots, the reader fills m_slots[m_write], the trainer holds m_slots[m_read] if m_holding
+    std::vector<minibatch> m_slots;
+    u32 m_write = 0, m_read = 0;
+    u32 m_filled = 0;
+    bool m_holding = false;
+    bool m_stop = false;
+    std::mutex m_mutex;
+    std::condition_variable m_space, m_ready;
+    std::thread m_reader;
+
+    void start_epoch() {
+        std::shuffle(m_order.begin(), m_order.end(), m_gen);
+        m_shard = 0;
+        m_sample = 0;
+    }
+
+    const f32 *next_in_order() {
+        while (m_shard < m_order.size() && m_sample == m_shards[m_order[m_shard]].m_nr_samples) {
+            m_shard++;
+            m_sample = 0;
+        }
+        if (m_shard == m_order.size()) return nullptr;
+        const shard &s = m_shards[m_order[m_shard]];
+        return s.m_samples + m_sample++ * (m_input_size + m_target_size);
+    }
+
+    // a random sample of the buffer, replaced by the next one of the epoch, nullptr once the epoch is drawn
+    const f32 *draw() {
+        while (m_buffer.size() < m_buffer_size) {
+            const f32 *sample = next_in_order();
+            if (!sample) break;
+            m_buffer.push_back(sample);
+        }
+        if (m_buffer.empty()) return nullptr;
+        const usize index = m_gen() % m_buffer.size();
+        const f32 *sample = m_buffer[index];
+        m_buffer[index] = m_buffer.back();
+        m_buffer.pop_back();
+        return sample;
+    }
+
+    // an empty batch marks the end of an epoch
+    void fill(minibatch &batch) {
+        batch.m_size = 0;
+        if (!m_end_of_epoch) {
+            batch.m_inputs.resize(m_batch_size, m_input_size, 1);
+            batch.m_targets.resize(m_batch_size, m_target_size, 1);
+            while (batch.m_size < m_batch_size) {
+                const f32 *sample = draw();
+                if (!sample) {
+                    m_end_of_epoch = true;
+                    break;
+                }
+                std::memcpy(batch.m_inputs.m_ptr + batch.m_size * m_input_size, sample, m_input_size * sizeof(f32));
+                std::memcpy(batch.m_targets.m_ptr + batch.m_size * m_target_size, sample + m_input_size,
+                            m_target_size * sizeof(f32));
+                batch.m_size++;
+            }
+            if (batch.m_size) return;
+        }
+        m_end_of_epoch = false;
+        start_epoch();
+    }
+
+    void read() {
+        while (true) {
+            {
+                std::unique_lock lock(m_mutex);
+                m_space.wait(lock, [&] { return m_filled < m_slots.size() || m_stop; });
+                if (m_stop) return;
+            }
+            // the trainer doesn't touch slots that aren't filled
+            fill(m_slots[m_write]);
+            {
+                std::lock_guard lock(m_mutex);
+                m_write = (m_write + 1) % (u32)m_slots.size();
+                m_filled++;
+            }
+            m_ready.notify_one();
+        }
+    }
+
+public:
+    dataset(const std::vector<std::string> &filenames, const u32 batch_size, const u32 buffer_size = 4096,
+            const u64 seed = 0, const u32 nr_slots = 3)
+            : m_batch_size(batch_size), m_buffer_size(std::max(buffer_size, 1u)), m_gen(seed),
+              m_slots(std::max(nr_slots, 2u)) {
+        if (filenames.empty() || !batch_size) throw std::runtime_error("dataset needs shards and a batch size");
+
+        for (auto &filename: filenames) {
+            auto file = std::make_unique<util::mapped_file>(filename);
+            dataset_file_header header;
+            if (file->size() < sizeof(header)) throw std::runtime_error(filename + " is too short");
+            std::memcpy(&header, file->data(), sizeof(header));
+            if (header.m_magic != dataset_file_header::MAGIC) throw std::runtime_error(filename + " isn't a dataset");
+            if (header.m_version != dataset_file_header::VERSION)
+                throw std::runtime_error(filename + " has unsupported version " + std::to_string(header.m_version));
+            if (header.m_data_offset % sizeof(f32) ||
+                header.m_data_offset + header.m_nr_samples * header.sample_size() * sizeof(f32) > file->size())
+                throw std::runtime_error(filename + " is truncated");
+            if (m_shards.empty()) {
+                m_input_size = header.m_input_size;
+                m_target_size = header.m_target_size;
+            } else if (header.m_input_size != m_input_size || header.m_target_size != m_target_size)
+                throw std::runtime_error(filename + " has samples of another size");
+
+            ::madvise(file->data(), file->size(), MADV_SEQUENTIAL);
+            const f32 *samples = reinterpret_cast<const f32 *>(file->data() + header.m_data_offset);
+            m_shards.push_back({std::move(file), samples, header.m_nr_samples});
+            m_nr_samples += header.m_nr_samples;
+        }
+
+        m_buffer.reserve(m_buffer_size);
+        m_order.resize(m_shards.size());
+        std::iota(m_order.begin(), m_order.end(), 0);
+        start_epoch();
+        m_reader = std::thread(&dataset::read, this);
+    }
+
+    dataset(const dataset &) = delete;
+    dataset &operator=(const dataset &) = delete;
+
+    ~dataset() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_space.notify_one();
+        m_reader.join();
+    }
+
+    u32 input_size() const { return m_input_size; }
+
+    u32 target_size() const { return m_target_size; }
+
+    u64 size() const { return m_nr_samples; }
+
+    /**
+     * the next minibatch, valid until the next call. nullptr at the end of an epoch, the call after that starts the
+     * next epoch
+     */
+    const minibatch *next() {
+        std::unique_lock lock(m_mutex);
+        if (m_holding) {
+            m_read = (m_read + 1) % (u32)m_slots.size();
+            m_filled--;
+            m_holding = false;
+            m_space.notify_one();
+        }
+        m_ready.wait(lock, [&] { return m_filled > 0; });
+
+        const minibatch &batch = m_slots[m_read];
+        m_holding = true;
+        if (batch.m_size) return &batch;
+
+        m_read = (m_read + 1) % (u32)m_slots.size();
+        m_filled--;
+        m_holding = false;
+        m_space.notify_one();
+        return nullptr;
+    }
+};
+
+} // namespace pinguml
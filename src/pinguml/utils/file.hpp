@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../../include.hpp"
+#include "../../binary_file.hpp"
+
+namespace pinguml {
+
+/**
+ * binary file of a network, written by network::write_binary and read by network::read_binary:
+ *  header, the topology in the text format of network::write, a table with the offset and size of every tensor, then
+ *  the tensors themselves: the biases of the layers that use them in layer order, then the weights of the connections.
+ *  every tensor is stored with its padding and starts at a multiple of ALIGNMENT, so that it can be used straight from
+ *  a mapping of the file. all numbers are stored in the byte order of the machine that wrote the file
+ */
+struct network_file_header {
+    static constexpr std::array<char, 8> MAGIC{'p', 'i', 'n', 'g', 'u', 'm', 'l', '\0'};
+    static constexpr u32 VERSION = 1;
+    static constexpr u32 ALIGNMENT = 64;
+
+    struct entry {
+        u64 m_offset;
+        u64 m_size;
+    };
+
+    std::array<char, 8> m_magic = MAGIC;
+    u32 m_version = VERSION;
+    u32 m_alignment = ALIGNMENT;
+    u64 m_topology_offset = 0;
+    u64 m_topology_size = 0;
+    u64 m_table_offset = 0;
+    u64 m_nr_tensors = 0;
+    u64 m_data_offset = 0;
+    u64 m_data_size = 0;
+    // of everything after the header
+    u64 m_checksum = 0;
+
+    static constexpr u64 aligned(u64 offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+};
+
+} // namespace pinguml
@@ -12,4 +12,289 @@ f32 dot(const f32 *a, const f32 *b, const u32 size) {
     return sum;
 }
 
+// y[i] = (accumulate ? y[i] : 0) + a[i] . x for the m rows of a, 4 rows at a time so that every load of x is used 4 times
+void gemv(const bool accumulate, const u32 m, const u32 n, const f32 *a, const u32 lda, const f32 *x, f32 *y) {
+    u32 i = 0;
+#if defined(AVX) && defined(__AVX2__)
+    const u32 n8 = n & ~7u;
+    for (; i + 4 <= m; i += 4) {
+        const f32 *a0 = a + i * lda, *a1 = a0 + lda, *a2 = a1 + lda, *a3 = a2 + lda;
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        for (u32 j = 0; j < n8; j += 8) {
+            const __m256 v = _mm256_loadu_ps(x + j);
+            s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + j), v, s0);
+            s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + j), v, s1);
+            s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + j), v, s2);
+            s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + j), v, s3);
+        }
+        // the 4 horizontal sums at once
+        const __m256 h = _mm256_hadd_ps(_mm256_hadd_ps(s0, s1), _mm256_hadd_ps(s2, s3));
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+        if (accumulate) sum = _mm_add_ps(sum, _mm_loadu_ps(y + i));
+        alignas(16) f32 sums[4];
+        _mm_store_ps(sums, sum);
+        for (u32 j = n8; j < n; j++) {
+            sums[0] += a0[j] * x[j];
+            sums[1] += a1[j] * x[j];
+            sums[2] += a2[j] * x[j];
+            sums[3] += a3[j] * x[j];
+        }
+        std::memcpy(y + i, sums, sizeof(sums));
+    }
+#endif
+    for (; i < m; i++)
+        y[i] = (accumulate ? y[i] : 0.f) + dot(a + i * lda, x, n);
+}
+
+/**
+ * y[i] = (accumulate ? y[i] : 0) + sum of a[i][plus[.]] - sum of a[i][minus[.]], the product of a with an input of -1,
+ * 0 and 1 given by the indices of its 1s and -1s. a is stored transposed, column j at at + j * ldt with ldt a multiple
+ * of 8, and the rows of y are written up to a multiple of 8
+ */
+void sparse_columns(const bool accumulate, const u32 m, const f32 *at, const u32 ldt, const u32 *plus,
+                    const u32 nr_plus, const u32 *minus, const u32 nr_minus, f32 *y) {
+    u32 i = 0;
+#if defined(AVX) && defined(__AVX2__)
+    // 32 rows at a time, the 1s and the -1s in two independent chains
+    for (; i < m; i += 32) {
+        const u32 blocks = std::min((m - i + 7) / 8, 4u);
+        __m256 sum[4], neg[4];
+        for (u32 k = 0; k < 4; k++) {
+            sum[k] = accumulate && k < blocks ? _mm256_loadu_ps(y + i + 8 * k) : _mm256_setzero_ps();
+            neg[k] = _mm256_setzero_ps();
+        }
+        if (blocks == 4) {
+            const u32 both = std::min(nr_plus, nr_minus);
+            for (u32 n = 0; n < both; n++) {
+                const f32 *p = at + plus[n] * ldt + i, *q = at + minus[n] * ldt + i;
+                for (u32 k = 0; k < 4; k++) {
+                    sum[k] = _mm256_add_ps(sum[k], _mm256_loadu_ps(p + 8 * k));
+                    neg[k] = _mm256_add_ps(neg[k], _mm256_loadu_ps(q + 8 * k));
+                }
+            }
+            for (u32 n = both; n < nr_plus; n++)
+                for (u32 k = 0; k < 4; k++)
+                    sum[k] = _mm256_add_ps(sum[k], _mm256_loadu_ps(at + plus[n] * ldt + i + 8 * k));
+            for (u32 n = both; n < nr_minus; n++)
+                for (u32 k = 0; k < 4; k++)
+                    neg[k] = _mm256_add_ps(neg[k], _mm256_loadu_ps(at + minus[n] * ldt + i + 8 * k));
+        } else {
+            for (u32 n = 0; n < nr_plus; n++)
+                for (u32 k = 0; k < blocks; k++)
+                    sum[k] = _mm256_add_ps(sum[k], _mm256_loadu_ps(at + plus[n] * ldt + i + 8 * k));
+            for (u32 n = 0; n < nr_minus; n++)
+                for (u32 k = 0; k < blocks; k++)
+                    neg[k] = _mm256_add_ps(neg[k], _mm256_loadu_ps(at + minus[n] * ldt + i + 8 * k));
+        }
+        for (u32 k = 0; k < blocks; k++)
+            _mm256_storeu_ps(y + i + 8 * k, _mm256_sub_ps(sum[k], neg[k]));
+    }
+#else
+    for (; i < m; i++) {
+        f32 sum = accumulate ? y[i] : 0.f;
+        for (u32 n = 0; n < nr_plus; n++) sum += at[plus[n] * ldt + i];
+        for (u32 n = 0; n < nr_minus; n++) sum -= at[minus[n] * ldt + i];
+        y[i] = sum;
+    }
+#endif
+}
+
+/**
+ * the backward pass of y = a * x in one pass over a: dx[j] += sum of d[i] * a[i][j] and g[i][j] = d[i] * x[j] for the
+ * m rows and n columns of a. 32 columns of dx and x stay in registers while the rows go by, so a is read once and g
+ * written once
+ */
+void backward_gemv(const u32 m, const u32 n, const f32 *a, const u32 lda, const f32 *d, const f32 *x, f32 *dx, f32 *g,
+                   const u32 ldg) {
+    u32 j = 0;
+#if defined(AVX) && defined(__AVX2__)
+    for (; j + 32 <= n; j += 32) {
+        __m256 sum[4], in[4];
+        for (u32 k = 0; k < 4; k++) {
+            sum[k] = _mm256_loadu_ps(dx + j + 8 * k);
+            in[k] = _mm256_loadu_ps(x + j + 8 * k);
+        }
+        for (u32 i = 0; i < m; i++) {
+            const __m256 v = _mm256_broadcast_ss(d + i);
+            const f32 *row = a + i * lda + j;
+            f32 *out = g + i * ldg + j;
+            for (u32 k = 0; k < 4; k++) {
+                sum[k] = _mm256_fmadd_ps(_mm256_loadu_ps(row + 8 * k), v, sum[k]);
+                _mm256_storeu_ps(out + 8 * k, _mm256_mul_ps(v, in[k]));
+            }
+        }
+        for (u32 k = 0; k < 4; k++)
+            _mm256_storeu_ps(dx + j + 8 * k, sum[k]);
+    }
+    for (; j + 8 <= n; j += 8) {
+        __m256 sum = _mm256_loadu_ps(dx + j);
+        const __m256 in = _mm256_loadu_ps(x + j);
+        for (u32 i = 0; i < m; i++) {
+            const __m256 v = _mm256_broadcast_ss(d + i);
+            sum = _mm256_fmadd_ps(_mm256_loadu_ps(a + i * lda + j), v, sum);
+            _mm256_storeu_ps(g + i * ldg + j, _mm256_mul_ps(v, in));
+        }
+        _mm256_storeu_ps(dx + j, sum);
+    }
+#endif
+    for (; j < n; j++) {
+        f32 sum = dx[j];
+        for (u32 i = 0; i < m; i++) {
+            sum += d[i] * a[i * lda + j];
+            g[i * ldg + j] = d[i] * x[j];
+        }
+        dx[j] = sum;
+    }
+}
+
+// ----- im2col ----- //
+
+/**
+ * col[(c * k + ky) * k + kx][y * out_w + x] = in[c][y + ky - pad][x + kx - pad], zero outside of in, the channels of in
+ * are in_stride apart. a k x k convolution of in is then a gemm of the filters with col
+ */
+void im2col(const f32 *in, const u32 channels, const u32 h, const u32 w, const u32 in_stride, const u32 k, const u32 pad,
+            f32 *col) {
+    const u32 out_h = h + 2 * pad - k + 1, out_w = w + 2 * pad - k + 1;
+    for (u32 c = 0; c < channels; c++)
+        for (u32 ky = 0; ky < k; ky++)
+            for (u32 kx = 0; kx < k; kx++)
+                for (u32 y = 0; y < out_h; y++, col += out_w) {
+                    const i32 iy = (i32)(y + ky) - (i32)pad;
+                    if (iy < 0 || iy >= (i32)h) {
+                        std::memset(col, 0, out_w * sizeof(f32));
+                        continue;
+                    }
+                    const f32 *row = in + c * in_stride + iy * w;
+                    for (u32 x = 0; x < out_w; x++) {
+                        const i32 ix = (i32)(x + kx) - (i32)pad;
+                        col[x] = ix >= 0 && ix < (i32)w ? row[ix] : 0.f;
+                    }
+                }
+}
+
+// in += the inverse of im2col, every value of col is added to the value of in it was copied from
+void col2im(const f32 *col, const u32 channels, const u32 h, const u32 w, const u32 in_stride, const u32 k,
+            const u32 pad, f32 *in) {
+    const u32 out_h = h + 2 * pad - k + 1, out_w = w + 2 * pad - k + 1;
+    for (u32 c = 0; c < channels; c++)
+        for (u32 ky = 0; ky < k; ky++)
+            for (u32 kx = 0; kx < k; kx++)
+                for (u32 y = 0; y < out_h; y++, col += out_w) {
+                    const i32 iy = (i32)(y + ky) - (i32)pad;
+                    if (iy < 0 || iy >= (i32)h) continue;
+                    f32 *row = in + c * in_stride + iy * w;
+                    for (u32 x = 0; x < out_w; x++) {
+                        const i32 ix = (i32)(x + kx) - (i32)pad;
+                        if (ix >= 0 && ix < (i32)w) row[ix] += col[x];
+                    }
+                }
+}
+
+// ----- gemm ----- //
+
+/**
+ * c[m][n] += op(a)[m][k] * op(b)[k][n], all row major, op(a)[i][p] is a[p * lda + i] if trans_a and a[i * lda + p]
+ * otherwise, the same for b.
+ * blocked like blis: panels of b (GEMM_KC x GEMM_NC) and a (GEMM_MC x GEMM_KC) are packed so that the micro kernel
+ * reads both contiguously, the transpositions are handled by the packing. the micro kernel keeps a 6 x 16 block of c
+ * in 12 ymm registers, the packed a block stays in l2 and a 16 wide panel of b in l1
+ */
+constexpr u32 GEMM_MR = 6, GEMM_NR = 16;
+constexpr u32 GEMM_MC = 72, GEMM_KC = 256, GEMM_NC = 1024;
+
+void gemm_pack_a(const bool trans_a, const f32 *a, const u32 lda, const u32 m, const u32 k, f32 *packed) {
+    for (u32 i = 0; i < m; i += GEMM_MR) {
+        const u32 rows = std::min(GEMM_MR, m - i);
+        for (u32 p = 0; p < k; p++) {
+            for (u32 r = 0; r < rows; r++)
+                packed[r] = trans_a ? a[p * lda + i + r] : a[(i + r) * lda + p];
+            for (u32 r = rows; r < GEMM_MR; r++)
+                packed[r] = 0.f;
+            packed += GEMM_MR;
+        }
+    }
+}
+
+void gemm_pack_b(const bool trans_b, const f32 *b, const u32 ldb, const u32 k, const u32 n, f32 *packed) {
+    for (u32 j = 0; j < n; j += GEMM_NR) {
+        const u32 cols = std::min(GEMM_NR, n - j);
+        for (u32 p = 0; p < k; p++) {
+            if (!trans_b && cols == GEMM_NR)
+                std::memcpy(packed, b + p * ldb + j, GEMM_NR * sizeof(f32));
+            else {
+                for (u32 c = 0; c < cols; c++)
+                    packed[c] = trans_b ? b[(j + c) * ldb + p] : b[p * ldb + j + c];
+                for (u32 c = cols; c < GEMM_NR; c++)
+                    packed[c] = 0.f;
+            }
+            packed += GEMM_NR;
+        }
+    }
+}
+
+// c[rows][cols] += a * b for one GEMM_MR x GEMM_NR block, a and b packed
+void gemm_kernel(const u32 k, const f32 *a, const f32 *b, f32 *c, const u32 ldc, const u32 rows, const u32 cols) {
+#if defined(AVX) && defined(__AVX2__)
+    __m256 sum[GEMM_MR][2];
+    for (u32 r = 0; r < GEMM_MR; r++)
+        sum[r][0] = sum[r][1] = _mm256_setzero_ps();
+    for (u32 p = 0; p < k; p++) {
+        const __m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + 8);
+        for (u32 r = 0; r < GEMM_MR; r++) {
+            const __m256 x = _mm256_broadcast_ss(a + r);
+            sum[r][0] = _mm256_fmadd_ps(x, b0, sum[r][0]);
+            sum[r][1] = _mm256_fmadd_ps(x, b1, sum[r][1]);
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    if (rows == GEMM_MR && cols == GEMM_NR) {
+        for (u32 r = 0; r < GEMM_MR; r++) {
+            _mm256_storeu_ps(c + r * ldc, _mm256_add_ps(_mm256_loadu_ps(c + r * ldc), sum[r][0]));
+            _mm256_storeu_ps(c + r * ldc + 8, _mm256_add_ps(_mm256_loadu_ps(c + r * ldc + 8), sum[r][1]));
+        }
+        return;
+    }
+    alignas(32) f32 block[GEMM_MR][GEMM_NR];
+    for (u32 r = 0; r < GEMM_MR; r++) {
+        _mm256_store_ps(block[r], sum[r][0]);
+        _mm256_store_ps(block[r] + 8, sum[r][1]);
+    }
+#else
+    f32 block[GEMM_MR][GEMM_NR] = {};
+    for (u32 p = 0; p < k; p++, a += GEMM_MR, b += GEMM_NR)
+        for (u32 r = 0; r < GEMM_MR; r++)
+            for (u32 j = 0; j < GEMM_NR; j++)
+                block[r][j] += a[r] * b[j];
+#endif
+    for (u32 r = 0; r < rows; r++)
+        for (u32 j = 0; j < cols; j++)
+            c[r * ldc + j] += block[r][j];
+}
+
+void gemm(const bool trans_a, const bool trans_b, const u32 m, const u32 n, const u32 k, const f32 *a, const u32 lda,
+          const f32 *b, const u32 ldb, f32 *c, const u32 ldc) {
+    thread_local std::vector<f32> packed_a(GEMM_MC * GEMM_KC), packed_b(GEMM_KC * GEMM_NC);
+
+    for (u32 jc = 0; jc < n; jc += GEMM_NC) {
+        const u32 nc = std::min(GEMM_NC, n - jc);
+        for (u32 pc = 0; pc < k; pc += GEMM_KC) {
+            const u32 kc = std::min(GEMM_KC, k - pc);
+            gemm_pack_b(trans_b, trans_b ? b + jc * ldb + pc : b + pc * ldb + jc, ldb, kc, nc, packed_b.data());
+
+            for (u32 ic = 0; ic < m; ic += GEMM_MC) {
+                const u32 mc = std::min(GEMM_MC, m - ic);
+                gemm_pack_a(trans_a, trans_a ? a + pc * lda + ic : a + ic * lda + pc, lda, mc, kc, packed_a.data());
+
+                for (u32 jr = 0; jr < nc; jr += GEMM_NR)
+                    for (u32 ir = 0; ir < mc; ir += GEMM_MR)
+                        gemm_kernel(kc, packed_a.data() + ir * kc, packed_b.data() + jr * kc,
+                                    c + (ic + ir) * ldc + jc + jr, ldc, std::min(GEMM_MR, mc - ir),
+                                    std::min(GEMM_NR, nc - jr));
+            }
+        }
+    }
+}
+
 } // pinguml
@@ -2,8 +2,19 @@
 
 #include "../../include.hpp"
 
+#include "tensor.hpp"
+
 namespace pinguml {
 
+/**
+ * solvers update a weight or bias tensor from its gradient, state they need per tensor is pushed back with its shape
+ * when the connection or the layer is made, so it has the same padding and alignment. the weight decay of the solvers
+ * that have one only applies to the tensors pushed back with decay, the network leaves it off for the biases. every update is a single pass over
+ * the weights, the gradient and the state, 8 floats at a time with avx2 (the sizes of tensors are multiples of 8 then)
+ * and scalar otherwise.
+ * update_weights_from writes the update of source into weights, so that the double buffered network doesn't have to
+ * copy the weights first
+ */
 class solver_base {
 public:
     f32 m_learning_rate;
@@ -14,24 +25,214 @@ public:
 
     virtual void reset() {}
 
-    virtual void push_back([[maybe_unused]] const u32 h, [[maybe_unused]] const u32 w, [[maybe_unused]] const u32 c) {}
+    void push_back(const u32 h, const u32 w, const u32 c, const bool decay = true) {
+        m_decays.push_back(decay);
+        push_back_state(h, w, c);
+    }
+
+    virtual void update_weights_from(const tensor &source, tensor *weights, [[maybe_unused]] const u32 index, [[maybe_unused]] const tensor &delta_weights, [[maybe_unused]] const f32 alpha = 1.0f) {
+        if (&source != weights) *weights = source;
+    }
+
+    void update_weights(tensor *weights, const u32 index, const tensor &delta_weights, const f32 alpha = 1.0f) {
+        update_weights_from(*weights, weights, index, delta_weights, alpha);
+    }
+
+protected:
+    // whether the tensor of every state index gets weight decay
+    std::vector<bool> m_decays;
 
-    virtual void update_weights([[maybe_unused]] tensor *weights, [[maybe_unused]] const u32 index, [[maybe_unused]] const tensor &delta_weights, [[maybe_unused]] const f32 alpha = 1.0f) {}
+    virtual void push_back_state([[maybe_unused]] const u32 h, [[maybe_unused]] const u32 w, [[maybe_unused]] const u32 c) {}
 };
 
+// state of the solvers, one tensor per weight or bias tensor in its shape
+class solver_state {
+public:
+    std::vector<tensor> m_tensors;
+
+    void push_back(const u32 h, const u32 w, const u32 c) {
+        m_tensors.emplace_back(h, w, c);
+        m_tensors.back().fill(0.f);
+    }
+
+    void reset() {
+        for (auto &state: m_tensors) state.fill(0.f);
+    }
+
+    f32 *operator[](const u32 index) { return m_tensors[index].m_ptr; }
+};
+
+// w -= learning rate * (dw + weight decay * w)
 class sgd : public solver_base {
 public:
-    virtual void update_weights(tensor *weights, [[maybe_unused]] const u32 index, const tensor &delta_weights, [[maybe_unused]] const f32 alpha = 1.0f) {
-        const f32 weight_decay = 0.01f;
-        const f32 learning_rate = weight_decay * m_learning_rate;
-        for(u32 i = 0; i < weights->size(); i++)	
-            weights->m_ptr[i] -= learning_rate * (delta_weights.m_ptr[i] + weight_decay * weights->m_ptr[i]);
+    f32 m_weight_decay = 0.01f;
+
+    virtual void update_weights_from(const tensor &source, tensor *weights, const u32 index, const tensor &delta_weights, const f32 alpha = 1.0f) {
+        const f32 *w = source.m_ptr, *dw = delta_weights.m_ptr;
+        f32 *out = weights->m_ptr;
+        const u32 size = source.size();
+        const f32 rate = alpha * m_learning_rate, decay = m_decays[index] ? m_weight_decay : 0.f;
+        u32 i = 0;
+#if defined(AVX) && defined(__AVX2__)
+        const __m256 rate8 = _mm256_set1_ps(rate), decay8 = _mm256_set1_ps(decay);
+        for (; i + 8 <= size; i += 8) {
+            const __m256 x = _mm256_loadu_ps(w + i);
+            const __m256 g = _mm256_fmadd_ps(decay8, x, _mm256_loadu_ps(dw + i));
+            _mm256_storeu_ps(out + i, _mm256_fnmadd_ps(rate8, g, x));
+        }
+#endif
+        for (; i < size; i++)
+            out[i] = w[i] - rate * (dw[i] + decay * w[i]);
+    }
+};
+
+// v = momentum * v + dw + weight decay * w, w -= learning rate * v
+class momentum : public solver_base {
+    solver_state m_velocity;
+
+public:
+    f32 m_momentum = 0.9f;
+    f32 m_weight_decay = 0.0005f;
+
+    momentum() { m_learning_rate = 0.01f; }
+
+    virtual void reset() { m_velocity.reset(); }
+
+    virtual void push_back_state(const u32 h, const u32 w, const u32 c) { m_velocity.push_back(h, w, c); }
+
+    virtual void update_weights_from(const tensor &source, tensor *weights, const u32 index, const tensor &delta_weights, const f32 alpha = 1.0f) {
+        const f32 *w = source.m_ptr, *dw = delta_weights.m_ptr;
+        f32 *out = weights->m_ptr, *v = m_velocity[index];
+        const u32 size = source.size();
+        const f32 rate = alpha * m_learning_rate, mu = m_momentum, decay = m_decays[index] ? m_weight_decay : 0.f;
+        u32 i = 0;
+#if defined(AVX) && defined(__AVX2__)
+        const __m256 rate8 = _mm256_set1_ps(rate), mu8 = _mm256_set1_ps(mu), decay8 = _mm256_set1_ps(decay);
+        for (; i + 8 <= size; i += 8) {
+            const __m256 x = _mm256_loadu_ps(w + i);
+            const __m256 g = _mm256_fmadd_ps(decay8, x, _mm256_loadu_ps(dw + i));
+            const __m256 velocity = _mm256_fmadd_ps(mu8, _mm256_loadu_ps(v + i), g);
+            _mm256_storeu_ps(v + i, velocity);
+            _mm256_storeu_ps(out + i, _mm256_fnmadd_ps(rate8, velocity, x));
+        }
+#endif
+        for (; i < size; i++) {
+            v[i] = mu * v[i] + dw[i] + decay * w[i];
+            out[i] = w[i] - rate * v[i];
+        }
+    }
+};
+
+// g += dw^2, w -= learning rate * dw / (sqrt(g) + eps)
+class adagrad : public solver_base {
+    solver_state m_squares;
+
+public:
+    f32 m_epsilon = 1e-8f;
+
+    adagrad() { m_learning_rate = 0.01f; }
+
+    virtual void reset() { m_squares.reset(); }
+
+    virtual void push_back_state(const u32 h, const u32 w, const u32 c) { m_squares.push_back(h, w, c); }
+
+    virtual void update_weights_from(const tensor &source, tensor *weights, const u32 index, const tensor &delta_weights, const f32 alpha = 1.0f) {
+        const f32 *w = source.m_ptr, *dw = delta_weights.m_ptr;
+        f32 *out = weights->m_ptr, *g = m_squares[index];
+        const u32 size = source.size();
+        const f32 rate = alpha * m_learning_rate, eps = m_epsilon;
+        u32 i = 0;
+#if defined(AVX) && defined(__AVX2__)
+        const __m256 rate8 = _mm256_set1_ps(rate), eps8 = _mm256_set1_ps(eps);
+        for (; i + 8 <= size; i += 8) {
+            const __m256 d = _mm256_loadu_ps(dw + i);
+            const __m256 squares = _mm256_fmadd_ps(d, d, _mm256_loadu_ps(g + i));
+            _mm256_storeu_ps(g + i, squares);
+            const __m256 step = _mm256_div_ps(_mm256_mul_ps(rate8, d), _mm256_add_ps(_mm256_sqrt_ps(squares), eps8));
+            _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(w + i), step));
+        }
+#endif
+        for (; i < size; i++) {
+            g[i] += dw[i] * dw[i];
+            out[i] = w[i] - rate * dw[i] / (std::sqrt(g[i]) + eps);
+        }
+    }
+};
+
+/**
+ * m = beta1 * m + (1 - beta1) * dw, v = beta2 * v + (1 - beta2) * dw^2,
+ * w -= learning rate * (m / (1 - beta1^t)) / (sqrt(v / (1 - beta2^t)) + eps) + learning rate * weight decay * w.
+ * the weight decay is decoupled from the gradient like in adamw, it is 0 for adam
+ */
+class adam : public solver_base {
+    solver_state m_first, m_second;
+    // beta1^t and beta2^t of every connection
+    std::vector<f32> m_beta1_t, m_beta2_t;
+
+public:
+    f32 m_beta1 = 0.9f;
+    f32 m_beta2 = 0.999f;
+    f32 m_epsilon = 1e-8f;
+    f32 m_weight_decay;
+
+    adam(const f32 weight_decay = 0.f) : m_weight_decay(weight_decay) { m_learning_rate = 0.001f; }
+
+    virtual void reset() {
+        m_first.reset();
+        m_second.reset();
+        std::fill(m_beta1_t.begin(), m_beta1_t.end(), 1.f);
+        std::fill(m_beta2_t.begin(), m_beta2_t.end(), 1.f);
+    }
+
+    virtual void push_back_state(const u32 h, const u32 w, const u32 c) {
+        m_first.push_back(h, w, c);
+        m_second.push_back(h, w, c);
+        m_beta1_t.push_back(1.f);
+        m_beta2_t.push_back(1.f);
+    }
+
+    virtual void update_weights_from(const tensor &source, tensor *weights, const u32 index, const tensor &delta_weights, const f32 alpha = 1.0f) {
+        const f32 *w = source.m_ptr, *dw = delta_weights.m_ptr;
+        f32 *out = weights->m_ptr, *m = m_first[index], *v = m_second[index];
+        const u32 size = source.size();
+        m_beta1_t[index] *= m_beta1;
+        m_beta2_t[index] *= m_beta2;
+        // the bias corrections folded into the step size and eps
+        const f32 correction = std::sqrt(1.f - m_beta2_t[index]);
+        const f32 rate = alpha * m_learning_rate * correction / (1.f - m_beta1_t[index]);
+        const f32 eps = m_epsilon * correction, decay = m_decays[index] ? alpha * m_learning_rate * m_weight_decay : 0.f;
+        const f32 b1 = m_beta1, b2 = m_beta2;
+        u32 i = 0;
+#if defined(AVX) && defined(__AVX2__)
+        const __m256 rate8 = _mm256_set1_ps(rate), eps8 = _mm256_set1_ps(eps), decay8 = _mm256_set1_ps(decay);
+        const __m256 b1_8 = _mm256_set1_ps(b1), b2_8 = _mm256_set1_ps(b2);
+        const __m256 c1_8 = _mm256_set1_ps(1.f - b1), c2_8 = _mm256_set1_ps(1.f - b2);
+        for (; i + 8 <= size; i += 8) {
+            const __m256 d = _mm256_loadu_ps(dw + i);
+            const __m256 first = _mm256_fmadd_ps(b1_8, _mm256_loadu_ps(m + i), _mm256_mul_ps(c1_8, d));
+            const __m256 second = _mm256_fmadd_ps(b2_8, _mm256_loadu_ps(v + i), _mm256_mul_ps(c2_8, _mm256_mul_ps(d, d)));
+            _mm256_storeu_ps(m + i, first);
+            _mm256_storeu_ps(v + i, second);
+            const __m256 x = _mm256_loadu_ps(w + i);
+            const __m256 step = _mm256_div_ps(_mm256_mul_ps(rate8, first), _mm256_add_ps(_mm256_sqrt_ps(second), eps8));
+            _mm256_storeu_ps(out + i, _mm256_fnmadd_ps(decay8, x, _mm256_sub_ps(x, step)));
+        }
+#endif
+        for (; i < size; i++) {
+            m[i] = b1 * m[i] + (1.f - b1) * dw[i];
+            v[i] = b2 * v[i] + (1.f - b2) * dw[i] * dw[i];
+            out[i] = w[i] - rate * m[i] / (std::sqrt(v[i]) + eps) - decay * w[i];
+        }
     }
 };
 
 solver_base* create_solver(const std::string name) {
     if(name == "null") return nullptr;
     else if(name == "sgd") { return new sgd();}
+    else if(name == "momentum") { return new momentum();}
+    else if(name == "adagrad") { return new adagrad();}
+    else if(name == "adam") { return new adam();}
+    else if(name == "adamw") { return new adam(0.01f);}
 
     throw std::runtime_error("invalid name '" + name + "'");
 }
@@ -4,37 +4,187 @@
 
 namespace pinguml {
 
+class tensor;
+
+// ----- tensor pool ----- //
+
+/**
+ * thread local free lists of tensor memory in size classes, the sizes are rounded up to a multiple of 8 up to 64 and
+ * to a quarter of a power of two above, so at most a fifth of a block is unused. memory a thread frees is reused by
+ * its next allocation of the same class, tensors that are created and destroyed over and over (temporaries, inputs,
+ * gradients) only reach the heap the first time
+ */
+class tensor_pool {
+private:
+    static constexpr u32 NR_CLASSES = 8 + 26 * 4;
+
+    std::array<std::vector<f32 *>, NR_CLASSES> m_free;
+
+    // true once the pool of the thread is destroyed, tensors that outlive it return their memory to the heap
+    static bool &destroyed() {
+        thread_local bool flag = false;
+        return flag;
+    }
+
+public:
+    static constexpr std::align_val_t ALIGNMENT{32};
+
+    // blocks that weren't in a free list
+    u64 m_heap_allocations = 0;
+
+    ~tensor_pool() {
+        for (auto &list: m_free)
+            for (f32 *block: list) ::operator delete(block, ALIGNMENT);
+        destroyed() = true;
+    }
+
+    static tensor_pool &local() {
+        thread_local tensor_pool pool;
+        return pool;
+    }
+
+    // index of the class of size, capacity is set to the size of the blocks of the class
+    static u32 size_class(const u32 size, u32 &capacity) {
+        if (size <= 64) {
+            capacity = std::max((size + 7) & ~7u, 8u);
+            return capacity / 8 - 1;
+        }
+        const u32 shift = std::bit_width(size - 1) - 3;
+        const u32 quarter = ((size - 1) >> shift) + 1;
+        capacity = quarter << shift;
+        return 8 + (shift - 4) * 4 + quarter - 5;
+    }
+
+    static f32 *acquire(const u32 size, u32 &capacity) {
+        const u32 index = size_class(size, capacity);
+        tensor_pool &pool = local();
+        if (!pool.m_free[index].empty()) {
+            f32 *block = pool.m_free[index].back();
+            pool.m_free[index].pop_back();
+            return block;
+        }
+        pool.m_heap_allocations++;
+        return static_cast<f32 *>(::operator new(capacity * sizeof(f32), ALIGNMENT));
+    }
+
+    static void release(f32 *block, const u32 capacity) {
+        if (destroyed()) {
+            ::operator delete(block, ALIGNMENT);
+            return;
+        }
+        u32 unused;
+        local().m_free[size_class(capacity, unused)].push_back(block);
+    }
+};
+
+// ----- expression templates ----- //
+
+/**
+ * arithmetic on tensors is lazy, a + b, a * 2.f etc. only build expressions that refer to their operands. an expression
+ * is evaluated when it is assigned to a tensor, in one loop over all operands, so a = b * c + d makes no temporaries.
+ * the tensors of an expression must have the same shape, assigning gives the tensor the shape of the first of them
+ */
+namespace expression {
+
+struct leaf {
+    const f32 *m_ptr;
+    const tensor *m_shape;
+
+    f32 at(const u32 i) const { return m_ptr[i]; }
+#if defined(AVX)
+    __m256 load(const u32 i) const { return _mm256_loadu_ps(m_ptr + i); }
+#endif
+    const tensor *shape() const { return m_shape; }
+};
+
+struct scalar {
+    f32 m_value;
+
+    f32 at(const u32) const { return m_value; }
+#if defined(AVX)
+    __m256 load(const u32) const { return _mm256_set1_ps(m_value); }
+#endif
+    const tensor *shape() const { return nullptr; }
+};
+
+struct add {
+    static f32 apply(const f32 a, const f32 b) { return a + b; }
+#if defined(AVX)
+    static __m256 apply(const __m256 a, const __m256 b) { return _mm256_add_ps(a, b); }
+#endif
+};
+
+struct sub {
+    static f32 apply(const f32 a, const f32 b) { return a - b; }
+#if defined(AVX)
+    static __m256 apply(const __m256 a, const __m256 b) { return _mm256_sub_ps(a, b); }
+#endif
+};
+
+struct mul {
+    static f32 apply(const f32 a, const f32 b) { return a * b; }
+#if defined(AVX)
+    static __m256 apply(const __m256 a, const __m256 b) { return _mm256_mul_ps(a, b); }
+#endif
+};
+
+template<class OP, class L, class R>
+struct binary {
+    L m_left;
+    R m_right;
+
+    f32 at(const u32 i) const { return OP::apply(m_left.at(i), m_right.at(i)); }
+#if defined(AVX)
+    __m256 load(const u32 i) const { return OP::apply(m_left.load(i), m_right.load(i)); }
+#endif
+    const tensor *shape() const { return m_left.shape() ? m_left.shape() : m_right.shape(); }
+};
+
+template<class T>
+struct is_binary : std::false_type {};
+
+template<class OP, class L, class R>
+struct is_binary<binary<OP, L, R>> : std::true_type {};
+
+// a tensor or an unevaluated expression
+template<class T>
+concept node = std::is_same_v<T, tensor> || is_binary<T>::value;
+
+template<class T>
+concept operand = node<T> || std::is_arithmetic_v<T>;
+
+} // namespace expression
 class tensor {
 private:
     u32 m_size;
     u32 m_capacity;
+    // owned memory, nullptr if there is none or the tensor uses adopted data
     f32 *m_memory;
 
     void _delete() {
-        delete[] m_memory;
+        if (m_memory) tensor_pool::release(m_memory, m_capacity);
         m_ptr = nullptr;
         m_memory = nullptr;
     }
 
-#if defined(AVX)
+    // memory for at least sz values from the pool of the thread, sets m_capacity to what was given
     f32 *_new(const u32 sz) {
-        m_memory = new f32[sz + 31];
-        m_ptr = (f32 *) (((std::uintptr_t) m_memory + 32) & ~(std::uintptr_t) 0x1F);
-        return m_ptr;
-    }
-#elif (SSE)
-    f32 *_new(const u32 sz) { 
-        m_memory = new f32[sz + 15];
-        m_ptr = (f32 *)(((std::uintptr_t)m_memory + 16) & ~(std::uintptr_t)0x0F);
-        return m_ptr;
-    }
-#elif defined(NORMAL)
-    f32 *_new(const u32 sz) { 
-        m_memory = new f32[sz];
-        m_ptr = (f32 *)((std::uintptr_t)m_memory);
+        m_memory = tensor_pool::acquire(sz, m_capacity);
+        m_ptr = m_memory;
         return m_ptr;
     }
+
+    // one pass over the expression, 8 values at a time
+    template<class E>
+    void evaluate(const E &e) {
+        u32 i = 0;
+#if defined(AVX)
+        for (; i + 8 <= m_size; i += 8)
+            _mm256_store_ps(m_ptr + i, e.load(i));
 #endif
+        for (; i < m_size; i++)
+            m_ptr[i] = e.at(i);
+    }
 
 public:
     u32 m_rows, m_cols, m_channels;
@@ -57,33 +207,37 @@ public:
         return x;
     }
 
-    tensor() : m_size(0), m_capacity(0), m_rows(0), m_cols(0), m_channels(0), m_channel_stride(0), m_ptr(0) {}
+    tensor() : m_size(0), m_capacity(0), m_memory(nullptr), m_rows(0), m_cols(0), m_channels(0), m_channel_stride(0), m_ptr(0) {}
 
-    tensor(const u32 h, const u32 w, const u32 c, const f32 *data = nullptr) : m_rows(h), m_cols(w), m_channels(c) {
+    tensor(const u32 h, const u32 w, const u32 c, const f32 *data = nullptr) : m_memory(nullptr), m_rows(h), m_cols(w),
+                                                                               m_channels(c) {
         m_channel_stride = channel_stride(h, w);
-        m_size = m_capacity = m_channel_stride * m_channels;
+        m_size = m_channel_stride * m_channels;
         m_ptr = _new(m_size);
         if (data) std::memcpy(m_ptr, data, m_size * sizeof(f32));
     }
 
-    tensor(const tensor &tns) : m_size(tns.m_size), m_capacity(tns.m_capacity), m_rows(tns.m_rows), m_cols(tns.m_cols),
+    tensor(const tensor &tns) : m_size(tns.m_size), m_memory(nullptr), m_rows(tns.m_rows), m_cols(tns.m_cols),
                                 m_channels(tns.m_channels), m_channel_stride(tns.m_channel_stride) {
         m_ptr = _new(m_size);
         std::memcpy(m_ptr, tns.m_ptr, tns.m_size * sizeof(f32));
     }
 
-    tensor(const tensor &tns, const u32 pad_rows, const u32 pad_cols, const u8 pad_type) : m_size(tns.m_size),
-                                                                                           m_capacity(tns.m_capacity),
-                                                                                           m_rows(tns.m_rows),
-                                                                                           m_cols(tns.m_cols),
-                                                                                           m_channels(tns.m_channels),
-                                                                                           m_channel_stride(
-                                                                                                   tns.m_channel_stride) {
-        m_ptr = _new(tns.m_size);
-        std::memcpy(m_ptr, tns.m_ptr, tns.m_size * sizeof(f32));
+    tensor(tensor &&tns) noexcept : m_size(tns.m_size), m_capacity(tns.m_capacity), m_memory(tns.m_memory),
+                                    m_rows(tns.m_rows), m_cols(tns.m_cols), m_channels(tns.m_channels),
+                                    m_channel_stride(tns.m_channel_stride), m_ptr(tns.m_ptr) {
+        tns.m_memory = tns.m_ptr = nullptr;
+        tns.m_size = tns.m_capacity = 0;
+    }
+
+    tensor(const tensor &tns, const u32 pad_rows, const u32 pad_cols, const u8 pad_type) : tensor(tns) {
         *this = tensor_pad(pad_rows, pad_cols, pad_rows, pad_cols, pad_type);
     }
 
+    // evaluates e
+    template<expression::node E> requires (!std::is_same_v<E, tensor>)
+    tensor(const E &e);
+
     ~tensor() { _delete(); }
 
     tensor channel(const u32 index, const u32 nr_channels) const {
@@ -130,8 +284,8 @@ public:
         return tns;
     }
 
-    void fill(const f32 value) { // add SIMD
-        for (u32 i = 0; i < m_size; i++) m_ptr[i] = value;
+    void fill(const f32 value) {
+        evaluate(expression::scalar{value});
     }
 
     void fill_random_uniform(const f32 low, const f32 high) {
@@ -223,10 +377,8 @@ public:
         const u32 new_stride = channel_stride(h, w);
         const u32 sz = new_stride * c;
         if (sz > m_capacity) {
-            if (m_capacity) _delete();
-            m_size = sz;
-            m_capacity = m_size;
-            m_ptr = _new(m_size);
+            _delete();
+            m_ptr = _new(sz);
         }
         m_rows = h;
         m_cols = w;
@@ -235,314 +387,116 @@ public:
         m_channel_stride = new_stride;
     }
 
+    // uses data of size() values instead of own memory, data has to be aligned like _new aligns and outlive the tensor
+    // or the next resize
+    void adopt(f32 *data) {
+        _delete();
+        m_capacity = m_size;
+        m_ptr = data;
+    }
+
     // = 
     tensor &operator=(const tensor &tns) {
+        if (this == &tns) return *this;
         resize(tns.m_rows, tns.m_cols, tns.m_channels);
         std::memcpy(m_ptr, tns.m_ptr, m_size * sizeof(f32));
         return *this;
     }
 
-#if defined(AVX) // ----- AVX OPERATOR OVERLOADING ----- //
-
-    // += 
-    tensor &operator+=(const tensor &tns) {
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(m_ptr + i, _mm256_add_ps(_mm256_load_ps(m_ptr + i), _mm256_load_ps(tns.m_ptr + i)));
-
-        return *this;
-    }
-
-    // -= 
-    tensor &operator-=(const tensor &tns) {
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(m_ptr + i, _mm256_sub_ps(_mm256_load_ps(m_ptr + i), _mm256_load_ps(tns.m_ptr + i)));
-
+    tensor &operator=(tensor &&tns) noexcept {
+        std::swap(m_size, tns.m_size);
+        std::swap(m_capacity, tns.m_capacity);
+        std::swap(m_memory, tns.m_memory);
+        std::swap(m_ptr, tns.m_ptr);
+        m_rows = tns.m_rows;
+        m_cols = tns.m_cols;
+        m_channels = tns.m_channels;
+        m_channel_stride = tns.m_channel_stride;
         return *this;
     }
 
-    // *=
-    tensor &operator*=(const tensor &tns) {
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(m_ptr + i, _mm256_mul_ps(_mm256_load_ps(m_ptr + i), _mm256_load_ps(tns.m_ptr + i)));
+    // ----- lazy arithmetic, see namespace expression ----- //
 
-        return *this;
-    }
+    template<expression::node E> requires (!std::is_same_v<E, tensor>)
+    tensor &operator=(const E &e);
 
-    // += value
-    tensor &operator+=(const f32 value) {
-        __m256 val = _mm256_set_ps(value, value, value, value, value, value, value, value);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(m_ptr + i, _mm256_add_ps(_mm256_load_ps(m_ptr + i), val));
+    template<expression::operand T>
+    tensor &operator+=(const T &x);
 
-        return *this;
-    }
+    template<expression::operand T>
+    tensor &operator-=(const T &x);
 
-    // -= value
-    tensor &operator-=(const f32 value) {
-        __m256 val = _mm256_set_ps(value, value, value, value, value, value, value, value);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(m_ptr + i, _mm256_sub_ps(_mm256_load_ps(m_ptr + i), val));
-
-        return *this;
-    }
-
-    // *= value
-    tensor &operator*=(const f32 value) {
-        __m256 val = _mm256_set_ps(value, value, value, value, value, value, value, value);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(m_ptr + i, _mm256_mul_ps(_mm256_load_ps(m_ptr + i), val));
-
-        return *this;
-    }
-
-    // +
-    tensor operator+(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(nw.m_ptr, _mm256_add_ps(_mm256_load_ps(m_ptr + i), _mm256_load_ps(tns.m_ptr + i)));
-
-        return nw;
-    }
-
-    // -
-    tensor operator-(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(nw.m_ptr, _mm256_sub_ps(_mm256_load_ps(m_ptr + i), _mm256_load_ps(tns.m_ptr + i)));
-
-        return nw;
-    }
-
-    // *
-    tensor operator*(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(nw.m_ptr, _mm256_mul_ps(_mm256_load_ps(m_ptr + i), _mm256_load_ps(tns.m_ptr + i)));
-
-        return nw;
-    }
-
-    // + value
-    tensor operator+(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        __m256 val = _mm256_set_ps(value, value, value, value, value, value, value, value);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(nw.m_ptr + i, _mm256_add_ps(_mm256_load_ps(m_ptr + i), val));
-
-        return nw;
-    }
-
-    // - value
-    tensor operator-(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        __m256 val = _mm256_set_ps(value, value, value, value, value, value, value, value);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(nw.m_ptr + i, _mm256_sub_ps(_mm256_load_ps(m_ptr + i), val));
-
-        return nw;
-    }
-
-    // * value
-    tensor operator*(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        __m256 val = _mm256_set_ps(value, value, value, value, value, value, value, value);
-        for (u32 i = 0; i < m_size; i += 8)
-            _mm256_store_ps(nw.m_ptr + i, _mm256_mul_ps(_mm256_load_ps(m_ptr + i), val));
-
-        return nw;
-    }
-
-#elif defined(SSE) // ----- SSE OPERATOR OVERLOADING ----- //
-
-    // += 
-    tensor& operator+=(const tensor &tns) {
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(m_ptr + i, _mm_add_ps(_mm_load_ps(m_ptr + i), _mm_load_ps(tns.m_ptr + i)));
-
-        return *this;
-    }
-
-    // -= 
-    tensor& operator-=(const tensor &tns) {
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(m_ptr + i, _mm_sub_ps(_mm_load_ps(m_ptr + i), _mm_load_ps(tns.m_ptr + i)));
-
-        return *this;
-    }
-
-    // *=
-    tensor& operator*=(const tensor &tns) {
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(m_ptr + i, _mm_mul_ps(_mm_load_ps(m_ptr + i), _mm_load_ps(tns.m_ptr + i)));
-
-        return *this;
-    }
-   
-    // += value
-    tensor& operator+=(const f32 value) {
-        __m128 val = _mm_set_ps(value, value, value, value);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(m_ptr + i, _mm_add_ps(_mm_load_ps(m_ptr + i), val));
-
-        return *this;
-    }
+    template<expression::operand T>
+    tensor &operator*=(const T &x);
+};
 
-    // -= value
-    tensor& operator-=(const f32 value) {
-        __m128 val = _mm_set_ps(value, value, value, value);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(m_ptr + i, _mm_sub_ps(_mm_load_ps(m_ptr + i), val));
+namespace expression {
 
-        return *this;
-    }
+inline leaf make(const tensor &tns) { return {tns.m_ptr, &tns}; }
 
-    // *= value
-    tensor& operator*=(const f32 value) {
-        __m128 val = _mm_set_ps(value, value, value, value);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(m_ptr + i, _mm_mul_ps(_mm_load_ps(m_ptr + i), val));
+inline scalar make(const f32 value) { return {value}; }
 
-        return *this;
-    }
+template<class OP, class L, class R>
+const binary<OP, L, R> &make(const binary<OP, L, R> &e) { return e; }
 
-    // +
-    tensor operator+(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(nw.m_ptr, _mm_add_ps(_mm_load_ps(m_ptr + i), _mm_load_ps(tns.m_ptr + i)));
+template<class OP, class L, class R>
+binary<OP, std::remove_cvref_t<decltype(make(std::declval<const L &>()))>,
+       std::remove_cvref_t<decltype(make(std::declval<const R &>()))>>
+combine(const L &l, const R &r) {
+    return {make(l), make(r)};
+}
 
-        return nw;
-    }
+} // namespace expression
 
-    // -
-    tensor operator-(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(nw.m_ptr, _mm_sub_ps(_mm_load_ps(m_ptr + i), _mm_load_ps(tns.m_ptr + i)));
-            
-        return nw;
-    }
+// at least one side has to be a tensor or an expression
+template<expression::operand L, expression::operand R> requires (expression::node<L> || expression::node<R>)
+auto operator+(const L &l, const R &r) { return expression::combine<expression::add>(l, r); }
 
-    // *
-    tensor operator*(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(nw.m_ptr, _mm_mul_ps(_mm_load_ps(m_ptr + i), _mm_load_ps(tns.m_ptr + i)));
+template<expression::operand L, expression::operand R> requires (expression::node<L> || expression::node<R>)
+auto operator-(const L &l, const R &r) { return expression::combine<expression::sub>(l, r); }
 
-        return nw;
-    }
-   
-    // + value
-    tensor operator+(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        __m128 val = _mm_set_ps(value, value, value, value);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(nw.m_ptr + i, _mm_add_ps(_mm_load_ps(m_ptr + i), val));
-
-        return nw;
-    }
+template<expression::operand L, expression::operand R> requires (expression::node<L> || expression::node<R>)
+auto operator*(const L &l, const R &r) { return expression::combine<expression::mul>(l, r); }
 
-    // - value
-    tensor operator-(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        __m128 val = _mm_set_ps(value, value, value, value);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(nw.m_ptr + i, _mm_sub_ps(_mm_load_ps(m_ptr + i), val));
+namespace expression {
 
-        return nw;
-    }
+// so that argument dependent lookup finds them for expression * 2.f
+using pinguml::operator+;
+using pinguml::operator-;
+using pinguml::operator*;
 
-    // * value
-    tensor operator*(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        __m128 val = _mm_set_ps(value, value, value, value);
-        for(u32 i = 0; i < m_size; i += 4)
-            _mm_store_ps(nw.m_ptr + i, _mm_mul_ps(_mm_load_ps(m_ptr + i), val));
+} // namespace expression
 
-        return nw;
-    }
+template<expression::node E> requires (!std::is_same_v<E, tensor>)
+tensor::tensor(const E &e) : tensor() {
+    *this = e;
+}
 
-#elif defined(NORMAL) // ----- NORMAL OPERATOR OVERLOADING ----- // 
+template<expression::node E> requires (!std::is_same_v<E, tensor>)
+tensor &tensor::operator=(const E &e) {
+    const tensor *shape = e.shape();
+    resize(shape->m_rows, shape->m_cols, shape->m_channels);
+    evaluate(e);
+    return *this;
+}
 
-    // += 
-    tensor& operator+=(const tensor &tns) {
-        for(u32 i = 0; i < m_size; i++) m_ptr[i] += tns.m_ptr[i];
-        return *this;
-    }
+// elementwise, so reading and writing this tensor in the same pass is fine
+template<expression::operand T>
+tensor &tensor::operator+=(const T &x) {
+    evaluate(expression::combine<expression::add>(*this, x));
+    return *this;
+}
 
-    // -= 
-    tensor& operator-=(const tensor &tns) {
-        for(u32 i = 0; i < m_size; i++) m_ptr[i] -= tns.m_ptr[i];
-        return *this;
-    }
+template<expression::operand T>
+tensor &tensor::operator-=(const T &x) {
+    evaluate(expression::combine<expression::sub>(*this, x));
+    return *this;
+}
 
-    // *=
-    tensor& operator*=(const tensor &tns) {
-        for(u32 i = 0; i < m_size; i++) m_ptr[i] *= tns.m_ptr[i];
-        return *this;
-    }
-   
-    // += value
-    tensor& operator+=(const f32 value) {
-        for(u32 i = 0; i < m_size; i++) m_ptr[i] += value;
-        return *this;
-    }
-
-    // -= value
-    tensor& operator-=(const f32 value) {
-        for(u32 i = 0; i < m_size; i++) m_ptr[i] -= value;
-        return *this;
-    }
-
-    // *= value
-    tensor& operator*=(const f32 value) {
-        for(u32 i = 0; i < m_size; i++) m_ptr[i] *= value;
-        return *this;
-    }
-
-    // +
-    tensor operator+(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i++) nw.m_ptr[i] = m_ptr[i] + tns.m_ptr[i];
-        return nw;
-    }
-
-    // -
-    tensor operator-(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i++) nw.m_ptr[i] = m_ptr[i] - tns.m_ptr[i];
-        return nw;
-    }
-
-    // *
-    tensor operator*(const tensor &tns) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i++) nw.m_ptr[i] = m_ptr[i] * tns.m_ptr[i];
-        return nw;
-    }
-   
-    // + value
-    tensor operator+(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i++) nw.m_ptr[i] = m_ptr[i] + value;
-        return nw;
-    }
-
-    // - value
-    tensor operator-(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i++) nw.m_ptr[i] = m_ptr[i] - value;
-        return nw;
-    }
-
-    // * value
-    tensor operator*(const f32 value) {
-        tensor nw(m_rows, m_cols, m_channels);
-        for(u32 i = 0; i < m_size; i++) nw.m_ptr[i] = m_ptr[i] * value;
-        return nw;
-    }
-
-#endif // ----- END OF OPERATOR OVERLOADING ----- //
-};
+template<expression::operand T>
+tensor &tensor::operator*=(const T &x) {
+    evaluate(expression::combine<expression::mul>(*this, x));
+    return *this;
+}
 
 } // namespace pinguml
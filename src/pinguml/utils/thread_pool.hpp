@@ -0,0 +1,130 @@
+#pragma once
+
+#include "../../include.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace pinguml {
+
+// tasks 0..n-1, task i can start once its m_nr_dependencies[i] dependencies are done and then unblocks m_dependents[i]
+struct task_graph {
+    std::vector<u32> m_nr_dependencies;
+    std::vector<std::vector<u32>> m_dependents;
+
+    u32 size() const { return (u32)m_nr_dependencies.size(); }
+
+    void resize(const u32 n) {
+        m_nr_dependencies.assign(n, 0);
+        m_dependents.assign(n, {});
+    }
+
+    void add_dependency(const u32 task, const u32 dependency) {
+        m_nr_dependencies[task]++;
+        m_dependents[dependency].push_back(task);
+    }
+
+    // true if two tasks can ever run at the same time
+    bool parallel() const {
+        u32 roots = 0;
+        for (u32 i = 0; i < size(); i++) {
+            roots += !m_nr_dependencies[i];
+            if (m_dependents[i].size() > 1) return true;
+        }
+        return roots > 1;
+    }
+};
+
+/**
+ * runs task graphs on its workers and the calling thread, a task starts as soon as its dependencies are done. one
+ * graph runs at a time, try_run returns false without running anything if another thread is using the pool, so that
+ * callers on several threads can fall back to running their tasks themselves
+ */
+class task_graph_pool {
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_done;
+    std::atomic<bool> m_busy{false};
+    bool m_stop = false;
+
+    // the running graph
+    const task_graph *m_graph = nullptr;
+    const std::function<void(u32)> *m_run = nullptr;
+    std::vector<u32> m_remaining;
+    std::vector<u32> m_ready;
+    u32 m_nr_done = 0;
+
+    // runs ready tasks until there are none, the lock is held between tasks
+    void work(std::unique_lock<std::mutex> &lock) {
+        while (!m_ready.empty()) {
+            const u32 task = m_ready.back();
+            m_ready.pop_back();
+            lock.unlock();
+            (*m_run)(task);
+            lock.lock();
+            for (u32 dependent: m_graph->m_dependents[task])
+                if (!--m_remaining[dependent]) {
+                    m_ready.push_back(dependent);
+                    m_wake.notify_one();
+                }
+            if (++m_nr_done == m_graph->size()) m_done.notify_all();
+        }
+    }
+
+    void worker() {
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            m_wake.wait(lock, [&] { return m_stop || !m_ready.empty(); });
+            if (m_stop) return;
+            work(lock);
+        }
+    }
+
+public:
+    // nr_threads counts the calling thread
+    explicit task_graph_pool(const u32 nr_threads) {
+        for (u32 i = 1; i < nr_threads; i++)
+            m_workers.emplace_back(&task_graph_pool::worker, this);
+    }
+
+    task_graph_pool(const task_graph_pool &) = delete;
+    task_graph_pool &operator=(const task_graph_pool &) = delete;
+
+    ~task_graph_pool() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto &worker: m_workers) worker.join();
+    }
+
+    u32 nr_threads() const { return (u32)m_workers.size() + 1; }
+
+    bool try_run(const task_graph &graph, const std::function<void(u32)> &run) {
+        if (m_busy.exchange(true, std::memory_order_acquire)) return false;
+
+        std::unique_lock lock(m_mutex);
+        m_graph = &graph;
+        m_run = &run;
+        m_remaining = graph.m_nr_dependencies;
+        m_ready.clear();
+        for (u32 i = graph.size(); i-- > 0;)
+            if (!m_remaining[i]) m_ready.push_back(i);
+        m_nr_done = 0;
+        m_wake.notify_all();
+
+        work(lock);
+        m_done.wait(lock, [&] { return m_nr_done == graph.size(); });
+        m_graph = nullptr;
+        m_run = nullptr;
+        lock.unlock();
+
+        m_busy.store(false, std::memory_order_release);
+        return true;
+    }
+};
+
+} // namespace pinguml
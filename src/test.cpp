@@ -1,16 +1,24 @@
 #include "include.hpp"
 
 #include "heuristic/mcts/mcts.hpp"
+#include "heuristic/mcts/mcts_dag.hpp"
+#include "heuristic/mcts/puct.hpp"
 #include "heuristic/brute_force/n_move_solver.hpp"
 #include "heuristic/brute_force/one_move_solver.hpp"
 #include "heuristic/brute_force/transposition_table_solver.hpp"
 #include "heuristic/brute_force/two_move_solver.hpp"
 #include "heuristic/solver_variations/A.hpp"
 #include "heuristic/solver_variations/Abias.hpp"
+#include "heuristic/solver_variations/nn_alpha_beta.hpp"
 #include "heuristic/solver_variations/simple_n_move_solver.hpp"
 
-/*
+#include "neural_net_testing/accumulator.hpp"
+#include "neural_net_testing/tiny_dnn_quantization.hpp"
 #include "neural_net_testing/neural_net_player.hpp"
+#include "neural_net_testing/trainer.hpp"
+#include "pinguml/network.hpp"
+
+/*
 #include "neural_net_testing/neural_net_player_deep.hpp"
 
 #include "pinguml/utils/tensor.hpp"
@@ -105,6 +113,1653 @@ int main() {
 
         }
 
+        {
+            // test random playout performance, board based (as mcts used to do it) against the bitboard kernel
+            constexpr auto NUM_PLAYOUTS = 1 << 18;
+            gya::board const start;
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            mcts::playout_result board_result;
+            for (int i = 0; i < NUM_PLAYOUTS; ++i) {
+                gya::board game = start;
+                while (!game.has_won().is_game_over()) {
+                    auto moves = game.get_actions();
+                    game.play(moves[std::rand() % moves.size()]);
+                }
+                board_result.m_wins += game.has_won().player_1_won();
+                board_result.m_losses += game.has_won().player_2_won();
+                board_result.m_ties += game.has_won().is_tie();
+            }
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            mcts::playout_kernel<> kernel;
+            auto const kernel_result = kernel.run(start, NUM_PLAYOUTS);
+            auto const t3 = std::chrono::high_resolution_clock::now();
+            // both play uniformly random games, so the win, loss and tie rates have to agree up to sampling noise (the
+            // standard deviation of a rate is below 1e-3 for this many playouts)
+            auto rate_error = [&](u32 board_count, u32 kernel_count) {
+                return std::abs(static_cast<f64>(board_count) - static_cast<f64>(kernel_count)) / NUM_PLAYOUTS;
+            };
+            const f64 max_rate_error = std::max({rate_error(board_result.m_wins, kernel_result.m_wins),
+                                                 rate_error(board_result.m_losses, kernel_result.m_losses),
+                                                 rate_error(board_result.m_ties, kernel_result.m_ties)});
+            auto const board_time = std::chrono::duration<double>(t2 - t1).count();
+            auto const kernel_time = std::chrono::duration<double>(t3 - t2).count();
+            std::cout << "random playouts (wins / losses / ties of player one):\n";
+            std::cout << "board: " << NUM_PLAYOUTS / board_time << " playouts/s (" << board_result.m_wins << " / "
+                      << board_result.m_losses << " / " << board_result.m_ties << ")\n";
+            std::cout << "bitboard kernel: " << NUM_PLAYOUTS / kernel_time << " playouts/s (" << kernel_result.m_wins
+                      << " / " << kernel_result.m_losses << " / " << kernel_result.m_ties << "), "
+                      << board_time / kernel_time << "x" << std::endl;
+            if (kernel_result.size() != NUM_PLAYOUTS || max_rate_error > 1e-2) {
+                std::cout << "playout kernel is broken (rates differ by " << max_rate_error << ")" << std::endl;
+                return 0;
+            }
+        }
+
+        {
+            // test the incremental first layer against full evaluations at every leaf of a depth 4 search tree
+            using player_t = gya::neural_net_player<>;
+            using accumulator_t = gya::first_layer_accumulator<player_t::neural_net_t>;
+            player_t player;
+            const accumulator_t::weights weights{player.m_net};
+            gya::board root;
+            gya::random_player p;
+            while (root.num_played_moves() < 10) {
+                root.play(p(root));
+                if (root.has_won().is_game_over()) root = {};
+            }
+
+            constexpr i32 DEPTH = 4;
+            f32 max_error = 0, full_sum = 0, incremental_sum = 0;
+            auto walk = [&](auto &self, gya::board const &b, accumulator_t &acc, i32 depth, auto const &leaf) -> void {
+                if (!depth || b.has_won().is_game_over()) {
+                    leaf(b, acc);
+                    return;
+                }
+                for (u8 move: b.get_actions()) {
+                    gya::board next = b.play_copy(move);
+                    acc.play(weights, next, move);
+                    self(self, next, acc, depth - 1, leaf);
+                    acc.undo(weights, next, move);
+                }
+            };
+            accumulator_t acc;
+            acc.refresh(weights, root);
+            walk(walk, root, acc, DEPTH, [&](gya::board const &b, accumulator_t const &a) {
+                auto input = player_t::encode(b);
+                const auto full = player.m_net.evaluate_const(input);
+                const auto incremental = a.evaluate(weights, player.m_net, b.turn());
+                for (usize i = 0; i < full.size(); ++i)
+                    max_error = std::max(max_error, std::abs(full[i] - incremental[i]));
+            });
+
+            constexpr auto NUM_WALKS = 16;
+            usize num_leaves = 0;
+            auto const t0 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_WALKS; ++i)
+                walk(walk, root, acc, DEPTH, [&](gya::board const &, accumulator_t const &) { ++num_leaves; });
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_WALKS; ++i)
+                walk(walk, root, acc, DEPTH, [&](gya::board const &b, accumulator_t const &) {
+                    auto input = player_t::encode(b);
+                    full_sum += player.m_net.evaluate_const(input)[0];
+                });
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_WALKS; ++i)
+                walk(walk, root, acc, DEPTH, [&](gya::board const &b, accumulator_t const &a) {
+                    incremental_sum += a.evaluate(weights, player.m_net, b.turn())[0];
+                });
+            auto const t3 = std::chrono::high_resolution_clock::now();
+            std::cout << "first layer accumulator (depth " << DEPTH << " tree walk, " << num_leaves / NUM_WALKS
+                      << " leaves):\n";
+            std::cout << "no evaluation: " << std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_WALKS
+                      << "ms\n";
+            std::cout << "full evaluation: " << std::chrono::duration<double, std::milli>(t2 - t1).count() / NUM_WALKS
+                      << "ms\n";
+            std::cout << "incremental: " << std::chrono::duration<double, std::milli>(t3 - t2).count() / NUM_WALKS
+                      << "ms (max error " << max_error << ", " << full_sum - incremental_sum << ")" << std::endl;
+            if (max_error > 1e-2f) {
+                std::cout << "first layer accumulator is broken" << std::endl;
+                return 0;
+            }
+
+            // the alpha-beta search on top of the accumulator against a negamax without pruning that runs the full
+            // net at every leaf
+            auto negamax = [&](auto &self, gya::board const &b, u32 depth, u32 ply) -> f32 {
+                using searcher_t = heuristic::nn_alpha_beta<player_t>;
+                if (const gya::game_result result = b.has_won(); result.is_game_over())
+                    return result.is_tie() ? 0 : -(searcher_t::WIN - static_cast<f32>(ply) * 1e-3f);
+                if (!depth) {
+                    auto input = player_t::encode(b);
+                    const auto q = player.m_net.evaluate_const(input);
+                    f32 mx = -std::numeric_limits<f32>::max();
+                    for (u8 move: b.get_actions())
+                        mx = std::max(mx, q[move]);
+                    return std::clamp(mx, -1.0f, 1.0f);
+                }
+                f32 best = -searcher_t::WIN - 1;
+                for (u8 move: b.get_actions())
+                    best = std::max(best, -self(self, b.play_copy(move), depth - 1, ply + 1));
+                return best;
+            };
+            constexpr u32 SEARCH_DEPTH = 4;
+            const heuristic::nn_alpha_beta<player_t> searcher{player, SEARCH_DEPTH};
+            f32 max_search_error = 0;
+            f64 full_time = 0, alpha_beta_time = 0;
+            for (int i = 0; i < 8; ++i) {
+                gya::board b;
+                while (b.num_played_moves() < 6 + 2 * i) {
+                    b.play(p(b));
+                    if (b.has_won().is_game_over()) b = {};
+                }
+                auto const s0 = std::chrono::high_resolution_clock::now();
+                const f32 expected = negamax(negamax, b, SEARCH_DEPTH, 0);
+                auto const s1 = std::chrono::high_resolution_clock::now();
+                const f32 actual = searcher.evaluate_board(b);
+                auto const s2 = std::chrono::high_resolution_clock::now();
+                full_time += std::chrono::duration<double, std::milli>(s1 - s0).count();
+                alpha_beta_time += std::chrono::duration<double, std::milli>(s2 - s1).count();
+                max_search_error = std::max(max_search_error, std::abs(expected - actual));
+            }
+            std::cout << "depth " << SEARCH_DEPTH << " search: full negamax " << full_time / 8
+                      << "ms, alpha-beta with accumulator " << alpha_beta_time / 8 << "ms (max error "
+                      << max_search_error << ")" << std::endl;
+
+            // player one threatens column 0, player two has to block it and player one takes the win if it can
+            gya::board threat;
+            for (u8 move: {0, 1, 0, 1, 0})
+                threat.play(move);
+            gya::board win = threat.play_copy(1);
+            if (max_search_error > 1e-2f || searcher(threat) != 0 || searcher(win) != 0) {
+                std::cout << "accumulator alpha-beta search is broken" << std::endl;
+                return 0;
+            }
+        }
+
+        {
+            // test the gradients of the trainer against finite differences
+            auto f = [](f64 x) { return std::tanh(x); };
+            auto df = [](f64 y) { return 1 - y * y; };
+            using net_t = gya::neural_net<false, false, f64, decltype(f), decltype(df), 6, 5, 3>;
+            net_t net{f, df};
+            net.update_randomly(1);
+            std::array<f64, 6> input{0.5, -1, 0.25, 1, 0, -0.75};
+            std::array<f64, 3> target{0.3, -0.2, 0.9};
+            auto loss = [&] {
+                gya::layer_array<f64, 6, 5, 3> values;
+                auto const out = net.forward_propagate(input, values);
+                f64 sum = 0;
+                for (usize i = 0; i < out.size(); ++i)
+                    sum += (out[i] - target[i]) * (out[i] - target[i]) / 2;
+                return sum;
+            };
+            gya::layer_array<f64, 6, 5, 3> values, deltas, bias_gradients;
+            gya::weight_array<f64, 6, 5, 3> weight_gradients;
+            [[maybe_unused]] auto const out = net.forward_propagate(input, values);
+            net.accumulate_gradients(values, target, deltas, weight_gradients, bias_gradients);
+            constexpr f64 EPS = 1e-6;
+            for (usize i = 0; i < net.m_weights.m_data.size(); ++i) {
+                net.m_weights.m_data[i] += EPS;
+                const f64 l1 = loss();
+                net.m_weights.m_data[i] -= 2 * EPS;
+                const f64 l2 = loss();
+                net.m_weights.m_data[i] += EPS;
+                if (std::abs((l1 - l2) / (2 * EPS) - weight_gradients.m_data[i]) > 1e-6) {
+                    std::cout << "neural net gradients are broken" << std::endl;
+                    return 0;
+                }
+            }
+        }
+
+        {
+            // compare the fused sgd step with backward_propagate + apply_gradients on the same samples
+            using player_t = gya::neural_net_player<>;
+            using net_t = player_t::neural_net_t;
+            constexpr usize NUM_STEPS = 1 << 14;
+            player_t p1;
+            player_t p2 = p1;
+            net_t::gradient_workspace workspace;
+            player_t::layer_array_t values;
+            std::array<f32, 42> input{};
+            std::array<f32, gya::BOARD_WIDTH> target{};
+            std::mt19937_64 rng{1};
+            auto next_sample = [&](usize i) {
+                input[i % input.size()] = static_cast<f32>(static_cast<i32>(rng() % 3) - 1);
+                target[i % target.size()] = static_cast<f32>(rng() % 2);
+            };
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (usize i = 0; i < NUM_STEPS; ++i) {
+                next_sample(i);
+                [[maybe_unused]] auto const out = p1.m_net.forward_propagate(input, values);
+                p1.m_net.backward_propagate(values, target, workspace);
+                p1.m_net.apply_gradients(workspace, 0.01f);
+            }
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            rng.seed(1);
+            input = {}, target = {};
+            for (usize i = 0; i < NUM_STEPS; ++i) {
+                next_sample(i);
+                [[maybe_unused]] auto const out = p2.m_net.forward_propagate(input, values);
+                p2.m_net.sgd_step(values, target, 0.01f);
+            }
+            auto const t3 = std::chrono::high_resolution_clock::now();
+            f32 max_difference = 0;
+            for (usize i = 0; i < p1.m_net.m_weights.m_data.size(); ++i)
+                max_difference = std::max(max_difference,
+                                          std::abs(p1.m_net.m_weights.m_data[i] - p2.m_net.m_weights.m_data[i]));
+            // the packed copy that sgd_step updates has to match the weights
+            auto const out1 = p1.m_net.evaluate_const(input), out2 = p2.m_net.evaluate_const(input);
+            for (usize i = 0; i < out1.size(); ++i)
+                max_difference = std::max(max_difference, std::abs(out1[i] - out2[i]));
+            if (max_difference > 1e-4f) {
+                std::cout << "fused sgd step is broken (" << max_difference << ")" << std::endl;
+                return 0;
+            }
+            std::cout << "single sample sgd steps:\n";
+            std::cout << "backward + apply: " << NUM_STEPS / std::chrono::duration<double>(t2 - t1).count() << "/s\n";
+            std::cout << "fused: " << NUM_STEPS / std::chrono::duration<double>(t3 - t2).count() << "/s" << std::endl;
+        }
+
+        {
+            // test training throughput, the nets learn how full every column is
+            using player_t = gya::neural_net_player<>;
+            using net_t = player_t::neural_net_t;
+            constexpr usize NUM_SAMPLES = 1 << 14;
+            constexpr usize BATCH_SIZE = 64;
+            constexpr usize NUM_EPOCHS = 8;
+            std::vector<f32> inputs, targets;
+            gya::random_player p;
+            while (inputs.size() < NUM_SAMPLES * 42) {
+                gya::board b;
+                while (!b.has_won().is_game_over() && inputs.size() < NUM_SAMPLES * 42) {
+                    const auto input = player_t::encode(b);
+                    inputs.insert(inputs.end(), input.begin(), input.end());
+                    for (usize col = 0; col < gya::BOARD_WIDTH; ++col)
+                        targets.push_back(static_cast<f32>(b[col].height) / gya::BOARD_HEIGHT);
+                    b.play(p(b));
+                }
+            }
+
+            auto test_optimizer = [&](std::string_view name, gya::optimizer opt, f32 learning_rate) {
+                player_t player;
+                gya::trainer<net_t> t{player.m_net, opt, learning_rate};
+                f32 first_loss = 0, last_loss = 0;
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (usize epoch = 0; epoch < NUM_EPOCHS; ++epoch) {
+                    last_loss = t.train_epoch(inputs, targets, NUM_SAMPLES, BATCH_SIZE, epoch);
+                    if (!epoch) first_loss = last_loss;
+                }
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                std::cout << name << ": " << NUM_SAMPLES * NUM_EPOCHS / std::chrono::duration<double>(t2 - t1).count()
+                          << " samples/s, loss " << first_loss << " -> " << last_loss << std::endl;
+                return last_loss < first_loss;
+            };
+            std::cout << "neural net training (batch size " << BATCH_SIZE << ", " << omp_get_max_threads()
+                      << " threads):\n";
+            if (!test_optimizer("sgd", gya::optimizer::SGD, 4.0f) || !test_optimizer("adam", gya::optimizer::ADAM, 1e-3f)) {
+                std::cout << "neural net training is broken" << std::endl;
+                return 0;
+            }
+
+            // the team may grow after the trainer was made
+            const int max_threads = omp_get_max_threads();
+            omp_set_num_threads(1);
+            player_t player;
+            gya::trainer<net_t> t{player.m_net, gya::optimizer::SGD, 1.0f};
+            t.train_batch(inputs, targets, BATCH_SIZE);
+            omp_set_num_threads(max_threads + 3);
+            const f32 loss = t.train_batch(inputs, targets, BATCH_SIZE);
+            omp_set_num_threads(max_threads);
+            if (!std::isfinite(loss)) {
+                std::cout << "neural net training with more threads is broken" << std::endl;
+                return 0;
+            }
+        }
+
+        {
+            // test leaf evaluation throughput, one position at a time against batches from the inference thread. the
+            // net of neural_net_player is so small that batching can't pay for the queue, the wider net can
+            constexpr auto NUM_POSITIONS = 1 << 14;
+            std::vector<gya::board> positions;
+            gya::random_player p{30};
+            while (positions.size() < NUM_POSITIONS) {
+                gya::board b;
+                while (!b.has_won().is_game_over() && positions.size() < NUM_POSITIONS) {
+                    positions.push_back(b);
+                    b.play(p(b));
+                }
+            }
+            std::vector<mcts::evaluation> results(NUM_POSITIONS);
+
+            auto benchmark = [&](std::string_view name, auto const &evaluator) {
+                using evaluator_t = std::remove_cvref_t<decltype(evaluator)>;
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (usize i = 0; i < NUM_POSITIONS; ++i)
+                    evaluator(std::span{positions}.subspan(i, 1), std::span{results}.subspan(i, 1));
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                std::cout << "leaf evaluation with " << name << ":\n";
+                std::cout << "one at a time: " << NUM_POSITIONS / std::chrono::duration<double>(t2 - t1).count()
+                          << " positions/s\n";
+                for (usize batch_size: {8, 64}) {
+                    mcts::batch_queue<evaluator_t> queue{evaluator, batch_size};
+                    std::atomic<u32> pending{NUM_POSITIONS};
+                    auto const t3 = std::chrono::high_resolution_clock::now();
+                    for (usize i = 0; i < NUM_POSITIONS; ++i)
+                        queue.submit(positions[i], &results[i], &pending);
+                    for (u32 left = pending.load(); left; left = pending.load())
+                        pending.wait(left);
+                    auto const t4 = std::chrono::high_resolution_clock::now();
+                    std::cout << "batch queue (" << batch_size << "): "
+                              << NUM_POSITIONS / std::chrono::duration<double>(t4 - t3).count() << " positions/s ("
+                              << static_cast<double>(queue.m_num_positions) / queue.m_num_batches
+                              << " positions/batch)\n";
+                }
+                std::cout.flush();
+            };
+            benchmark("neural_net_player", mcts::neural_net_evaluator<gya::neural_net_player<>>{});
+
+            using wide_net_t = gya::neural_net<false, false, f32, decltype(gya::fast_activation_function),
+                                               decltype(gya::fast_activation_derivative), 42, 512, 512, 7>;
+            auto wide_net = std::make_shared<wide_net_t>(gya::fast_activation_function,
+                                                         gya::fast_activation_derivative);
+            std::mt19937 weight_gen{30};
+            std::uniform_real_distribution<f32> weight_dist{-0.1f, 0.1f};
+            for (auto &w: wide_net->m_weights.m_data) w = weight_dist(weight_gen);
+            for (auto &b: wide_net->m_biases.m_data) b = weight_dist(weight_gen);
+            wide_net->pack();
+            benchmark("a 42-512-512-7 net", mcts::shared_net_evaluator<wide_net_t>{wide_net});
+        }
+
+        {
+            // test the simd forward pass against the scalar one
+            gya::neural_net_player<> p;
+            using layer_array_t = gya::neural_net_player<>::layer_array_t;
+            constexpr auto NUM_EVALS = 1 << 18;
+            std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT> input{};
+            gya::random_player rng;
+            for (auto &x: input)
+                x = static_cast<f32>(static_cast<i32>(rng.get_num() % 3) - 1);
+
+            layer_array_t v1, v2;
+            [[maybe_unused]] auto o1 = p.m_net.forward_propagate_scalar(input, v1);
+            [[maybe_unused]] auto o2 = p.m_net.forward_propagate(input, v2);
+            for (usize i = 0; i < v1.m_data.size(); ++i) {
+                if (std::abs(v1.m_data[i] - v2.m_data[i]) > 1e-4f) {
+                    std::cout << "simd forward pass is broken" << std::endl;
+                    return 0;
+                }
+            }
+            // boards with few pieces take the sparse path
+            std::array<f32, gya::BOARD_WIDTH * gya::BOARD_HEIGHT> sparse_input{};
+            for (usize pieces = 0; pieces <= sparse_input.size(); ++pieces) {
+                sparse_input.fill(0.f);
+                for (usize i = 0; i < pieces; ++i)
+                    sparse_input[rng.get_num() % sparse_input.size()] = i % 2 ? 1.f : -1.f;
+                [[maybe_unused]] auto s1 = p.m_net.forward_propagate_scalar(sparse_input, v1);
+                [[maybe_unused]] auto s2 = p.m_net.forward_propagate(sparse_input, v2);
+                for (usize i = 0; i < v1.m_data.size(); ++i) {
+                    if (std::abs(v1.m_data[i] - v2.m_data[i]) > 1e-4f) {
+                        std::cout << "sparse forward pass is broken" << std::endl;
+                        return 0;
+                    }
+                }
+            }
+
+            f32 sum = 0;
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_EVALS; ++i) {
+                input[i % input.size()] = -input[i % input.size()];
+                sum += p.m_net.forward_propagate_scalar(input, v1)[0];
+            }
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_EVALS; ++i) {
+                input[i % input.size()] = -input[i % input.size()];
+                sum += p.m_net.forward_propagate(input, v2)[0];
+            }
+            auto const t3 = std::chrono::high_resolution_clock::now();
+            sparse_input.fill(0.f);
+            for (usize i = 0; i < 8; ++i)
+                sparse_input[i * 5] = i % 2 ? 1.f : -1.f;
+            for (int i = 0; i < NUM_EVALS; ++i) {
+                sparse_input[i % 8 * 5] = -sparse_input[i % 8 * 5];
+                sum += p.m_net.forward_propagate(sparse_input, v2)[0];
+            }
+            auto const t_sparse = std::chrono::high_resolution_clock::now();
+            constexpr auto BATCH_SIZE = 256;
+            std::vector<f32> batch_inputs(BATCH_SIZE * input.size()), batch_outputs(BATCH_SIZE * gya::BOARD_WIDTH);
+            for (auto &x: batch_inputs)
+                x = static_cast<f32>(static_cast<i32>(rng.get_num() % 3) - 1);
+            p.m_net.evaluate_batch(batch_inputs, BATCH_SIZE, batch_outputs);
+            for (usize i = 0; i < BATCH_SIZE; ++i) {
+                std::copy_n(batch_inputs.begin() + static_cast<isize>(i * input.size()), input.size(), input.begin());
+                auto const out = p.m_net.forward_propagate_scalar(input, v1);
+                for (usize j = 0; j < gya::BOARD_WIDTH; ++j) {
+                    if (std::abs(out[j] - batch_outputs[i * gya::BOARD_WIDTH + j]) > 1e-4f) {
+                        std::cout << "batched forward pass is broken" << std::endl;
+                        return 0;
+                    }
+                }
+            }
+            auto const t4 = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < NUM_EVALS / BATCH_SIZE; ++i) {
+                batch_inputs[i % batch_inputs.size()] = -batch_inputs[i % batch_inputs.size()];
+                p.m_net.evaluate_batch(batch_inputs, BATCH_SIZE, batch_outputs);
+                sum += batch_outputs[0];
+            }
+            auto const t5 = std::chrono::high_resolution_clock::now();
+            std::cout << "neural net forward pass:\n";
+            std::cout << "scalar: " << std::chrono::duration<double, std::nano>(t2 - t1).count() / NUM_EVALS << "ns\n";
+            std::cout << "simd: " << std::chrono::duration<double, std::nano>(t3 - t2).count() / NUM_EVALS << "ns\n";
+            std::cout << "simd, 8 pieces: " << std::chrono::duration<double, std::nano>(t_sparse - t3).count() / NUM_EVALS
+                      << "ns\n";
+            std::cout << "simd batch of " << BATCH_SIZE << ": "
+                      << std::chrono::duration<double, std::nano>(t5 - t4).count() / NUM_EVALS << "ns/position ("
+                      << sum << ")" << std::endl;
+        }
+
+        {
+            // round trip through the binary format and compare it with the text format
+            gya::neural_net_player p1, p2, p3;
+            const std::string path = "/tmp/gya_test.neural_net";
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            const std::string text = p1.m_net.to_string();
+            p2.m_net.from_string(text);
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            p1.m_net.save(path);
+            const bool mapped = p3.m_net.load(path);
+            auto const t3 = std::chrono::high_resolution_clock::now();
+            std::array<f32, 42> input{};
+            input[3] = 1, input[10] = -1;
+            if (!mapped || p3.m_net != p1.m_net || p3.m_net.evaluate_const(input) != p1.m_net.evaluate_const(input)) {
+                std::cout << "binary neural net format is broken" << std::endl;
+                return 0;
+            }
+            std::fstream corrupt(path, std::ios::in | std::ios::out | std::ios::binary);
+            corrupt.seekp(-1, std::ios::end);
+            corrupt.put('x');
+            corrupt.close();
+            bool detected = false;
+            try {
+                p3.m_net.load(path);
+            } catch (std::runtime_error const &) {
+                detected = true;
+            }
+            if (!detected) {
+                std::cout << "binary neural net checksum is broken" << std::endl;
+                return 0;
+            }
+            std::cout << "neural net serialization:\n";
+            std::cout << "text: " << text.size() << " bytes, "
+                      << std::chrono::duration<double, std::micro>(t2 - t1).count() << "us\n";
+            std::cout << "binary: " << std::filesystem::file_size(path) << " bytes, "
+                      << std::chrono::duration<double, std::micro>(t3 - t2).count() << "us" << std::endl;
+            std::filesystem::remove(path);
+        }
+
+        {
+            // compare the int8 copies of a neural_net and of a trained tiny_dnn net against their f32 versions, the
+            // positions and the random net are seeded
+            std::vector<gya::board> positions;
+            gya::random_player p{35};
+            while (positions.size() < 512) {
+                gya::board b;
+                while (!b.has_won().is_game_over() && positions.size() < 512) {
+                    positions.push_back(b);
+                    b.play(p(b));
+                }
+            }
+            auto best_move = [](gya::board const &b, std::span<const f32> output) {
+                u8 move = 0;
+                f32 best = -std::numeric_limits<f32>::max();
+                for (u8 col = 0; col < gya::BOARD_WIDTH; ++col) {
+                    if (b[col].height < gya::BOARD_HEIGHT && output[col] > best) {
+                        best = output[col];
+                        move = col;
+                    }
+                }
+                return move;
+            };
+            // reference gives the outputs the int8 net is checked against, evaluate_f32 is the f32 kernel it is timed
+            // against
+            auto compare = [&](std::string_view name, usize f32_bytes, usize int8_bytes, auto const &encode,
+                               auto const &reference, auto const &evaluate_f32, auto const &quantized,
+                               usize num_repeats, f64 min_same_moves) {
+                std::vector<std::vector<f32>> inputs, outputs;
+                for (auto const &b: positions) {
+                    inputs.push_back(encode(b));
+                    const auto output = reference(inputs.back());
+                    outputs.emplace_back(output.begin(), output.end());
+                }
+                f32 max_error = 0, sum = 0;
+                usize same_moves = 0;
+                for (usize i = 0; i < positions.size(); ++i) {
+                    auto const out = quantized.evaluate(inputs[i]);
+                    for (usize j = 0; j < out.size(); ++j)
+                        max_error = std::max(max_error, std::abs(out[j] - outputs[i][j]));
+                    same_moves += best_move(positions[i], out) == best_move(positions[i], outputs[i]);
+                }
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (usize r = 0; r < num_repeats; ++r)
+                    for (auto const &input: inputs)
+                        sum += evaluate_f32(input)[0];
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                std::array<f32, gya::BOARD_WIDTH> out;
+                for (usize r = 0; r < num_repeats; ++r) {
+                    for (auto const &input: inputs) {
+                        quantized.evaluate(input, out);
+                        sum += out[0];
+                    }
+                }
+                auto const t3 = std::chrono::high_resolution_clock::now();
+                const auto num_evals = static_cast<f64>(num_repeats * inputs.size());
+                std::cout << name << " (" << f32_bytes / 1024 << "KiB f32, " << int8_bytes / 1024 << "KiB int8):\n";
+                std::cout << "f32: " << std::chrono::duration<double, std::micro>(t2 - t1).count() / num_evals
+                          << "us, int8: " << std::chrono::duration<double, std::micro>(t3 - t2).count() / num_evals
+                          << "us, max error " << max_error << ", same move " << 100.0 * same_moves / positions.size()
+                          << "% (" << sum << ")" << std::endl;
+                if (static_cast<f64>(same_moves) < min_same_moves * static_cast<f64>(positions.size())) {
+                    std::cout << "quantized inference is broken" << std::endl;
+                    std::exit(0);
+                }
+            };
+
+            gya::neural_net_player player;
+            std::mt19937 weight_gen{35};
+            std::uniform_real_distribution<f32> weight_dist{-1.f, 1.f};
+            for (auto &w: player.m_net.m_weights.m_data) w = weight_dist(weight_gen);
+            for (auto &b: player.m_net.m_biases.m_data) b = weight_dist(weight_gen);
+            player.m_net.pack();
+            const auto quantized_player = gya::quantize(player.m_net);
+            auto evaluate_player = [&](std::vector<f32> const &input) {
+                std::array<f32, gya::BOARD_WIDTH> out;
+                player.m_net.evaluate_batch(input, 1, out);
+                return out;
+            };
+            compare("quantized neural_net", player.m_net.m_weights.m_data.size() * sizeof(f32),
+                    quantized_player.weight_bytes(), [](gya::board const &b) {
+                        const auto input = gya::neural_net_player<>::encode(b);
+                        return std::vector<f32>(input.begin(), input.end());
+                    }, evaluate_player, evaluate_player, quantized_player, 64, 0.99);
+
+            // same architecture as in nn_test.cpp
+            constexpr usize KERNEL_SIZE = 4;
+            tiny_dnn::network<tiny_dnn::sequential> net;
+            net << tiny_dnn::convolutional_layer(7, 6, KERNEL_SIZE, 1, 256)
+                << tiny_dnn::tanh_layer(7 - KERNEL_SIZE + 1, 6 - KERNEL_SIZE + 1, 256)
+                << tiny_dnn::fully_connected_layer((7 - KERNEL_SIZE + 1) * (6 - KERNEL_SIZE + 1) * 256, 64)
+                << tiny_dnn::tanh_layer()
+                << tiny_dnn::fully_connected_layer(64, 64)
+                << tiny_dnn::tanh_layer()
+                << tiny_dnn::fully_connected_layer(64, 7);
+            std::ifstream in_file("../data/Q-K4-L10-R3-2023-01-31-22-56-53.network_data");
+            in_file >> net;
+            const auto quantized_net = gya::quantize(net);
+            usize num_weights = 0;
+            for (usize i = 0; i < net.layer_size(); ++i)
+                if (auto const weights = std::as_const(*net[i]).weights(); !weights.empty())
+                    num_weights += weights[0]->size();
+
+            // the same layers as a gya::neural_net for the f32 timing, it also applies tanh to the last layer
+            const auto dense = gya::dense_layers(net);
+            using dense_net_t = gya::neural_net<false, false, f32, gya::tanh_activation,
+                                                decltype(gya::tanh_activation_derivative), 42, 3072, 64, 64, 7>;
+            auto dense_net = std::make_unique<dense_net_t>(gya::tanh_activation{}, gya::tanh_activation_derivative);
+            for (usize layer = 0; layer < dense.size(); ++layer) {
+                gya::dense_layer const &l = dense[layer];
+                for (usize in = 0; in < l.m_num_inputs; ++in)
+                    for (usize out = 0; out < l.m_num_outputs; ++out)
+                        dense_net->m_weights[layer][in][out] = l.m_weights[in * l.m_num_outputs + out];
+                std::copy(l.m_biases.begin(), l.m_biases.end(), dense_net->m_biases[layer + 1].begin());
+            }
+            dense_net->pack();
+            auto encode_tiny_dnn = [](gya::board const &b) {
+                std::vector<f32> input;
+                for (i32 i = gya::BOARD_HEIGHT - 1; i >= 0; i--)
+                    for (i32 j = 0; j < gya::BOARD_WIDTH; j++)
+                        input.push_back(b[j][i]);
+                return input;
+            };
+            f32 dense_error = 0;
+            for (usize i = 0; i < 64; ++i) {
+                auto input = encode_tiny_dnn(positions[i]);
+                const auto expected = net.predict(input);
+                const auto actual = dense_net->evaluate_const(input);
+                for (usize j = 0; j < actual.size(); ++j)
+                    dense_error = std::max(dense_error, std::abs(std::tanh(expected[j]) - actual[j]));
+            }
+            if (dense_error > 1e-3f) {
+                std::cout << "dense copy of a tiny_dnn net is broken (" << dense_error << ")" << std::endl;
+                return 0;
+            }
+            compare("quantized tiny_dnn net", num_weights * sizeof(f32), quantized_net.weight_bytes(), encode_tiny_dnn,
+                    [&](std::vector<f32> const &input) { return net.predict(input); },
+                    [&](std::vector<f32> const &input) {
+                        std::array<f32, gya::BOARD_WIDTH> out;
+                        dense_net->evaluate_batch(input, 1, out);
+                        return out;
+                    }, quantized_net, 16, 0.99);
+        }
+
+        {
+            // vectorized pinguml activations against the scalar std:: versions and the per element derivative, the
+            // derivatives against finite differences
+            constexpr u32 SIZE = 1 << 12;
+            std::mt19937 gen{42};
+            std::uniform_real_distribution<f32> dist{-10.f, 10.f};
+            // odd size for the scalar tail
+            std::vector<f32> input(SIZE + 3), biases(SIZE + 3);
+            for (u32 i = 0; i < SIZE + 3; i++) {
+                input[i] = dist(gen);
+                biases[i] = dist(gen) * 0.1f;
+            }
+            for (std::string const name: {"tanh", "sigmoid", "elu", "relu", "lrelu", "vlrelu"}) {
+                std::unique_ptr<pinguml::activation_base> f{pinguml::create_activation(name)};
+                const f32 slope = name == "relu" ? 0.f : name == "lrelu" ? 0.01f : 0.3f;
+                const i32 kind = name == "tanh" ? 0 : name == "sigmoid" ? 1 : name == "elu" ? 2 : 3;
+                auto const reference = [=](auto x) -> decltype(x) {
+                    using real = decltype(x);
+                    if (kind == 0) return std::tanh(x);
+                    if (kind == 1) return real(1) / (real(1) + std::exp(-x));
+                    if (kind == 2) return x < 0 ? real(0.1f) * (std::exp(x) - real(1)) : x;
+                    return x < 0 ? real(slope) * x : x;
+                };
+                std::vector<f32> y = input, expected(SIZE + 3), z(SIZE + 3), delta(SIZE + 3, 1.f);
+                f->activation(y.data(), biases.data(), SIZE + 3);
+                for (u32 i = 0; i < SIZE + 3; i++) {
+                    expected[i] = reference(input[i] + biases[i]);
+                    // outputs near 0, where the derivatives change the most
+                    z[i] = expected[i] * 0.1f;
+                }
+                f->activation_d_tensor(z.data(), delta.data(), SIZE + 3);
+                f32 error = 0, error_d = 0;
+                for (u32 i = 0; i < SIZE + 3; i++) {
+                    error = std::max(error, std::abs(y[i] - expected[i]));
+                    error_d = std::max(error_d, std::abs(delta[i] - f->activation_d(z.data(), i)));
+                }
+                // the derivatives take the outputs, away from the kinks of elu and the relus
+                std::vector<f32> delta_fd(SIZE + 3, 1.f);
+                f->activation_d_tensor(expected.data(), delta_fd.data(), SIZE + 3);
+                f32 error_fd = 0;
+                for (u32 i = 0; i < SIZE + 3; i++) {
+                    const f64 x = static_cast<f64>(input[i]) + static_cast<f64>(biases[i]), h = 1e-5;
+                    if (std::abs(x) < 1e-3) continue;
+                    const auto fd = static_cast<f32>((reference(x + h) - reference(x - h)) / (2 * h));
+                    error_fd = std::max({error_fd, std::abs(delta_fd[i] - fd),
+                                         std::abs(f->activation_d(expected.data(), i) - fd)});
+                }
+                if (error > 1e-6f || error_d > 1e-6f || error_fd > 1e-4f) {
+                    std::cout << "pinguml " << name << " is broken: " << error << ", " << error_d << ", " << error_fd
+                              << std::endl;
+                    return 0;
+                }
+
+                constexpr auto NUM_ITERS = 1 << 10;
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (u32 i = 0; i < NUM_ITERS; i++) {
+                    f->activation_c(y.data(), 0.f, SIZE);
+                    f->activation_d_tensor(z.data(), delta.data(), SIZE);
+                }
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                for (u32 i = 0; i < NUM_ITERS; i++) {
+                    for (u32 j = 0; j < SIZE; j++)
+                        y[j] = reference(y[j]);
+                    for (u32 j = 0; j < SIZE; j++)
+                        delta[j] *= f->activation_d(z.data(), j);
+                }
+                auto const t3 = std::chrono::high_resolution_clock::now();
+                std::cout << "pinguml " << name << ": max error " << error << ", derivative " << error_d << ", "
+                          << std::chrono::duration<f64, std::nano>(t2 - t1).count() / NUM_ITERS / SIZE
+                          << "ns per element, " << std::chrono::duration<f64, std::nano>(t3 - t2).count() / NUM_ITERS / SIZE
+                          << "ns scalar" << std::endl;
+            }
+        }
+
+        {
+            // pinguml gemm against a naive product, then GFLOP/s of the batched fully_connected shapes
+            std::mt19937 gen{7};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            auto random_vector = [&](usize size) {
+                std::vector<f32> v(size);
+                for (auto &x: v) x = dist(gen);
+                return v;
+            };
+            for (u32 trans = 0; trans < 4; trans++) {
+                const bool trans_a = trans & 1, trans_b = trans & 2;
+                constexpr u32 M = 37, N = 45, K = 300;
+                const std::vector<f32> a = random_vector(M * K), b = random_vector(K * N);
+                std::vector<f32> c = random_vector(M * N), expected = c;
+                pinguml::gemm(trans_a, trans_b, M, N, K, a.data(), trans_a ? M : K, b.data(), trans_b ? K : N, c.data(), N);
+                f32 error = 0;
+                for (u32 i = 0; i < M; i++)
+                    for (u32 j = 0; j < N; j++) {
+                        f64 sum = expected[i * N + j];
+                        for (u32 p = 0; p < K; p++)
+                            sum += (trans_a ? a[p * M + i] : a[i * K + p]) * (trans_b ? b[j * K + p] : b[p * N + j]);
+                        error = std::max(error, std::abs(c[i * N + j] - static_cast<f32>(sum)));
+                    }
+                if (error > 1e-4f) {
+                    std::cout << "pinguml gemm is broken: " << error << std::endl;
+                    return 0;
+                }
+            }
+
+            constexpr u32 BATCH = 256;
+            for (auto const &[in, out]: {std::pair{42u, 128u}, {128u, 128u}, {128u, 7u}, {512u, 512u}}) {
+                const std::vector<f32> x = random_vector(BATCH * in), w = random_vector(out * in), dy = random_vector(BATCH * out);
+                std::vector<f32> y(BATCH * out), dx(BATCH * in), dw(out * in);
+                auto gflops = [&](auto f) {
+                    constexpr auto NUM_ITERS = 64;
+                    auto const t1 = std::chrono::high_resolution_clock::now();
+                    for (u32 i = 0; i < NUM_ITERS; i++) f();
+                    auto const t2 = std::chrono::high_resolution_clock::now();
+                    return 2.0 * BATCH * in * out * NUM_ITERS / std::chrono::duration<f64, std::nano>(t2 - t1).count();
+                };
+                const f64 forward = gflops([&] { pinguml::gemm(false, true, BATCH, out, in, x.data(), in, w.data(), in, y.data(), out); });
+                const f64 propogate = gflops([&] { pinguml::gemm(false, false, BATCH, in, out, dy.data(), out, w.data(), in, dx.data(), in); });
+                const f64 gradient = gflops([&] { pinguml::gemm(true, false, out, in, BATCH, dy.data(), out, x.data(), in, dw.data(), in); });
+                // one dot per sample and output node like fully_connected_layer::push_forward
+                const f64 per_sample = gflops([&] {
+                    for (u32 i = 0; i < BATCH; i++)
+                        for (u32 j = 0; j < out; j++)
+                            y[i * out + j] += pinguml::dot(w.data() + j * in, x.data() + i * in, in);
+                });
+                std::cout << "pinguml fully_connected " << in << "x" << out << " batch " << BATCH << ": forward "
+                          << forward << ", propogate " << propogate << ", gradient " << gradient << " GFLOP/s (per sample "
+                          << per_sample << " GFLOP/s)" << std::endl;
+            }
+
+            // the batched network path has to match the per sample one
+            pinguml::network net{"sgd"};
+            net.push_back("in", "input 42 1 1");
+            net.push_back("hidden", "fully_connected 20 tanh");
+            net.push_back("out", "fully_connected 7 tanh");
+            net.connect();
+            for (auto connection: net.m_connections)
+                if (connection) connection->fill_random_uniform(-0.3f, 0.3f);
+            net.start_epoch("mse");
+            // forward copies the padded size of the input layer
+            const std::vector<f32> input = random_vector(8 * 42 + 8), target = random_vector(8 * 7);
+            const f32 *batch_output = net.forward_batch(input.data(), 8);
+            f32 error = 0;
+            for (u32 i = 0; i < 8; i++) {
+                const f32 *output = net.forward(input.data() + i * 42);
+                for (u32 j = 0; j < 7; j++)
+                    error = std::max(error, std::abs(output[j] - batch_output[i * 7 + j]));
+            }
+            auto loss = [&] {
+                const f32 *output = net.forward_batch(input.data(), 8);
+                f32 sum = 0;
+                for (u32 i = 0; i < 8 * 7; i++) sum += (output[i] - target[i]) * (output[i] - target[i]);
+                return sum;
+            };
+            const f32 loss_before = loss();
+            for (u32 i = 0; i < 100; i++)
+                net.train_batch(input.data(), target.data(), 8);
+            const f32 loss_after = loss();
+            if (error > 1e-5f || !(loss_after < loss_before)) {
+                std::cout << "pinguml batched path is broken: " << error << ", " << loss_before << " -> " << loss_after
+                          << std::endl;
+                return 0;
+            }
+            std::cout << "pinguml train_batch: loss " << loss_before << " -> " << loss_after << std::endl;
+        }
+
+        {
+            // pinguml compiled forward pass of a dag whose layers aren't pushed back in topological order
+            std::mt19937 gen{5};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            pinguml::network net{"sgd"};
+            net.push_back("a", "input 5 1 1");
+            net.push_back("b", "input 3 1 1");
+            net.push_back("join", "fully_connected 4 tanh");
+            net.push_back("mid", "fully_connected 6 sigmoid");
+            net.push_back("out", "fully_connected 3 identity");
+            net.connect("a", "mid");
+            net.connect("mid", "join");
+            net.connect("b", "join");
+            net.connect("a", "join");
+            net.connect("join", "out");
+            for (auto connection: net.m_connections)
+                for (u32 i = 0; i < connection->size(); i++) connection->m_ptr[i] = dist(gen);
+            for (auto layer: net.m_network_copies[pinguml::MAIN_COPY])
+                if (layer->uses_biases())
+                    for (u32 i = 0; i < layer->m_nodes.m_rows; i++) layer->m_biases.m_ptr[i] = dist(gen);
+            net.start_epoch("mse");
+
+            auto product = [&](u32 connection, const std::vector<f32> &x, std::vector<f32> &y) {
+                const pinguml::tensor &w = *net.m_connections[connection];
+                for (u32 i = 0; i < w.m_rows; i++)
+                    y[i] += pinguml::dot(w.m_ptr + i * w.m_cols, x.data(), w.m_cols);
+            };
+            auto bias = [&](const std::string &name, u32 i) {
+                return net.m_network_copies[pinguml::MAIN_COPY][net.layer_index(name)]->m_biases.m_ptr[i];
+            };
+            f32 error = 0;
+            for (u32 sample = 0; sample < 2; sample++) {
+                // the input layers are padded to 8 values
+                std::vector<f32> input(16, 0.f), a(5), b(3), mid(6, 0.f), join(4, 0.f), out(3, 0.f);
+                for (u32 i = 0; i < 5; i++) input[i] = a[i] = dist(gen);
+                for (u32 i = 0; i < 3; i++) input[8 + i] = b[i] = dist(gen);
+                product(0, a, mid);
+                for (u32 i = 0; i < 6; i++) mid[i] = 1.f / (1.f + std::exp(-mid[i] - bias("mid", i)));
+                product(1, mid, join);
+                product(2, b, join);
+                product(3, a, join);
+                for (u32 i = 0; i < 4; i++) join[i] = std::tanh(join[i] + bias("join", i));
+                product(4, join, out);
+                const f32 *output = net.forward(input.data());
+                for (u32 i = 0; i < 3; i++)
+                    error = std::max(error, std::abs(output[i] - out[i] - bias("out", i)));
+            }
+            if (error > 1e-5f) {
+                std::cout << "pinguml compiled forward pass is broken: " << error << std::endl;
+                return 0;
+            }
+
+            pinguml::network mlp{"sgd"};
+            mlp.push_back("in", "input 128 1 1");
+            mlp.push_back("hidden", "fully_connected 64 tanh");
+            mlp.push_back("out", "fully_connected 8 tanh");
+            mlp.connect();
+            std::vector<f32> input(128);
+            for (auto &x: input) x = dist(gen);
+            constexpr u32 NUM_FORWARDS = 100'000;
+            f32 sum = 0;
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (u32 i = 0; i < NUM_FORWARDS; i++)
+                sum += mlp.forward(input.data())[0];
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            std::cout << "pinguml forward 128-64-8: " << std::chrono::duration<f64, std::nano>(t2 - t1).count() / NUM_FORWARDS
+                      << "ns (" << sum << ")" << std::endl;
+        }
+
+        {
+            // pinguml round trip through the binary format, copied and mapped, against the text format
+            std::mt19937 gen{3};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            auto net = std::make_unique<pinguml::network>("sgd");
+            net->push_back("in", "input 256 1 1");
+            net->push_back("hidden1", "fully_connected 512 tanh");
+            net->push_back("hidden2", "fully_connected 512 tanh");
+            net->push_back("out", "fully_connected 10 identity");
+            net->connect();
+            for (auto tensor: net->stored_tensors())
+                for (u32 i = 0; i < tensor->size(); i++) tensor->m_ptr[i] = dist(gen) * 0.1f;
+            net->start_epoch("mse");
+            std::vector<f32> input(256);
+            for (auto &x: input) x = dist(gen);
+            const f32 *output = net->forward(input.data());
+            const std::vector<f32> expected(output, output + 10);
+
+            std::string text_path = "/tmp/pinguml_test.txt";
+            const std::string binary_path = "/tmp/pinguml_test.bin";
+            net->write(text_path);
+            net->write_binary(binary_path);
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            auto from_text = std::make_unique<pinguml::network>("sgd");
+            from_text->read(text_path);
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            auto copied = std::make_unique<pinguml::network>("sgd");
+            copied->read(binary_path);
+            auto const t3 = std::chrono::high_resolution_clock::now();
+            auto mapped = std::make_unique<pinguml::network>("sgd");
+            mapped->read_binary(binary_path, true);
+            auto const t4 = std::chrono::high_resolution_clock::now();
+
+            f32 error = 0;
+            for (auto loaded: {copied.get(), mapped.get()}) {
+                output = loaded->forward(input.data());
+                for (u32 i = 0; i < 10; i++) error = std::max(error, std::abs(output[i] - expected[i]));
+            }
+            // the mapped weights of a network that only infers don't get back buffers on the heap
+            const bool back_buffers = std::ranges::any_of(mapped->m_back_connections, [](auto c) { return c != nullptr; });
+            std::fstream corrupt(binary_path, std::ios::in | std::ios::out | std::ios::binary);
+            corrupt.seekp(-1, std::ios::end);
+            corrupt.put('x');
+            corrupt.close();
+            bool detected = false;
+            try {
+                pinguml::network{"sgd"}.read_binary(binary_path);
+            } catch (std::runtime_error const &) {
+                detected = true;
+            }
+            if (error != 0 || !detected || back_buffers) {
+                std::cout << "pinguml binary format is broken: " << error << ", " << detected << ", " << back_buffers
+                          << std::endl;
+                return 0;
+            }
+            std::cout << "pinguml serialization of " << std::filesystem::file_size(binary_path) << " bytes: text "
+                      << std::chrono::duration<f64, std::milli>(t2 - t1).count() << "ms, binary "
+                      << std::chrono::duration<f64, std::milli>(t3 - t2).count() << "ms, mapped "
+                      << std::chrono::duration<f64, std::milli>(t4 - t3).count() << "ms" << std::endl;
+            std::filesystem::remove(text_path);
+            std::filesystem::remove(binary_path);
+        }
+
+        {
+            // pinguml convolution on a 6 x 7 board against a direct convolution and finite differences
+            std::mt19937 gen{7};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            pinguml::network net{"sgd"};
+            net.push_back("in", "input 6 7 2");
+            net.push_back("conv1", "convolution 3 8 1 tanh");
+            net.push_back("conv2", "convolution 3 5 0 tanh");
+            net.push_back("out", "fully_connected 3 tanh");
+            net.connect();
+            for (auto tensor: net.stored_tensors())
+                for (u32 i = 0; i < tensor->size(); i++) tensor->m_ptr[i] = dist(gen) * 0.3f;
+            net.set_batch_size(1);
+            net.start_epoch("mse");
+
+            // the two channels of the input are padded to 48 values
+            std::vector<f32> input(96, 0.f), dense_input(84), target(8, 0.f);
+            for (u32 c = 0; c < 2; c++)
+                for (u32 i = 0; i < 42; i++) input[c * 48 + i] = dense_input[c * 42 + i] = dist(gen);
+            for (u32 i = 0; i < 3; i++) target[i] = dist(gen) * 0.5f;
+
+            auto convolution = [&](const std::vector<f32> &in, u32 channels, u32 h, u32 w, u32 connection, u32 layer, u32 pad) {
+                const pinguml::tensor &weights = *net.m_connections[connection];
+                const pinguml::tensor &biases = net.m_network_copies[pinguml::MAIN_COPY][layer]->m_biases;
+                const u32 out_h = h + 2 * pad - 2, out_w = w + 2 * pad - 2;
+                std::vector<f32> out(weights.m_rows * out_h * out_w);
+                for (u32 f = 0; f < weights.m_rows; f++)
+                    for (u32 y = 0; y < out_h; y++)
+                        for (u32 x = 0; x < out_w; x++) {
+                            f32 sum = biases.m_ptr[f];
+                            for (u32 c = 0; c < channels; c++)
+                                for (u32 ky = 0; ky < 3; ky++)
+                                    for (u32 kx = 0; kx < 3; kx++) {
+                                        const i32 iy = (i32)(y + ky - pad), ix = (i32)(x + kx - pad);
+                                        if (iy >= 0 && iy < (i32)h && ix >= 0 && ix < (i32)w)
+                                            sum += weights.m_ptr[f * weights.m_cols + (c * 3 + ky) * 3 + kx] * in[(c * h + iy) * w + ix];
+                                    }
+                            out[(f * out_h + y) * out_w + x] = std::tanh(sum);
+                        }
+                return out;
+            };
+            const std::vector<f32> conv1 = convolution(dense_input, 2, 6, 7, 0, 1, 1), conv2 = convolution(conv1, 8, 6, 7, 1, 2, 0);
+            f32 error = 0;
+            const f32 *output = net.forward(input.data());
+            for (u32 i = 0; i < 3; i++) {
+                f32 sum = net.m_network_copies[pinguml::MAIN_COPY][3]->m_biases.m_ptr[i];
+                for (u32 j = 0; j < 5 * 4 * 5; j++) sum += net.m_connections[2]->m_ptr[i * 100 + j] * conv2[j];
+                error = std::max(error, std::abs(output[i] - std::tanh(sum)));
+            }
+            // the padding of the channels has to stay 0
+            for (u32 layer: {1u, 2u}) {
+                const pinguml::tensor &nodes = net.m_network_copies[pinguml::MAIN_COPY][layer]->m_nodes;
+                for (u32 c = 0; c < nodes.m_channels; c++)
+                    for (u32 i = nodes.m_rows * nodes.m_cols; i < nodes.m_channel_stride; i++)
+                        error = std::max(error, std::abs(nodes.m_ptr[c * nodes.m_channel_stride + i]));
+            }
+            const f32 *batch_output = net.forward_batch(dense_input.data(), 1);
+            for (u32 i = 0; i < 3; i++) error = std::max(error, std::abs(output[i] - batch_output[i]));
+
+            auto loss = [&] {
+                const f32 *out = net.forward(input.data());
+                f32 sum = 0;
+                for (u32 i = 0; i < 3; i++) sum += 0.5f * (out[i] - target[i]) * (out[i] - target[i]);
+                return sum;
+            };
+            std::vector<std::pair<pinguml::tensor *, u32>> probes;
+            for (u32 i = 0; i < 3; i++)
+                for (u32 j = 0; j < 4; j++)
+                    probes.push_back({net.m_connections[i], (u32)(gen() % (net.m_connections[i]->m_rows * net.m_connections[i]->m_cols))});
+            std::vector<f32> numeric;
+            for (auto [tensor, index]: probes) {
+                const f32 w = tensor->m_ptr[index];
+                tensor->m_ptr[index] = w + 1e-2f;
+                net.weights_changed();
+                const f32 plus = loss();
+                tensor->m_ptr[index] = w - 1e-2f;
+                net.weights_changed();
+                const f32 minus = loss();
+                tensor->m_ptr[index] = w;
+                net.weights_changed();
+                numeric.push_back((plus - minus) / 2e-2f);
+            }
+            // the gradients of both paths at the same weights
+            std::vector<pinguml::tensor> saved;
+            for (auto tensor: net.stored_tensors()) saved.push_back(*tensor);
+            net.train_batch(dense_input.data(), target.data(), 1);
+            const std::vector<pinguml::tensor> batch_gradients = net.m_batch_delta_weights;
+            for (u32 i = 0; i < (u32)saved.size(); i++) *net.stored_tensors()[i] = saved[i];
+            net.start_epoch("mse");
+            net.train_target(input.data(), target.data());
+            f32 gradient_error = 0;
+            for (u32 i = 0; i < (u32)probes.size(); i++) {
+                const u32 connection = i / 4;
+                for (auto &gradients: {net.m_delta_weights_copies[0][connection], batch_gradients[connection]}) {
+                    const f32 analytic = gradients.m_ptr[probes[i].second];
+                    gradient_error = std::max(gradient_error, std::abs(analytic - numeric[i]) / std::max(1e-2f, std::abs(numeric[i])));
+                }
+            }
+            if (error > 1e-5f || gradient_error > 2e-2f) {
+                std::cout << "pinguml convolution is broken: " << error << ", " << gradient_error << std::endl;
+                return 0;
+            }
+
+            pinguml::network board{"sgd"};
+            board.push_back("in", "input 6 7 2");
+            board.push_back("conv1", "convolution 3 64 1 relu");
+            board.push_back("conv2", "convolution 3 64 1 relu");
+            board.push_back("out", "fully_connected 1 tanh");
+            board.connect();
+            for (auto connection: board.m_connections) connection->fill_random_uniform(-0.05f, 0.05f);
+            constexpr u32 NUM_FORWARDS = 2'000;
+            f32 sum = 0;
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (u32 i = 0; i < NUM_FORWARDS; i++) {
+                input[i % 84] = -input[i % 84];
+                sum += board.forward(input.data())[0];
+            }
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            const f64 flops = 2.0 * 42 * 64 * 9 * (2 + 64);
+            std::cout << "pinguml convolution 6x7x2-64-64: " << std::chrono::duration<f64, std::micro>(t2 - t1).count() / NUM_FORWARDS
+                      << "us per forward, " << flops * NUM_FORWARDS / std::chrono::duration<f64, std::nano>(t2 - t1).count()
+                      << " GFLOP/s (" << sum << ")" << std::endl;
+        }
+
+        // the pinguml training tests learn a fixed random teacher, so that the targets can be learned:
+        // target = 0.8 tanh(teacher * input) for a num_targets x num_inputs teacher
+        auto random_teacher = [](std::mt19937 &gen, const u32 num_inputs, const u32 num_targets, const f32 scale) {
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            std::vector<f32> teacher(num_targets * num_inputs);
+            for (auto &x: teacher) x = dist(gen) * scale;
+            return [=](const f32 *input, f32 *target) {
+                for (u32 j = 0; j < num_targets; j++)
+                    target[j] = 0.8f * std::tanh(pinguml::dot(teacher.data() + j * num_inputs, input, num_inputs));
+            };
+        };
+        // num_samples random inputs of 40 values and the 8 targets of a teacher for them
+        auto teacher_samples = [&](std::mt19937 &gen, const u32 num_samples) {
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            std::vector<f32> inputs(num_samples * 40), targets(num_samples * 8);
+            for (auto &x: inputs) x = dist(gen);
+            const auto teacher = random_teacher(gen, 40, 8, 0.5f);
+            for (u32 i = 0; i < num_samples; i++) teacher(inputs.data() + i * 40, targets.data() + i * 8);
+            return std::pair{inputs, targets};
+        };
+        // a 40-16-8 net for them, with the same weights every time
+        auto make_teacher_net = [](const std::string &solver, const u32 batch_size) {
+            auto net = std::make_unique<pinguml::network>(solver);
+            net->push_back("in", "input 40 1 1");
+            net->push_back("hidden", "fully_connected 16 tanh");
+            net->push_back("out", "fully_connected 8 tanh");
+            net->connect();
+            for (auto connection: net->m_connections)
+                if (connection) connection->fill_random_uniform(-0.3f, 0.3f);
+            net->set_batch_size(batch_size);
+            net->start_epoch("mse");
+            return net;
+        };
+
+        {
+            // pinguml minibatch slots: minibatches through train_target have to match train_batch, also a partly filled
+            // one at the end of the epoch
+            std::mt19937 gen{11};
+            auto make_net = [&] { return make_teacher_net("sgd", 16); };
+            constexpr u32 NUM_SAMPLES = 16 * 64;
+            auto [inputs, targets] = teacher_samples(gen, NUM_SAMPLES);
+            for (u32 count: {16u, 1u, 2u, 3u, 5u, 11u, 15u, 21u, 38u}) {
+                auto slots = make_net(), batched = make_net();
+                for (u32 i = 0; i < count; i++)
+                    slots->train_target(inputs.data() + i * 40, targets.data() + i * 8);
+                for (u32 i = 0; i < count; i += 16)
+                    batched->train_batch(inputs.data() + i * 40, targets.data() + i * 8, std::min(count - i, 16u));
+                slots->end_epoch();
+                f32 error = 0;
+                for (u32 i = 0; i < (u32)slots->m_connections.size(); i++)
+                    if (slots->m_connections[i])
+                        for (u32 j = 0; j < slots->m_connections[i]->size(); j++)
+                            error = std::max(error, std::abs(slots->m_connections[i]->m_ptr[j] - batched->m_connections[i]->m_ptr[j]));
+                if (error > 1e-5f) {
+                    std::cout << "pinguml minibatch slots are broken: " << error << " after " << count << " samples"
+                              << std::endl;
+                    return 0;
+                }
+            }
+            {
+                // a sample on a copy that doesn't exist may not take a slot, the minibatch would wait for it forever
+                auto checked = make_net();
+                bool thrown = false;
+                try {
+                    checked->train_target(inputs.data(), targets.data(), 1, 1);
+                } catch (const std::runtime_error &) {
+                    thrown = true;
+                }
+                for (u32 i = 0; i < 32; i++)
+                    checked->train_target(inputs.data() + i * 40, targets.data() + i * 8);
+                checked->end_epoch();
+                if (!thrown) {
+                    std::cout << "pinguml minibatch slots are broken: invalid copy accepted" << std::endl;
+                    return 0;
+                }
+            }
+
+            auto loss = [&](pinguml::network &net) {
+                f32 sum = 0;
+                for (u32 i = 0; i < NUM_SAMPLES; i++) {
+                    const f32 *output = net.forward(inputs.data() + i * 40);
+                    for (u32 j = 0; j < 8; j++) sum += (output[j] - targets[i * 8 + j]) * (output[j] - targets[i * 8 + j]);
+                }
+                return sum / NUM_SAMPLES;
+            };
+            auto net = make_net();
+#if defined(OMP)
+            net->enable_threads();
+#endif
+            const f32 loss_before = loss(*net);
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            constexpr u32 NUM_EPOCHS = 8;
+            for (u32 epoch = 0; epoch < NUM_EPOCHS; epoch++) {
+                net->start_epoch("mse");
+#if defined(OMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+                for (u32 i = 0; i < NUM_SAMPLES; i++)
+                    net->train_target(inputs.data() + i * 40, targets.data() + i * 8);
+                net->end_epoch();
+            }
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            const f32 loss_after = loss(*net);
+            if (!(loss_after < loss_before)) {
+                std::cout << "pinguml training is broken: " << loss_before << " -> " << loss_after << std::endl;
+                return 0;
+            }
+            std::cout << "pinguml train_target: loss " << loss_before << " -> " << loss_after << ", "
+                      << NUM_SAMPLES * NUM_EPOCHS / std::chrono::duration<f64>(t2 - t1).count() << " samples/s with "
+                      << net->nr_thread() << " threads" << std::endl;
+
+            // trainers on their own std::threads and network copies, the gradients of the double buffered minibatches
+            // are stale by up to one minibatch but at a small rate they have to train about as well as one thread
+            auto train_threads = [&](const u32 nr_threads) {
+                auto threaded = make_net();
+                threaded->enable_threads(nr_threads);
+                threaded->set_learning_rate(0.01f);
+                for (u32 epoch = 0; epoch < NUM_EPOCHS; epoch++) {
+                    threaded->start_epoch("mse");
+                    std::vector<std::thread> threads;
+                    for (u32 t = 0; t < nr_threads; t++)
+                        threads.emplace_back([&, t] {
+                            for (u32 i = t; i < NUM_SAMPLES; i += nr_threads)
+                                threaded->train_target(inputs.data() + i * 40, targets.data() + i * 8, 1, (i32)t);
+                        });
+                    for (auto &thread: threads) thread.join();
+                    threaded->end_epoch();
+                }
+                return loss(*threaded);
+            };
+            const f32 loss_one = train_threads(1), loss_four = train_threads(4);
+            if (!(loss_four < loss_before) || std::abs(loss_four - loss_one) > 0.05f * loss_one) {
+                std::cout << "pinguml threaded training is broken: " << loss_before << " -> " << loss_one
+                          << " on 1 thread, " << loss_four << " on 4" << std::endl;
+                return 0;
+            }
+            std::cout << "pinguml train_target at rate 0.01: loss " << loss_before << " -> " << loss_one
+                      << " on 1 thread, " << loss_four << " on 4" << std::endl;
+        }
+
+        {
+            // pinguml solvers: adam against a scalar version, every solver has to train the teacher of the test above,
+            // then the time of an update per weight
+            std::mt19937 gen{13};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            pinguml::adam adam{0.01f};
+            adam.push_back(20, 13, 1);
+            pinguml::tensor weights(20, 13, 1), gradient(20, 13, 1);
+            weights.fill(0.5f);
+            std::vector<f32> w(weights.size(), 0.5f), m(w.size(), 0.f), v(w.size(), 0.f);
+            f32 error = 0;
+            for (u32 t = 1; t <= 3; t++) {
+                for (u32 i = 0; i < gradient.size(); i++) gradient.m_ptr[i] = dist(gen);
+                adam.update_weights(&weights, 0, gradient);
+                const f32 rate = adam.m_learning_rate;
+                for (u32 i = 0; i < w.size(); i++) {
+                    m[i] = 0.9f * m[i] + 0.1f * gradient.m_ptr[i];
+                    v[i] = 0.999f * v[i] + 0.001f * gradient.m_ptr[i] * gradient.m_ptr[i];
+                    const f32 m_hat = m[i] / (1.f - std::pow(0.9f, (f32)t)), v_hat = v[i] / (1.f - std::pow(0.999f, (f32)t));
+                    w[i] -= rate * (m_hat / (std::sqrt(v_hat) + 1e-8f) + 0.01f * w[i]);
+                    error = std::max(error, std::abs(w[i] - weights.m_ptr[i]));
+                }
+            }
+            if (error > 1e-6f) {
+                std::cout << "pinguml adam is broken: " << error << std::endl;
+                return 0;
+            }
+            // the weight decay leaves the tensors pushed back without it alone, the network does that for the biases
+            for (const std::string name: {"sgd", "momentum", "adamw"}) {
+                std::unique_ptr<pinguml::solver_base> solver{pinguml::create_solver(name)};
+                solver->push_back(1, 8, 1);
+                solver->push_back(1, 8, 1, false);
+                pinguml::tensor decayed(1, 8, 1), kept(1, 8, 1), no_gradient(1, 8, 1);
+                decayed.fill(1.f);
+                kept.fill(1.f);
+                no_gradient.fill(0.f);
+                solver->update_weights(&decayed, 0, no_gradient);
+                solver->update_weights(&kept, 1, no_gradient);
+                if (!(decayed.m_ptr[7] < 1.f) || kept.m_ptr[7] != 1.f) {
+                    std::cout << "pinguml " << name << " weight decay is broken: " << decayed.m_ptr[7] << ", "
+                              << kept.m_ptr[7] << std::endl;
+                    return 0;
+                }
+            }
+
+            constexpr u32 NUM_SAMPLES = 256;
+            auto [inputs, targets] = teacher_samples(gen, NUM_SAMPLES);
+            for (const std::string name: {"sgd", "momentum", "adagrad", "adam", "adamw"}) {
+                auto make_net = [&] { return make_teacher_net(name, 1); };
+
+                // the biases are updated by the solver too: the first step of adagrad and adam moves every bias by
+                // the learning rate, through train_batch and through the minibatch slots of train_target
+                if (name == "adagrad" || name == "adam" || name == "adamw") {
+                    auto batched = make_net(), slots = make_net();
+                    batched->train_batch(inputs.data(), targets.data(), 1);
+                    slots->train_target(inputs.data(), targets.data());
+                    slots->sync_mini_batch();
+                    f32 bias_error = 0;
+                    for (auto *trained: {batched.get(), slots.get()})
+                        for (auto *layer: trained->m_network_copies[0])
+                            for (u32 i = 0; layer->uses_biases() && i < layer->m_biases.size(); i++)
+                                bias_error = std::max(bias_error, std::abs(std::abs(layer->m_biases.m_ptr[i]) - trained->learning_rate()));
+                    if (bias_error > 1e-2f * batched->learning_rate()) {
+                        std::cout << "pinguml " << name << " bias update is broken: " << bias_error << std::endl;
+                        return 0;
+                    }
+                }
+
+                auto net_ptr = make_net();
+                pinguml::network &net = *net_ptr;
+                auto loss = [&] {
+                    const f32 *output = net.forward_batch(inputs.data(), NUM_SAMPLES);
+                    f32 sum = 0;
+                    for (u32 i = 0; i < NUM_SAMPLES * 8; i++) sum += (output[i] - targets[i]) * (output[i] - targets[i]);
+                    return sum / NUM_SAMPLES;
+                };
+                const f32 loss_before = loss();
+                for (u32 epoch = 0; epoch < 50; epoch++)
+                    for (u32 i = 0; i < NUM_SAMPLES; i += 16)
+                        net.train_batch(inputs.data() + i * 40, targets.data() + i * 8, 16);
+                const f32 loss_after = loss();
+
+                std::unique_ptr<pinguml::solver_base> solver{pinguml::create_solver(name)};
+                solver->push_back(512, 512, 1);
+                pinguml::tensor big(512, 512, 1), big_gradient(512, 512, 1);
+                big.fill(0.1f);
+                big_gradient.fill_random_uniform(-1.f, 1.f);
+                constexpr u32 NUM_UPDATES = 200;
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (u32 i = 0; i < NUM_UPDATES; i++) solver->update_weights(&big, 0, big_gradient);
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                if (!(loss_after < loss_before)) {
+                    std::cout << "pinguml " << name << " is broken: " << loss_before << " -> " << loss_after << std::endl;
+                    return 0;
+                }
+                std::cout << "pinguml " << name << ": loss " << loss_before << " -> " << loss_after << ", "
+                          << std::chrono::duration<f64, std::nano>(t2 - t1).count() / NUM_UPDATES / big.size()
+                          << "ns per weight (" << big.m_ptr[0] << ")" << std::endl;
+            }
+        }
+
+        {
+            // pinguml tensor expressions against scalar loops, then training must not allocate once the pools are warm
+            std::mt19937 gen{17};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            pinguml::tensor a, b(33, 17, 3), c(33, 17, 3), d(33, 17, 3);
+            for (pinguml::tensor *tns: {&b, &c, &d})
+                for (u32 i = 0; i < tns->size(); i++) tns->m_ptr[i] = dist(gen);
+            a = b * c + d;
+            pinguml::tensor e = (b - 1.f) * 2.f - c * d;
+            e += a * 0.5f;
+            f32 error = a.m_rows == 33 && a.m_cols == 17 && a.m_channels == 3 ? 0.f : 1.f;
+            for (u32 i = 0; i < b.size(); i++) {
+                error = std::max(error, std::abs(a.m_ptr[i] - (b.m_ptr[i] * c.m_ptr[i] + d.m_ptr[i])));
+                const f32 ref = (b.m_ptr[i] - 1.f) * 2.f - c.m_ptr[i] * d.m_ptr[i] + a.m_ptr[i] * 0.5f;
+                error = std::max(error, std::abs(e.m_ptr[i] - ref));
+            }
+
+            pinguml::network net{"adam"};
+            net.push_back("in", "input 40 1 1");
+            net.push_back("hidden", "fully_connected 16 tanh");
+            net.push_back("out", "fully_connected 8 tanh");
+            net.connect();
+            std::vector<f32> inputs(64 * 40), targets(64 * 8);
+            for (auto &x: inputs) x = dist(gen);
+            for (auto &x: targets) x = dist(gen) * 0.5f;
+            auto epoch = [&] {
+                net.start_epoch("mse");
+                for (u32 i = 0; i < 64; i++) net.train_target(inputs.data() + i * 40, targets.data() + i * 8);
+                for (u32 i = 0; i < 64; i += 16) net.train_batch(inputs.data() + i * 40, targets.data() + i * 8, 16);
+                net.end_epoch();
+            };
+            epoch();
+            const u64 allocations = pinguml::tensor_pool::local().m_heap_allocations;
+            for (u32 i = 0; i < 3; i++) epoch();
+            const u64 steady_allocations = pinguml::tensor_pool::local().m_heap_allocations - allocations;
+            if (error > 1e-6f || steady_allocations) {
+                std::cout << "pinguml tensor expressions are broken: " << error << ", " << steady_allocations
+                          << " allocations" << std::endl;
+                return 0;
+            }
+
+            constexpr u32 NUM_EVALS = 2000;
+            pinguml::tensor big_b(256, 256, 1), big_c(256, 256, 1), big_d(256, 256, 1), big_a;
+            big_b.fill(0.5f);
+            big_c.fill(2.f);
+            big_d.fill(1.f);
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (u32 i = 0; i < NUM_EVALS; i++) big_a = big_b * big_c + big_d;
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            std::cout << "pinguml a = b * c + d over 64Ki values: "
+                      << std::chrono::duration<f64, std::micro>(t2 - t1).count() / NUM_EVALS << "us ("
+                      << big_a.m_ptr[0] << ")" << std::endl;
+        }
+
+        {
+            // pinguml dataset: every sample once per epoch in a shuffled order, then training from the stream
+            std::mt19937 gen{19};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            constexpr u32 INPUTS = 2 * 6 * 7, TARGETS = 7;
+            const auto teacher = random_teacher(gen, INPUTS, TARGETS, 0.3f);
+            const std::vector<std::string> shards{"/tmp/pinguml_shard0.bin", "/tmp/pinguml_shard1.bin",
+                                                  "/tmp/pinguml_shard2.bin"};
+            const std::array<u32, 3> shard_sizes{3000, 0, 1097};
+            // samples by their first two inputs
+            std::map<std::pair<f32, f32>, u32> ids;
+            std::vector<f32> input(INPUTS), target(TARGETS);
+            for (u32 i = 0; i < shards.size(); i++) {
+                pinguml::dataset_writer writer{shards[i], INPUTS, TARGETS};
+                for (u32 j = 0; j < shard_sizes[i]; j++) {
+                    for (auto &x: input) x = dist(gen);
+                    teacher(input.data(), target.data());
+                    ids[{input[0], input[1]}] = (u32)ids.size();
+                    writer.write(input.data(), target.data());
+                }
+            }
+
+            constexpr u32 BATCH = 32;
+            pinguml::dataset data{shards, BATCH, 512, 7};
+            bool broken = data.size() != ids.size() || data.input_size() != INPUTS || data.target_size() != TARGETS;
+            u32 in_order = 0;
+            for (u32 epoch = 0; epoch < 2; epoch++) {
+                std::vector<u32> seen(ids.size(), 0);
+                u32 previous = 0;
+                while (auto batch = data.next()) {
+                    broken |= batch->m_size == 0 || batch->m_size > BATCH;
+                    for (u32 i = 0; i < batch->m_size; i++) {
+                        const f32 *sample = batch->m_inputs.m_ptr + i * INPUTS;
+                        auto id = ids.find({sample[0], sample[1]});
+                        if (id == ids.end()) {
+                            broken = true;
+                            continue;
+                        }
+                        seen[id->second]++;
+                        in_order += id->second == previous + 1;
+                        previous = id->second;
+                        teacher(sample, target.data());
+                        broken |= !std::equal(target.begin(), target.end(), batch->m_targets.m_ptr + i * TARGETS);
+                    }
+                }
+                broken |= std::any_of(seen.begin(), seen.end(), [](u32 count) { return count != 1; });
+            }
+            if (broken || in_order > ids.size() / 4) {
+                std::cout << "pinguml dataset is broken: " << in_order << " samples in order" << std::endl;
+                return 0;
+            }
+
+            pinguml::network net{"adam"};
+            net.push_back("in", "input 84 1 1");
+            net.push_back("hidden", "fully_connected 32 tanh");
+            net.push_back("out", "fully_connected 7 tanh");
+            net.connect();
+            for (auto connection: net.m_connections) connection->fill_random_uniform(-0.2f, 0.2f);
+            auto loss = [&] {
+                f32 sum = 0;
+                u32 count = 0;
+                while (auto batch = data.next()) {
+                    const f32 *output = net.forward_batch(batch->m_inputs.m_ptr, batch->m_size);
+                    for (u32 i = 0; i < batch->m_size * TARGETS; i++)
+                        sum += (output[i] - batch->m_targets.m_ptr[i]) * (output[i] - batch->m_targets.m_ptr[i]);
+                    count += batch->m_size;
+                }
+                return sum / count;
+            };
+            const f32 loss_before = loss();
+            constexpr u32 NUM_EPOCHS = 10;
+            auto const t1 = std::chrono::high_resolution_clock::now();
+            for (u32 epoch = 0; epoch < NUM_EPOCHS; epoch++) {
+                net.start_epoch("mse");
+                while (auto batch = data.next()) net.train_batch(*batch);
+                net.end_epoch();
+            }
+            auto const t2 = std::chrono::high_resolution_clock::now();
+            const f32 loss_after = loss();
+            for (auto &shard: shards) std::filesystem::remove(shard);
+            if (!(loss_after < loss_before)) {
+                std::cout << "pinguml training from a dataset is broken: " << loss_before << " -> " << loss_after
+                          << std::endl;
+                return 0;
+            }
+            std::cout << "pinguml dataset: loss " << loss_before << " -> " << loss_after << ", "
+                      << data.size() * NUM_EPOCHS / std::chrono::duration<f64>(t2 - t1).count() << " samples/s"
+                      << std::endl;
+        }
+
+        {
+            // pinguml branches: a policy / value net on branch threads has to match it run sequentially exactly
+            auto make_net = [] {
+                auto net = std::make_unique<pinguml::network>("adam");
+                net->push_back("in", "input 84 1 1");
+                net->push_back("trunk", "fully_connected 128 tanh");
+                net->push_back("value_hidden", "fully_connected 128 tanh");
+                net->push_back("value", "fully_connected 1 tanh");
+                net->push_back("policy_hidden", "fully_connected 128 tanh");
+                net->push_back("policy", "fully_connected 7 tanh");
+                net->connect("in", "trunk");
+                net->connect("trunk", "value_hidden");
+                net->connect("value_hidden", "value");
+                net->connect("trunk", "policy_hidden");
+                net->connect("policy_hidden", "policy");
+                std::mt19937 gen{23};
+                std::uniform_real_distribution<f32> dist{-0.2f, 0.2f};
+                for (auto connection: net->m_connections)
+                    for (u32 i = 0; i < connection->size(); i++) connection->m_ptr[i] = dist(gen);
+                net->start_epoch("mse");
+                return net;
+            };
+            auto sequential = make_net(), branched = make_net();
+            branched->enable_branch_threads(3);
+
+            constexpr u32 BATCH = 64;
+            std::mt19937 gen{29};
+            std::uniform_real_distribution<f32> dist{-1.f, 1.f};
+            std::vector<f32> inputs(BATCH * 88, 0.f), targets(BATCH * 7);
+            for (auto &x: inputs) x = dist(gen);
+            for (auto &x: targets) x = dist(gen) * 0.5f;
+            bool broken = branched->m_plans[pinguml::MAIN_COPY].m_branches.size() != 3;
+            for (u32 step = 0; step < 4; step++) {
+                for (auto net: {sequential.get(), branched.get()}) {
+                    net->train_batch(inputs.data(), targets.data(), BATCH);
+                    for (u32 i = 0; i < 8; i++) net->train_target(inputs.data() + i * 88, targets.data() + i * 7);
+                }
+                const f32 *a = sequential->forward(inputs.data()), *b = branched->forward(inputs.data());
+                broken |= !std::equal(a, a + 7, b);
+                const u32 value = sequential->layer_index("value");
+                broken |= sequential->m_network_copies[0][value]->m_nodes.m_ptr[0] !=
+                          branched->m_network_copies[0][value]->m_nodes.m_ptr[0];
+            }
+            for (u32 i = 0; i < sequential->m_connections.size(); i++) {
+                const pinguml::tensor &a = *sequential->m_connections[i], &b = *branched->m_connections[i];
+                broken |= !std::equal(a.m_ptr, a.m_ptr + a.size(), b.m_ptr);
+            }
+            if (broken) {
+                std::cout << "pinguml branch threads are broken" << std::endl;
+                return 0;
+            }
+
+            constexpr u32 NUM_BATCHES = 200;
+            std::array<f64, 2> times{};
+            for (u32 i = 0; i < 2; i++) {
+                pinguml::network &net = i ? *branched : *sequential;
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (u32 j = 0; j < NUM_BATCHES; j++) net.train_batch(inputs.data(), targets.data(), BATCH);
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                times[i] = std::chrono::duration<f64, std::micro>(t2 - t1).count() / NUM_BATCHES;
+            }
+            std::cout << "pinguml policy / value train_batch of " << BATCH << ": " << times[0] << "us sequential, "
+                      << times[1] << "us on " << std::thread::hardware_concurrency() << " cores" << std::endl;
+        }
+
+        {
+            // pinguml sparse inputs: boards of -1, 0 and 1 have to give what the dense kernel gives, also after updates
+            pinguml::network net("adam");
+            net.push_back("in", "input 6 7 2");
+            net.push_back("hidden", "fully_connected 128 tanh sparse");
+            net.push_back("out", "fully_connected 7 tanh");
+            net.connect("in", "hidden");
+            net.connect("hidden", "out");
+            std::mt19937 gen{31};
+            std::uniform_real_distribution<f32> dist{-0.2f, 0.2f};
+            for (auto connection: net.m_connections)
+                for (u32 i = 0; i < connection->size(); i++) connection->m_ptr[i] = dist(gen);
+            net.start_epoch("mse");
+
+            // 2 channels of 42 squares, each padded to 48
+            auto board = [](const u32 pieces, const u32 seed) {
+                std::vector<f32> in(96, 0.f);
+                std::mt19937 g{seed};
+                for (u32 i = 0; i < pieces; i++) in[g() % 2 * 48 + g() % 42] = i % 2 ? 1.f : -1.f;
+                return in;
+            };
+            // a value besides -1, 0 and 1 takes the dense kernel, a tiny one on an empty square doesn't change much
+            auto densify = [](std::vector<f32> in) {
+                for (u32 i = 0; i < 84; i++)
+                    if (in[i / 42 * 48 + i % 42] == 0.f) {
+                        in[i / 42 * 48 + i % 42] = 1e-20f;
+                        break;
+                    }
+                return in;
+            };
+            const u32 hidden = net.layer_index("hidden");
+            const f32 *hidden_nodes = net.m_network_copies[0][hidden]->m_nodes.m_ptr;
+            std::vector<f32> targets(7, 0.5f);
+            bool broken = false;
+            for (u32 step = 0; step < 6; step++) {
+                for (u32 pieces: {0u, 1u, 5u, 20u, 42u, 84u}) {
+                    std::vector<f32> in = board(pieces, step * 100 + pieces), dense = densify(in);
+                    net.forward(dense.data());
+                    std::vector<f32> expected(hidden_nodes, hidden_nodes + 128);
+                    // the first call with the same weights is dense, the second one sparse
+                    for (u32 i = 0; i < 2; i++) {
+                        net.forward(in.data());
+                        for (u32 j = 0; j < 128; j++) broken |= std::abs(hidden_nodes[j] - expected[j]) > 1e-5f;
+                    }
+                }
+                if (step % 3 == 0) {
+                    net.train_target(board(10, step).data(), targets.data());
+                } else if (step % 3 == 1) {
+                    net.m_connections[0]->m_ptr[step] += 0.5f;
+                    net.weights_changed();
+                } else {
+                    // handing the weights out counts as a change
+                    for (auto tensor: net.stored_tensors()) tensor->m_ptr[step] -= 0.25f;
+                }
+            }
+            // the option survives the copies, without it writes to the weights need no weights_changed()
+            broken |= net.m_network_copies.back()[hidden]->config_string() != "fully_connected 128 tanh sparse\n";
+            pinguml::network plain("adam");
+            plain.push_back("in", "input 6 7 2");
+            plain.push_back("hidden", "fully_connected 128 tanh");
+            plain.connect("in", "hidden");
+            plain.start_epoch("mse");
+            const std::vector<f32> plain_in = board(8, 1), plain_dense = densify(plain_in);
+            const f32 *plain_nodes = plain.m_network_copies[0][1]->m_nodes.m_ptr;
+            for (u32 step = 0; step < 3; step++) {
+                for (u32 i = 0; i < plain.m_connections[0]->size(); i++) plain.m_connections[0]->m_ptr[i] += 0.01f * (f32)(i % 7);
+                plain.forward(plain_dense.data());
+                const std::vector<f32> expected(plain_nodes, plain_nodes + 128);
+                for (u32 i = 0; i < 2; i++) {
+                    plain.forward(plain_in.data());
+                    for (u32 j = 0; j < 128; j++) broken |= std::abs(plain_nodes[j] - expected[j]) > 1e-5f;
+                }
+            }
+            if (broken) {
+                std::cout << "pinguml sparse inputs are broken" << std::endl;
+                return 0;
+            }
+
+            constexpr u32 NUM_EVALS = 1 << 16;
+            std::vector<f32> sparse = board(8, 1), dense = densify(sparse);
+            std::array<f64, 2> times{};
+            f32 sum = 0.f;
+            for (u32 i = 0; i < 2; i++) {
+                const f32 *in = i ? dense.data() : sparse.data();
+                auto const t1 = std::chrono::high_resolution_clock::now();
+                for (u32 j = 0; j < NUM_EVALS; j++) sum += net.forward(in)[0];
+                auto const t2 = std::chrono::high_resolution_clock::now();
+                times[i] = std::chrono::duration<f64, std::nano>(t2 - t1).count() / NUM_EVALS;
+            }
+            std::cout << "pinguml forward 84-128-7 with 8 pieces: " << times[0] << "ns sparse, " << times[1]
+                      << "ns dense (" << sum << ")" << std::endl;
+        }
+
+        {
+            // pinguml fused backward: fully_connected_layer::backpropogate has to match propogate_delta,
+            // calculate_delta_weights and df one after the other
+            pinguml::network net("sgd");
+            net.push_back("in", "input 6 7 2");
+            net.push_back("hidden", "fully_connected 256 tanh");
+            net.push_back("out", "fully_connected 7 tanh");
+            net.connect("in", "hidden");
+            net.connect("hidden", "out");
+            std::mt19937 gen{37};
+            std::uniform_real_distribution<f32> dist{-0.5f, 0.5f};
+            for (auto connection: net.m_connections)
+                for (u32 i = 0; i < connection->size(); i++) connection->m_ptr[i] = dist(gen);
+            std::vector<f32> input(96, 0.f);
+            for (u32 i = 0; i < 84; i++) input[i / 42 * 48 + i % 42] = dist(gen);
+            net.forward(input.data());
+
+            bool broken = false;
+            const auto &layers = net.m_network_copies[0];
+            std::array<f64, 2> times{};
+            for (u32 right = 1; right < 3; right++) {
+                pinguml::layer_base &layer = *layers[right], &left = *layers[right - 1];
+                const pinguml::tensor &weights = *net.m_connections[right - 1];
+                for (u32 i = 0; i < layer.m_nodes.m_rows; i++) layer.m_delta.m_ptr[i] = dist(gen);
+                pinguml::tensor delta_weights[2];
+                std::vector<f32> deltas[2];
+                for (u32 i = 0; i < 2; i++) {
+                    for (u32 j = 0; j < left.m_delta.size(); j++) left.m_delta.m_ptr[j] = 0.1f;
+                    if (i) layer.backpropogate(left, weights, delta_weights[i], true);
+                    else layer.layer_base::backpropogate(left, weights, delta_weights[i], true);
+                    deltas[i].assign(left.m_delta.m_ptr, left.m_delta.m_ptr + left.m_delta.size());
+                }
+                for (u32 j = 0; j < deltas[0].size(); j++) broken |= std::abs(deltas[0][j] - deltas[1][j]) > 1e-5f;
+                broken |= delta_weights[0].size() != delta_weights[1].size();
+                for (u32 j = 0; j < std::min(delta_weights[0].size(), delta_weights[1].size()); j++)
+                    broken |= std::abs(delta_weights[0].m_ptr[j] - delta_weights[1].m_ptr[j]) > 1e-6f;
+
+                if (right == 1) {
+                    constexpr u32 NUM_ITERS = 1 << 14;
+                    for (u32 i = 0; i < 2; i++) {
+                        auto const t1 = std::chrono::high_resolution_clock::now();
+                        for (u32 j = 0; j < NUM_ITERS; j++) {
+                            if (i) layer.backpropogate(left, weights, delta_weights[i], false);
+                            else layer.layer_base::backpropogate(left, weights, delta_weights[i], false);
+                        }
+                        auto const t2 = std::chrono::high_resolution_clock::now();
+                        times[i] = std::chrono::duration<f64, std::nano>(t2 - t1).count() / NUM_ITERS;
+                    }
+                }
+            }
+            if (broken) {
+                std::cout << "pinguml fused backward is broken" << std::endl;
+                return 0;
+            }
+            std::cout << "pinguml backward 84x256: " << times[0] << "ns in two passes, " << times[1] << "ns fused"
+                      << std::endl;
+        }
+
         {
             // test neural net runtime  performance
             gya::random_player p1;
@@ -216,6 +1871,176 @@ int main() {
                     return 0;
                 }
             }
+            {
+                // mcts has to find (and prove) an immediate win
+                gya::board board_1 = gya::board::from_string(
+                        "| | | | | | | |\n"
+                        "| | | | | | | |\n"
+                        "| | | | | | | |\n"
+                        "|X| | | | | | |\n"
+                        "|X|O| | | | | |\n"
+                        "|X|O|X|O|X|O|X|\n"
+                        "|1|2|3|4|5|6|7|\n"
+                );
+                for (int i = 0; i < 16; ++i) {
+                    mcts::mcts s{1000};
+                    gya::board copy = board_1;
+                    copy.play(s.move(copy, copy.turn()));
+                    if (!copy.has_won_test().player_1_won()) {
+                        std::cout << "mcts is broken\n";
+                        std::cout << copy.to_string() << std::endl;
+                        return 0;
+                    }
+                }
+            }
+            {
+                // puct has to find an immediate win, even with an untrained network
+                gya::board board_1 = gya::board::from_string(
+                        "| | | | | | | |\n"
+                        "| | | | | | | |\n"
+                        "| | | | | | | |\n"
+                        "|X| | | | | | |\n"
+                        "|X|O| | | | | |\n"
+                        "|X|O|X|O|X|O|X|\n"
+                        "|1|2|3|4|5|6|7|\n"
+                );
+                mcts::puct s{mcts::neural_net_evaluator<gya::neural_net_player<>>{}, 1000};
+                gya::board copy = board_1;
+                copy.play(s.move(copy, copy.turn()));
+                if (!copy.has_won_test().player_1_won()) {
+                    std::cout << "puct is broken\n";
+                    std::cout << copy.to_string() << std::endl;
+                    return 0;
+                }
+                u32 num_visits = 0;
+                for (auto const &child: s.root()->m_children)
+                    num_visits += child->m_visits;
+                if (num_visits < 1000) {
+                    std::cout << "puct lost simulations: " << num_visits << std::endl;
+                    return 0;
+                }
+            }
+            {
+                // a position with a move to a tie and a move to a proven loss is tied, whatever order the moves are in
+                for (bool tie_first: {true, false}) {
+                    mcts::node root;
+                    for (auto result: {heuristic::TIE_MOVE, heuristic::WINNING_MOVE}) {
+                        root.m_children.push_back(std::make_unique<mcts::node>(&root));
+                        root.m_children.back()->m_result = result;
+                    }
+                    if (!tie_first) std::swap(root.m_children[0], root.m_children[1]);
+                    root.update_proven();
+                    if (!root.m_result.is_tied()) {
+                        std::cout << "mcts proven results are broken: " << root.m_result << std::endl;
+                        return 0;
+                    }
+
+                    // the same for the dag, node 0 with moves to nodes 1 and 2
+                    mcts::mcts_dag d{1};
+                    d.m_dag = std::make_unique<mcts::dag>();
+                    d.m_dag->m_nodes.resize(3);
+                    d.m_dag->m_nodes[0].m_expanded = true;
+                    d.m_dag->m_nodes[0].m_edges.push_back(mcts::dag_edge{0, 0, tie_first ? 1u : 2u});
+                    d.m_dag->m_nodes[0].m_edges.push_back(mcts::dag_edge{1, 0, tie_first ? 2u : 1u});
+                    d.m_dag->m_nodes[1].m_result = heuristic::TIE_MOVE;
+                    d.m_dag->m_nodes[2].m_result = heuristic::WINNING_MOVE;
+                    d.update_proven(0);
+                    if (!d.m_dag->m_nodes[0].m_result.is_tied()) {
+                        std::cout << "mcts dag proven results are broken: " << d.m_dag->m_nodes[0].m_result << std::endl;
+                        return 0;
+                    }
+                }
+
+                // proofs longer than 31 plies keep their order, the shorter win and the longer loss rank higher, and
+                // proofs longer than the depth field saturate
+                auto proof = [](u32 plies) {
+                    heuristic::eval_result result = heuristic::LOSING_MOVE;
+                    for (u32 i = 0; i < plies; ++i) result = result.incremented();
+                    return result;
+                };
+                using heuristic::proven_rank;
+                if (!(proven_rank(proof(3)) > proven_rank(proof(41))) || !proof(41).is_winning() ||
+                    !(proven_rank(proof(41)) > proven_rank(heuristic::TIE_MOVE)) ||
+                    !(proven_rank(proof(42)) > proven_rank(proof(4))) || !proof(42).is_losing() ||
+                    !(proven_rank(proof(42)) < proven_rank(heuristic::TIE_MOVE)) || !(proof(3) > proof(41)) ||
+                    !(proof(42) > proof(4)) || !proof(101).is_winning() ||
+                    proven_rank(proof(101)) > proven_rank(proof(41))) {
+                    std::cout << "long proofs are broken: " << proven_rank(proof(41)) << ", " << proven_rank(proof(42))
+                              << std::endl;
+                    return 0;
+                }
+            }
+            {
+                // memory and strength per rollout of the transposition-aware mcts against the tree version
+                constexpr auto NUM_ROLLOUTS = 20000;
+                gya::board b;
+                mcts::mcts t{NUM_ROLLOUTS};
+                mcts::tree tr;
+                for (int i = 0; i < NUM_ROLLOUTS; ++i)
+                    t.simulate_game(b, &tr, b.turn());
+                mcts::mcts_dag d{NUM_ROLLOUTS};
+                [[maybe_unused]] auto move = d.move(b, b.turn());
+                std::cout << "mcts tree: " << tr.size() << " nodes, " << tr.memory_usage() / 1024 << "KiB\n";
+                std::cout << "mcts dag: " << d.m_dag->size() << " nodes, " << d.m_dag->memory_usage() / 1024 << "KiB"
+                          << std::endl;
+
+                constexpr auto NUM_ITERS = 50;
+                constexpr auto NUM_GAMES = NUM_ITERS * 2;
+                int wins = 0, ties = 0;
+                for (int i = 0; i < NUM_ITERS; ++i) {
+                    mcts::mcts_dag p1{1000};
+                    mcts::mcts p2{1000};
+                    auto f1 = [&](gya::board const &board) { return p1.move(board, board.turn()); };
+                    auto f2 = [&](gya::board const &board) { return p2.move(board, board.turn()); };
+                    gya::random_player p;
+                    gya::board start;
+                    start.play(p(start));
+                    start.play(p(start));
+                    auto const r1 = util::test_game(f1, f2, start).has_won();
+                    auto const r2 = util::test_game(f2, f1, start).has_won();
+                    wins += r1.player_1_won() + r2.player_2_won();
+                    ties += r1.is_tie() + r2.is_tie();
+                }
+                std::cout << "mcts dag win-rate against mcts tree (1000 rollouts): " << wins * 1e2 / NUM_GAMES << "% ("
+                          << ties * 1e2 / NUM_GAMES << "% ties)" << std::endl;
+            }
+            {
+                // strength and cost of the rollout policies, every one plays mcts with random rollouts
+                constexpr auto NUM_ROLLOUTS = 1000;
+                constexpr auto NUM_ITERS = 25;
+                constexpr auto NUM_GAMES = NUM_ITERS * 2;
+                auto test_policy = [&]<class POLICY>(std::string_view name, POLICY policy) {
+                    int wins = 0, ties = 0, num_moves = 0;
+                    std::chrono::duration<double, std::milli> time{0};
+                    for (int i = 0; i < NUM_ITERS; ++i) {
+                        mcts::mcts<POLICY> p1{NUM_ROLLOUTS, 1, policy};
+                        mcts::mcts p2{NUM_ROLLOUTS};
+                        auto f1 = [&](gya::board const &board) {
+                            auto const t1 = std::chrono::high_resolution_clock::now();
+                            auto const move = p1.move(board, board.turn());
+                            time += std::chrono::high_resolution_clock::now() - t1;
+                            ++num_moves;
+                            return move;
+                        };
+                        auto f2 = [&](gya::board const &board) { return p2.move(board, board.turn()); };
+                        gya::random_player p;
+                        gya::board start;
+                        start.play(p(start));
+                        start.play(p(start));
+                        auto const r1 = util::test_game(f1, f2, start).has_won();
+                        auto const r2 = util::test_game(f2, f1, start).has_won();
+                        wins += r1.player_1_won() + r2.player_2_won();
+                        ties += r1.is_tie() + r2.is_tie();
+                    }
+                    std::cout << "mcts " << name << " rollouts: " << wins * 1e2 / NUM_GAMES << "% wins ("
+                              << ties * 1e2 / NUM_GAMES << "% ties), " << time.count() / num_moves << "ms/move"
+                              << std::endl;
+                };
+                test_policy("random", mcts::random_policy{});
+                test_policy("win", mcts::win_policy{});
+                test_policy("win-or-block", mcts::win_block_policy{});
+                test_policy("neural net", mcts::neural_net_policy<gya::neural_net_player<>>{});
+            }
             {
                 heuristic::one_move_solver p1, p2;
                 constexpr auto NUM_GAMES = 1 << 10;